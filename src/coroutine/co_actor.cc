@@ -0,0 +1,153 @@
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "co_actor.h"
+
+namespace co {
+namespace actor {
+
+struct CounterMessage {
+  enum Operation { Add, Get } operation;
+  int64_t value = 0;
+};
+
+// 计数器 actor，回复当前的计数
+struct Counter : Actor<Counter, CounterMessage, int64_t> {
+  using Actor::Actor;
+
+  task::Task<int64_t> receive(CounterMessage &message) {
+    if (message.operation == CounterMessage::Add) {
+      count += message.value;
+    }
+    co_return count;
+  }
+
+  int64_t count = 0;
+};
+
+// 作为对照的用互斥锁保护的计数器
+struct LockedCounter {
+  std::mutex lock;
+  int64_t count = 0;
+};
+
+uint64_t next_random(uint64_t &state) {
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// 依次 ask 每个计数器，返回计数之和；同一个发送方的消息按顺序处理，回复时之前的 tell 都已处理完
+task::Task<int64_t> sum_counters(std::vector<std::unique_ptr<Counter>> &counters) {
+  int64_t sum = 0;
+  for (auto &counter : counters) {
+    sum += co_await counter->ask({ CounterMessage::Get });
+  }
+  co_return sum;
+}
+
+// 在 executor 上对随机的计数器连续 ask count 次
+task::Task<int64_t> ask_client(executor::AbstractExecutor &executor, std::vector<std::unique_ptr<Counter>> &counters,
+                               uint64_t seed, std::size_t count) {
+  co_await executor::switch_to(executor);
+  int64_t sum = 0;
+  for (std::size_t i = 0; i < count; i++) {
+    sum += co_await counters[next_random(seed) % counters.size()]->ask({ CounterMessage::Add, 1 });
+  }
+  co_return sum;
+}
+
+void Run() {
+  std::cout << "start run actor" << std::endl;
+  constexpr std::size_t ACTOR_COUNT = 10'000;
+  constexpr std::size_t SENDER_COUNT = 4;
+  constexpr std::size_t MESSAGES_PER_SENDER = 2'000'000;
+  constexpr std::size_t ASK_CLIENTS = 64;
+  constexpr std::size_t ASKS_PER_CLIENT = 20'000;
+  std::cout << "hardware threads: " << std::thread::hardware_concurrency() << ", actor size: " << sizeof(Counter)
+            << " bytes (including 8 bytes of state)" << std::endl;
+
+  // 用互斥锁保护的对象，多个线程随机更新
+  {
+    std::vector<LockedCounter> counters(ACTOR_COUNT);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> senders;
+    for (std::size_t s = 0; s < SENDER_COUNT; s++) {
+      senders.emplace_back([&, s]() {
+        uint64_t state = 88172645463325252ULL + s;
+        for (std::size_t i = 0; i < MESSAGES_PER_SENDER; i++) {
+          auto &counter = counters[next_random(state) % ACTOR_COUNT];
+          std::lock_guard lock(counter.lock);
+          counter.count++;
+        }
+      });
+    }
+    for (auto &sender : senders) {
+      sender.join();
+    }
+    auto seconds = seconds_since(start);
+    int64_t sum = 0;
+    for (auto &counter : counters) {
+      sum += counter.count;
+    }
+    std::cout << "mutex objects: " << SENDER_COUNT * MESSAGES_PER_SENDER / seconds / 1e6 << " M updates/s, sum "
+              << sum << std::endl;
+  }
+
+  for (std::size_t threads : { 1, 2, 4 }) {
+    executor::WorkStealingExecutor executor(threads);
+    std::vector<std::unique_ptr<Counter>> counters;
+    for (std::size_t i = 0; i < ACTOR_COUNT; i++) {
+      counters.push_back(std::make_unique<Counter>(executor));
+    }
+
+    // 多个线程同时 tell
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> senders;
+    for (std::size_t s = 0; s < SENDER_COUNT; s++) {
+      senders.emplace_back([&, s]() {
+        uint64_t state = 88172645463325252ULL + s;
+        for (std::size_t i = 0; i < MESSAGES_PER_SENDER; i++) {
+          counters[next_random(state) % ACTOR_COUNT]->tell({ CounterMessage::Add, 1 });
+        }
+      });
+    }
+    for (auto &sender : senders) {
+      sender.join();
+    }
+    auto sum = sum_counters(counters).get_result();
+    auto seconds = seconds_since(start);
+    // Get 排在同一个邮箱里所有 Add 之后，此时每条 tell 都已经计入
+    auto expected = int64_t(SENDER_COUNT * MESSAGES_PER_SENDER);
+    std::cout << threads << " threads: tell " << SENDER_COUNT * MESSAGES_PER_SENDER / seconds / 1e6
+              << " M messages/s, sum " << sum << (sum == expected ? " correct" : " WRONG");
+
+    // 多个协程在线程池上并发 ask，每次 ask 都要等回复之后才发下一个
+    start = std::chrono::steady_clock::now();
+    std::vector<task::Task<int64_t>> clients;
+    for (std::size_t c = 0; c < ASK_CLIENTS; c++) {
+      clients.push_back(ask_client(executor, counters, c + 1, ASKS_PER_CLIENT));
+    }
+    for (auto &client : clients) {
+      client.get_result();
+    }
+    seconds = seconds_since(start);
+    sum = sum_counters(counters).get_result();
+    expected += int64_t(ASK_CLIENTS * ASKS_PER_CLIENT);
+    std::cout << ", ask " << ASK_CLIENTS * ASKS_PER_CLIENT / seconds / 1e6 << " M round trips/s, sum " << sum
+              << (sum == expected ? " correct" : " WRONG") << std::endl;
+    // 等 actor 都处理完再销毁
+    executor.shutdown();
+  }
+  std::cout << "end run actor" << std::endl;
+}
+
+} // namespace actor
+} // namespace co
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <optional>
+#include <iostream>
+#include <coroutine>
+#include <exception>
+#include "co_task.h"
+#include "co_executor.h"
+
+namespace co {
+namespace actor {
+
+// 一次调度最多连续处理的消息数，处理完仍有消息时重新提交，给其他 actor 执行的机会
+constexpr std::size_t MAILBOX_BATCH = 64;
+
+// 队列中的节点，复制只发生在入队之前，不复制链接
+struct MailboxNode {
+  MailboxNode() = default;
+  MailboxNode(const MailboxNode &) {}
+
+  std::atomic<MailboxNode *> next{ nullptr };
+};
+
+/**
+ * 多生产者单消费者的无锁侵入式队列（Vyukov）：
+ * 生产者只对 head 做一次原子交换再链接到前一个节点，消费者独占 tail，不需要任何原子读改写。
+ * 生产者交换 head 之后、链接之前，消费者会暂时看不到这个节点，pop 返回空，empty 返回 false
+*/
+struct Mailbox {
+  Mailbox() = default;
+
+  Mailbox(Mailbox &) = delete;
+  Mailbox &operator=(Mailbox &) = delete;
+
+  void push(MailboxNode *node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    // 与 Actor 的调度标记一起构成先写后读的同步，需要 seq_cst
+    auto previous = head.exchange(node, std::memory_order_seq_cst);
+    previous->next.store(node, std::memory_order_release);
+  }
+
+  // 只能由消费者调用
+  MailboxNode *pop() {
+    auto first = tail;
+    auto next = first->next.load(std::memory_order_acquire);
+    if (first == &stub) {
+      if (!next) {
+        return nullptr;
+      }
+      tail = first = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+    if (next) {
+      tail = next;
+      return first;
+    }
+    if (first != head.load(std::memory_order_acquire)) {
+      // 有生产者正在链接新节点
+      return nullptr;
+    }
+    // first 是最后一个节点，把 stub 放回队尾才能把它取出来
+    push(&stub);
+    next = first->next.load(std::memory_order_acquire);
+    if (next) {
+      tail = next;
+      return first;
+    }
+    return nullptr;
+  }
+
+  // 只能由消费者调用
+  bool empty() const {
+    return tail == &stub && !has_pushed();
+  }
+
+  /**
+   * 消费者看到队列为空之后，是否又有生产者入队；
+   * 只读取 head，消费者放弃消费权之后也可以调用
+  */
+  bool has_pushed() const {
+    return head.load(std::memory_order_seq_cst) != &stub;
+  }
+
+private:
+  std::atomic<MailboxNode *> head{ &stub };
+  MailboxNode *tail = &stub;
+  MailboxNode stub;
+};
+
+/**
+ * actor 基类（CRTP），Derived 需要定义 task::Task<Reply> receive(Message &message)。
+ * 消息依次处理，同一时间最多有一个 receive 在执行，Derived 的状态不需要加锁；
+ * receive 挂起时后面的消息等它完成再处理。
+ * 空闲的 actor 只占用邮箱、调度标记和执行器指针，不持有线程或者协程。
+ * 最后一个回复发出之后 actor 仍可能在执行器上收尾，销毁之前需要确保它已经空闲，例如先关闭执行器
+*/
+template <typename Derived, typename Message, typename Reply>
+struct Actor {
+  explicit Actor(executor::AbstractExecutor &executor) : executor(&executor) {}
+
+  ~Actor() {
+    // 没处理的 tell 消息由 actor 负责释放
+    while (auto node = mailbox.pop()) {
+      auto envelope = static_cast<Envelope *>(node);
+      if (!envelope->asker) {
+        delete envelope;
+      }
+    }
+  }
+
+  Actor(Actor &) = delete;
+  Actor &operator=(Actor &) = delete;
+
+  struct Envelope : MailboxNode {
+    explicit Envelope(Message &&message) : message(std::move(message)) {}
+
+    Message message;
+    // ask 时等待回复的协程，tell 时为空
+    std::coroutine_handle<> asker;
+    std::optional<task::TaskResult<Reply>> result;
+  };
+
+  /**
+   * co_await actor.ask(message) 发送消息并等待回复，receive 抛出的异常在这里重新抛出。
+   * 消息放在等待方的协程帧里，不需要额外分配内存；回复在 actor 所在的线程上直接恢复等待方
+  */
+  struct AskAwaiter {
+    bool await_ready() const noexcept {
+      return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+      envelope.asker = handle;
+      actor.post(&envelope);
+    }
+
+    Reply await_resume() {
+      return envelope.result->get_or_throw();
+    }
+
+    Actor &actor;
+    Envelope envelope;
+  };
+
+  AskAwaiter ask(Message message) {
+    return AskAwaiter{ *this, Envelope(std::move(message)) };
+  }
+
+  // 发送消息，不等待处理结果，receive 抛出的异常只会被打印到 std::cerr，需要处理异常时用 ask
+  void tell(Message message) {
+    post(new Envelope(std::move(message)));
+  }
+
+private:
+  void post(Envelope *envelope) {
+    mailbox.push(envelope);
+    // 只有把 scheduled 从 false 改为 true 的发送方负责提交；已经在调度中时只读一次，不做原子交换
+    if (!scheduled.load(std::memory_order_seq_cst) && !scheduled.exchange(true, std::memory_order_seq_cst)) {
+      schedule();
+    }
+  }
+
+  void schedule() {
+    executor->execute([this]() { drain(); });
+  }
+
+  // 处理一批消息，只在持有调度权时执行
+  void drain() {
+    // 上一批中挂起的 receive 已经完成，销毁它的协程
+    active.reset();
+    for (std::size_t i = 0; i < MAILBOX_BATCH; i++) {
+      auto node = mailbox.pop();
+      if (!node) {
+        break;
+      }
+      auto envelope = static_cast<Envelope *>(node);
+      auto task = static_cast<Derived *>(this)->receive(envelope->message);
+      if (!task.handle.promise().is_completed()) {
+        // receive 挂起，完成之后再继续处理后面的消息
+        active.emplace(std::move(task));
+        active->handle.promise().on_completed([this, envelope](auto result) {
+          reply(envelope, std::move(result));
+          schedule();
+        });
+        return;
+      }
+      task.handle.promise().on_completed([this, envelope](auto result) { reply(envelope, std::move(result)); });
+    }
+    if (!mailbox.empty()) {
+      schedule();
+      return;
+    }
+    /**
+     * 先释放调度权再检查邮箱：释放之前到达的消息由这里重新调度，之后到达的由发送方调度。
+     * 释放之后其他线程可能已经开始消费，不能再读取 tail
+    */
+    scheduled.store(false, std::memory_order_seq_cst);
+    if (mailbox.has_pushed() && !scheduled.exchange(true, std::memory_order_seq_cst)) {
+      schedule();
+    }
+  }
+
+  // 恢复 ask 的等待方之后 envelope 随等待方的协程帧一起失效
+  void reply(Envelope *envelope, task::TaskResult<Reply> &&result) {
+    if (envelope->asker) {
+      envelope->result.emplace(std::move(result));
+      envelope->asker.resume();
+      return;
+    }
+    delete envelope;
+    try {
+      result.get_or_throw();
+    } catch (std::exception &e) {
+      std::cerr << e.what() << std::endl;
+    }
+  }
+
+  Mailbox mailbox;
+  std::atomic<bool> scheduled{ false };
+  executor::AbstractExecutor *executor;
+  // 挂起中的 receive
+  std::optional<task::Task<Reply>> active;
+};
+
+void Run();
+
+} // namespace actor
+} // namespace co
@@ -0,0 +1,183 @@
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include "co_task.h"
+#include "co_load.h"
+#include "co_budget.h"
+#include "co_admission.h"
+
+namespace co {
+namespace admission {
+
+AdmissionExecutor::AdmissionExecutor(std::size_t thread_count, Clock::duration target_delay, Clock::duration interval)
+    : target_delay(target_delay), interval(interval) {
+  thread_count = std::max<std::size_t>(thread_count, 1);
+  running = thread_count;
+  for (std::size_t i = 0; i < thread_count; i++) {
+    threads.emplace_back(&AdmissionExecutor::run_worker, this);
+  }
+}
+
+AdmissionExecutor::~AdmissionExecutor() {
+  shutdown();
+}
+
+void AdmissionExecutor::execute(std::function<void()> &&func) {
+  std::unique_lock lock(queue_lock);
+  if (running == 0) {
+    return;
+  }
+  ready_queue.push_back(Entry{ Clock::now(), std::move(func) });
+  lock.unlock();
+  queue_condition.notify_one();
+}
+
+bool AdmissionExecutor::try_execute(std::function<void()> &&func) {
+  if (overloaded()) {
+    shed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  admit_and_execute(std::move(func));
+  return true;
+}
+
+void AdmissionExecutor::admit_and_execute(std::function<void()> &&func) {
+  admitted.fetch_add(1, std::memory_order_relaxed);
+  execute(std::move(func));
+}
+
+std::size_t AdmissionExecutor::queue_length() {
+  std::lock_guard lock(queue_lock);
+  return ready_queue.size();
+}
+
+void AdmissionExecutor::shutdown() {
+  for (auto &thread : threads) {
+    if (thread.get_id() == std::this_thread::get_id()) {
+      throw std::logic_error("thread pool shut down from one of its own threads");
+    }
+  }
+  {
+    std::lock_guard lock(queue_lock);
+    if (!is_active) {
+      return;
+    }
+    is_active = false;
+  }
+  queue_condition.notify_all();
+  for (auto &thread : threads) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+
+void AdmissionExecutor::observe(Clock::time_point now, Clock::duration delay) {
+  last_delay.store(delay.count(), std::memory_order_relaxed);
+  // 队列已经取空说明没有持续积压，等待时间低于目标说明积压正在消退
+  if (delay < target_delay || ready_queue.empty()) {
+    if (is_overloaded.load(std::memory_order_relaxed)) {
+      overload_exit_time = now;
+      is_overloaded.store(false, std::memory_order_relaxed);
+    }
+    first_above_time = Clock::time_point{};
+    return;
+  }
+  if (first_above_time == Clock::time_point{}) {
+    first_above_time = now;
+  }
+  // 与 CoDel 一样，刚退出过载不久又开始积压时直接回到过载状态，不再等待一个完整的 interval
+  if (now - first_above_time >= interval || now - overload_exit_time < interval) {
+    is_overloaded.store(true, std::memory_order_relaxed);
+  }
+}
+
+void AdmissionExecutor::run_worker() {
+  while (true) {
+    std::unique_lock lock(queue_lock);
+    queue_condition.wait(lock, [this]() { return !ready_queue.empty() || !is_active; });
+    if (ready_queue.empty()) {
+      running--;
+      return;
+    }
+    auto entry = std::move(ready_queue.front());
+    ready_queue.pop_front();
+    auto now = Clock::now();
+    observe(now, now - entry.enqueued);
+    lock.unlock();
+    budget::BudgetScope scope(this);
+    entry.func();
+  }
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr auto STAGE_TIME = std::chrono::microseconds(100);
+
+// 被拒绝的请求在压测报告里记为失败
+struct Overloaded : std::exception {
+  const char *what() const noexcept override {
+    return "overloaded";
+  }
+};
+
+void spin_for(Clock::duration duration) {
+  auto until = Clock::now() + duration;
+  while (Clock::now() < until) {
+  }
+}
+
+/**
+ * 一个请求分两段执行，每段占用 STAGE_TIME 的 CPU，两段之间重新排队一次。
+ * 第一段通过 admit 准入（use_admission 为 false 时直接切换），第二段是已经开始的工作，总是被接受
+*/
+task::Task<void> handle_request(AdmissionExecutor &executor, bool use_admission) {
+  if (use_admission) {
+    // GCC 12 在条件表达式里 co_await 时会生成错误的代码，先取出结果
+    auto admitted = co_await executor.admit();
+    if (!admitted) {
+      throw Overloaded();
+    }
+  } else {
+    co_await executor::switch_to(executor);
+  }
+  spin_for(STAGE_TIME);
+  co_await executor::switch_to(executor);
+  spin_for(STAGE_TIME);
+}
+
+void overload(bool use_admission, double rate) {
+  AdmissionExecutor executor(1);
+  load::Options options;
+  options.rate = rate;
+  options.duration = std::chrono::seconds(3);
+  options.arrival = load::Arrival::POISSON;
+  auto report = load::run_open_loop([&]() { return handle_request(executor, use_admission); }, options);
+  auto name = std::string(use_admission ? "codel admission" : "no admission") + ", offered " +
+              std::to_string(static_cast<int>(rate)) + "/s";
+  report.print(std::cout, name);
+  auto seconds = std::chrono::duration<double>(report.elapsed).count();
+  std::cout << "  goodput " << (report.issued - report.failed) / seconds << "/s, shed " << executor.shed_count()
+            << ", admitted " << executor.admitted_count() << ", last queue delay "
+            << std::chrono::duration<double, std::micro>(executor.queue_delay()).count() << " us" << std::endl;
+}
+
+} // namespace
+
+void Run() {
+  std::cout << "start run admission" << std::endl;
+  std::cout << "hardware threads: " << std::thread::hardware_concurrency() << ", 1 worker, 2 x "
+            << STAGE_TIME.count() << " us per request, target delay " << TARGET_DELAY.count() << " ms, interval "
+            << INTERVAL.count() << " ms" << std::endl;
+  // 处理能力约为每秒 5000 个请求，分别在 60% 和 150% 的负载下比较
+  for (double rate : { 3000.0, 7500.0 }) {
+    overload(false, rate);
+    overload(true, rate);
+  }
+  std::cout << "end run admission" << std::endl;
+}
+
+} // namespace admission
+} // namespace co
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <coroutine>
+#include <functional>
+#include <condition_variable>
+#include "co_executor.h"
+
+namespace co {
+namespace admission {
+
+// 排队时间的目标值，持续超过它就认为过载
+constexpr std::chrono::milliseconds TARGET_DELAY{ 5 };
+
+// 判断“持续”的时间窗口
+constexpr std::chrono::milliseconds INTERVAL{ 100 };
+
+/**
+ * 带准入控制的线程池，用 CoDel 的方式判断过载：逻辑出队时计算它在队列中等待的时间（sojourn time），
+ * 一个 interval 内所有出队逻辑的等待时间都超过 target_delay，说明队列不是短暂的突发而是持续积压，
+ * 进入过载状态；之后只要有一个逻辑的等待时间低于 target_delay，或者队列被取空，就立即退出过载状态。
+ * 过载时新工作通过 try_execute / admit 提交会被立即拒绝，只有一次原子读；
+ * execute 提交的逻辑（通常是已经开始的协程的恢复）总是被接受，已经开始的工作总能完成
+*/
+struct AdmissionExecutor : executor::AbstractExecutor {
+  using Clock = std::chrono::steady_clock;
+
+  explicit AdmissionExecutor(std::size_t thread_count = std::thread::hardware_concurrency(),
+                             Clock::duration target_delay = TARGET_DELAY, Clock::duration interval = INTERVAL);
+  ~AdmissionExecutor() override;
+
+  AdmissionExecutor(AdmissionExecutor &) = delete;
+  AdmissionExecutor &operator=(AdmissionExecutor &) = delete;
+
+  // 总是接受
+  void execute(std::function<void()> &&func) override;
+
+  // 准入接口：过载时不提交，返回 false
+  bool try_execute(std::function<void()> &&func);
+
+  /**
+   * 协程的准入接口：bool admitted = co_await executor.admit()，
+   * 被接受时协程已经切换到线程池上执行，被拒绝时不挂起，仍在原来的线程上
+  */
+  struct AdmitAwaiter {
+    bool await_ready() {
+      admitted = !executor.overloaded();
+      if (!admitted) {
+        executor.shed.fetch_add(1, std::memory_order_relaxed);
+      }
+      return !admitted;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+      executor.admit_and_execute([handle]() { handle.resume(); });
+    }
+
+    bool await_resume() const noexcept {
+      return admitted;
+    }
+
+    AdmissionExecutor &executor;
+    bool admitted = false;
+  };
+
+  AdmitAwaiter admit() {
+    return AdmitAwaiter{ *this };
+  }
+
+  bool overloaded() const {
+    return is_overloaded.load(std::memory_order_relaxed);
+  }
+
+  // 被拒绝的新工作数
+  uint64_t shed_count() const {
+    return shed.load(std::memory_order_relaxed);
+  }
+
+  // 被接受的新工作数
+  uint64_t admitted_count() const {
+    return admitted.load(std::memory_order_relaxed);
+  }
+
+  // 最近一个出队的逻辑在队列中等待的时间
+  Clock::duration queue_delay() const {
+    return Clock::duration(last_delay.load(std::memory_order_relaxed));
+  }
+
+  std::size_t queue_length();
+
+  std::size_t thread_count() const {
+    return threads.size();
+  }
+
+  // 执行完队列中的逻辑之后停止所有线程，之后提交的逻辑会被丢弃；不能在自己的线程上关闭或者销毁
+  void shutdown();
+
+private:
+  struct Entry {
+    Clock::time_point enqueued;
+    std::function<void()> func;
+  };
+
+  void admit_and_execute(std::function<void()> &&func);
+
+  void run_worker();
+
+  // 需要持有 queue_lock，根据出队逻辑的等待时间更新过载状态
+  void observe(Clock::time_point now, Clock::duration delay);
+
+  Clock::duration target_delay;
+  Clock::duration interval;
+
+  std::mutex queue_lock;
+  std::condition_variable queue_condition;
+  std::deque<Entry> ready_queue;
+  bool is_active = true;
+  // 与 ThreadPoolExecutor 相同，由 queue_lock 保护
+  std::size_t running = 0;
+  std::vector<std::thread> threads;
+
+  // 连续超过 target_delay 的第一个出队时间，没有超过时为空，只在持有 queue_lock 时访问
+  Clock::time_point first_above_time{};
+  // 最近一次退出过载状态的时间
+  Clock::time_point overload_exit_time{};
+
+  std::atomic<bool> is_overloaded{ false };
+  std::atomic<uint64_t> shed{ 0 };
+  std::atomic<uint64_t> admitted{ 0 };
+  std::atomic<Clock::rep> last_delay{ 0 };
+};
+
+void Run();
+
+} // namespace admission
+} // namespace co
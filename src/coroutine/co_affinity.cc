@@ -0,0 +1,96 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include "co_task.h"
+#include "co_executor.h"
+#include "co_affinity.h"
+
+namespace co {
+namespace affinity {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int REQUESTS = 8;
+constexpr int STEPS = 5000;
+
+// 在线程池上完成的子任务
+task::Task<int> compute(executor::AbstractExecutor &pool, int value) {
+  co_await executor::switch_to(pool);
+  co_return value;
+}
+
+/**
+ * 请求的状态属于 home 执行器，每一步把计算交给线程池，之后检查自己是否回到了 home 上。
+ * use_affinity 为 false 时只用 switch_to 切换一次，协程没有执行器，在完成子任务的线程上继续执行
+*/
+task::Task<int64_t> request(executor::AbstractExecutor &home, executor::AbstractExecutor &pool, bool use_affinity,
+                            std::atomic<int> &off_home) {
+  if (use_affinity) {
+    co_await resume_on(home);
+  } else {
+    co_await executor::switch_to(home);
+  }
+  int64_t sum = 0;
+  for (int i = 0; i < STEPS; i++) {
+    sum += co_await compute(pool, i);
+    if (budget::current_executor() != &home) {
+      off_home.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  co_return sum;
+}
+
+// 创建在事件循环上的协程用 switch_to 转到线程池做阻塞的工作，之后等待 Task 时不应该被送回事件循环
+task::Task<bool> offload(executor::AbstractExecutor &pool) {
+  co_await executor::switch_to(pool);
+  co_await compute(pool, 0);
+  co_return budget::current_executor() == &pool;
+}
+
+task::Task<bool> offload_from(executor::AbstractExecutor &loop, executor::AbstractExecutor &pool) {
+  co_await executor::switch_to(loop);
+  co_return co_await offload(pool);
+}
+
+void measure(const char *name, executor::AbstractExecutor &home, executor::AbstractExecutor &pool,
+             bool use_affinity) {
+  std::atomic<int> off_home{ 0 };
+  auto start = Clock::now();
+  std::vector<task::Task<int64_t>> requests;
+  for (int i = 0; i < REQUESTS; i++) {
+    requests.push_back(request(home, pool, use_affinity, off_home));
+  }
+  auto correct = true;
+  for (auto &task : requests) {
+    correct = task.get_result() == int64_t(STEPS) * (STEPS - 1) / 2 && correct;
+  }
+  auto elapsed = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+  std::cout << name << ": " << elapsed / (REQUESTS * STEPS) << " us per await, continuations off home "
+            << off_home.load() << " / " << REQUESTS * STEPS << (correct ? ", correct" : ", WRONG") << std::endl;
+}
+
+} // namespace
+
+void Run() {
+  std::cout << "start run affinity" << std::endl;
+  std::cout << "hardware threads: " << std::thread::hardware_concurrency() << ", " << REQUESTS << " requests x "
+            << STEPS << " awaits of tasks completed on a 4-thread pool" << std::endl;
+  executor::LooperExecutor loop;
+  executor::ThreadPoolExecutor pool(4);
+  measure("event loop home, no affinity", loop, pool, false);
+  measure("event loop home, resume_on", loop, pool, true);
+  // 完成子任务的线程已经在协程的执行器上，直接恢复，不再排队
+  measure("pool home, resume_on", pool, pool, true);
+  auto stayed = offload_from(loop, pool).get_result();
+  std::cout << "switch_to pool from an event loop task, after the next await: "
+            << (stayed ? "still on pool, correct" : "back on event loop, WRONG") << std::endl;
+  loop.shutdown();
+  std::cout << "end run affinity" << std::endl;
+}
+
+} // namespace affinity
+} // namespace co
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <coroutine>
+#include "co_budget.h"
+#include "co_executor.h"
+
+namespace co {
+namespace affinity {
+
+/**
+ * co_await resume_on(executor) 把当前协程切换到 executor 上执行，并把 executor 设为协程的执行器：
+ * 之后等待的 Task 无论在哪个线程上完成，协程都回到 executor 上恢复，
+ * 完成 Task 的线程已经在 executor 上时直接恢复，不再排队。
+ * 当前已经在 executor 上时不挂起。只能在 Task 中使用
+*/
+struct ResumeOnAwaiter {
+  constexpr bool await_ready() const noexcept {
+    return false;
+  }
+
+  template <typename Promise>
+  bool await_suspend(std::coroutine_handle<Promise> handle) {
+    handle.promise().set_executor(&executor);
+    if (budget::current_executor() == &executor) {
+      return false;
+    }
+    executor.execute([handle]() { handle.resume(); });
+    return true;
+  }
+
+  void await_resume() const noexcept {}
+
+  executor::AbstractExecutor &executor;
+};
+
+inline ResumeOnAwaiter resume_on(executor::AbstractExecutor &executor) {
+  return ResumeOnAwaiter{ executor };
+}
+
+void Run();
+
+} // namespace affinity
+
+using affinity::resume_on;
+
+} // namespace co
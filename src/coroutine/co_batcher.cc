@@ -0,0 +1,211 @@
+#include <mutex>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstdint>
+#include <string>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <filesystem>
+#include "co_task.h"
+#include "co_batcher.h"
+
+namespace co {
+namespace batch {
+
+using task::Task;
+using executor::LooperExecutor;
+
+/**
+ * 本地存储，每个 key 对应文件中的一条定长记录，每次调用都需要加锁并发起 pread 系统调用
+*/
+struct LocalStore {
+  static constexpr std::size_t RECORD_SIZE = 64;
+  // 批量读取时间隔不超过这么多条记录的 key 合并成一次 pread
+  static constexpr std::size_t MAX_GAP = 64;
+
+  LocalStore(std::filesystem::path path, std::size_t record_count) : path(std::move(path)) {
+    fd = ::open(this->path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("open store failed: " + std::string(std::strerror(errno)));
+    }
+    std::vector<char> records(record_count * RECORD_SIZE);
+    for (uint64_t key = 0; key < record_count; key++) {
+      auto value = key * 2 + 1;
+      std::memcpy(&records[key * RECORD_SIZE], &value, sizeof(value));
+    }
+    if (::pwrite(fd, records.data(), records.size(), 0) != static_cast<ssize_t>(records.size())) {
+      throw std::runtime_error("init store failed");
+    }
+  }
+
+  ~LocalStore() {
+    ::close(fd);
+    std::filesystem::remove(path);
+  }
+
+  uint64_t get(uint64_t key) {
+    std::lock_guard lock(store_lock);
+    calls++;
+    char record[RECORD_SIZE];
+    read(record, key, 1);
+    return decode(record);
+  }
+
+  std::vector<uint64_t> multi_get(const std::vector<uint64_t> &keys) {
+    std::lock_guard lock(store_lock);
+    calls++;
+
+    auto sorted = keys;
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    // 把相邻的 key 合并成连续区间，每个区间一次 pread
+    std::vector<uint64_t> values(sorted.size());
+    std::vector<char> buffer;
+    for (std::size_t begin = 0; begin < sorted.size();) {
+      auto end = begin + 1;
+      while (end < sorted.size() && sorted[end] - sorted[end - 1] <= MAX_GAP) {
+        end++;
+      }
+      auto first = sorted[begin];
+      auto count = sorted[end - 1] - first + 1;
+      buffer.resize(count * RECORD_SIZE);
+      read(buffer.data(), first, count);
+      for (auto i = begin; i < end; i++) {
+        values[i] = decode(&buffer[(sorted[i] - first) * RECORD_SIZE]);
+      }
+      begin = end;
+    }
+
+    std::vector<uint64_t> result;
+    result.reserve(keys.size());
+    for (auto key : keys) {
+      auto it = std::lower_bound(sorted.begin(), sorted.end(), key);
+      result.push_back(values[it - sorted.begin()]);
+    }
+    return result;
+  }
+
+  std::size_t calls = 0;
+  std::size_t syscalls = 0;
+
+private:
+  void read(char *buffer, uint64_t first, std::size_t count) {
+    syscalls++;
+    auto size = count * RECORD_SIZE;
+    if (::pread(fd, buffer, size, first * RECORD_SIZE) != static_cast<ssize_t>(size)) {
+      throw std::out_of_range("key out of range: " + std::to_string(first));
+    }
+  }
+
+  static uint64_t decode(const char *record) {
+    uint64_t value;
+    std::memcpy(&value, record, sizeof(value));
+    return value;
+  }
+
+  std::filesystem::path path;
+  int fd = -1;
+  std::mutex store_lock;
+};
+
+Task<uint64_t> load_direct(LocalStore &store, uint64_t key) {
+  co_return store.get(key);
+}
+
+Task<uint64_t> load_batched(Batcher<uint64_t, uint64_t> &batcher, uint64_t key) {
+  co_return co_await batcher.load(key);
+}
+
+/**
+ * 为每个 key 启动一个协程，spawn_in_loop 为 true 时所有协程在执行器的同一个 tick 内发起请求，
+ * 否则在当前线程上发起，最后关闭执行器等待所有协程执行完
+*/
+template <typename Spawn>
+void benchmark(const std::string &name, LooperExecutor &executor, LocalStore &store,
+               const std::vector<uint64_t> &keys, bool spawn_in_loop, Spawn &&spawn) {
+  store.calls = 0;
+  store.syscalls = 0;
+  std::vector<Task<uint64_t>> tasks;
+  tasks.reserve(keys.size());
+
+  auto start = std::chrono::steady_clock::now();
+  auto spawn_all = [&]() {
+    for (auto key : keys) {
+      tasks.push_back(spawn(key));
+    }
+  };
+  if (spawn_in_loop) {
+    executor.execute(spawn_all);
+  } else {
+    spawn_all();
+  }
+  executor.shutdown(true);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  uint64_t checksum = 0;
+  for (std::size_t i = 0; i < tasks.size(); i++) {
+    auto value = tasks[i].get_result();
+    if (value != keys[i] * 2 + 1) {
+      std::cerr << name << " wrong value for key " << keys[i] << std::endl;
+    }
+    checksum += value;
+  }
+  std::cout << name << ": " << std::chrono::duration<double, std::milli>(elapsed).count() << " ms, "
+            << store.calls << " store calls, " << store.syscalls << " syscalls, checksum " << checksum << std::endl;
+}
+
+void print_batches(Batcher<uint64_t, uint64_t> &batcher) {
+  std::cout << "  batches: " << batcher.batch_count() << ", average batch size: "
+            << static_cast<double>(batcher.key_count()) / batcher.batch_count() << std::endl;
+}
+
+void Run() {
+  std::cout << "start run batcher" << std::endl;
+  constexpr std::size_t RECORD_COUNT = 1 << 16;
+  constexpr std::size_t LOAD_COUNT = 100000;
+
+  LocalStore store(std::filesystem::temp_directory_path() / "co_batcher_store", RECORD_COUNT);
+  std::mt19937_64 random(11);
+  std::vector<uint64_t> keys(LOAD_COUNT);
+  for (auto &key : keys) {
+    key = random() % RECORD_COUNT;
+  }
+  auto multi_get = [&store](const std::vector<uint64_t> &keys) { return store.multi_get(keys); };
+
+  {
+    LooperExecutor executor;
+    benchmark("direct", executor, store, keys, true, [&store](uint64_t key) {
+      return load_direct(store, key);
+    });
+  }
+
+  for (std::size_t max_batch_size : { 16, 128, 1024 }) {
+    LooperExecutor executor;
+    Batcher<uint64_t, uint64_t> batcher(executor, multi_get, max_batch_size);
+    auto name = "batched(" + std::to_string(max_batch_size) + ")";
+    benchmark(name, executor, store, keys, true, [&batcher](uint64_t key) {
+      return load_batched(batcher, key);
+    });
+    print_batches(batcher);
+  }
+
+  // 在执行器之外发起 load，批次按大小或 max_delay 提交
+  {
+    LooperExecutor executor;
+    Batcher<uint64_t, uint64_t> batcher(executor, multi_get, 1024);
+    benchmark("batched from outside loop", executor, store, keys, false, [&batcher](uint64_t key) {
+      return load_batched(batcher, key);
+    });
+    print_batches(batcher);
+  }
+  std::cout << "end run batcher" << std::endl;
+}
+
+} // namespace batch
+} // namespace co
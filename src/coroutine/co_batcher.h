@@ -0,0 +1,179 @@
+#pragma once
+
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <utility>
+#include <coroutine>
+#include <exception>
+#include <stdexcept>
+#include <functional>
+#include "co_executor.h"
+
+namespace co {
+namespace batch {
+
+/**
+ * 批量加载器，把大量协程各自的单 key 请求合并成一次后端调用。
+ * co_await batcher.load(key) 把 key 加入当前批次并挂起，批次在以下任意一个条件满足时提交：
+ *   1. 批次大小达到 max_batch_size
+ *   2. 在执行器线程上发起的 load，当前 tick 结束时
+ *   3. 在其他线程上发起的 load，距批次中第一个 key 超过 max_delay
+ * 提交时在执行器线程上调用一次 batch_function，再用返回值依次恢复批次中的所有协程
+*/
+template <typename K, typename V>
+struct Batcher {
+  // 按 keys 的顺序返回对应的值，抛出的异常会传给批次中的每一个等待者
+  using BatchFunction = std::function<std::vector<V>(const std::vector<K> &)>;
+
+  struct LoadAwaiter;
+
+  Batcher(executor::LooperExecutor &executor,
+          BatchFunction &&batch_function,
+          std::size_t max_batch_size = 128,
+          std::chrono::microseconds max_delay = std::chrono::microseconds(500))
+    : executor(executor),
+      batch_function(std::move(batch_function)),
+      max_batch_size(max_batch_size),
+      max_delay(max_delay) {}
+
+  Batcher(Batcher &) = delete;
+  Batcher &operator=(Batcher &) = delete;
+
+  LoadAwaiter load(K key) {
+    return LoadAwaiter(this, std::move(key));
+  }
+
+  // 已经提交的批次数
+  std::size_t batch_count() {
+    std::lock_guard lock(batch_lock);
+    return flushed_batches;
+  }
+
+  // 已经提交的 key 数
+  std::size_t key_count() {
+    std::lock_guard lock(batch_lock);
+    return flushed_keys;
+  }
+
+  struct LoadAwaiter {
+    constexpr bool await_ready() const noexcept {
+      return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+      this->handle = handle;
+      batcher->enqueue(this);
+    }
+
+    V await_resume() {
+      if (exception_ptr) {
+        std::rethrow_exception(exception_ptr);
+      }
+      return std::move(value);
+    }
+
+    LoadAwaiter(Batcher *batcher, K &&key) : batcher(batcher), key(std::move(key)) {}
+
+  private:
+    friend struct Batcher;
+
+    Batcher *batcher;
+    K key;
+    V value{};
+    std::exception_ptr exception_ptr;
+    std::coroutine_handle<> handle;
+  };
+
+private:
+  struct Batch {
+    std::vector<LoadAwaiter *> awaiters;
+    // 同一个批次可能同时满足多个提交条件，只提交一次
+    bool flushed = false;
+  };
+
+  void enqueue(LoadAwaiter *awaiter) {
+    std::unique_lock lock(batch_lock);
+    if (!current_batch) {
+      // 批次的第一个 key，安排时间或 tick 结束时的提交
+      current_batch = std::make_shared<Batch>();
+      auto batch = current_batch;
+      if (executor.in_loop()) {
+        executor.defer([this, batch]() { flush(batch); });
+      } else {
+        executor.execute_delayed([this, batch]() { flush(batch); }, max_delay);
+      }
+    }
+    current_batch->awaiters.push_back(awaiter);
+    if (current_batch->awaiters.size() >= max_batch_size) {
+      // 达到大小阈值，交给执行器立即提交，后续的 key 进入新的批次
+      auto batch = std::move(current_batch);
+      lock.unlock();
+      executor.execute([this, batch]() { flush(batch); });
+    }
+  }
+
+  // 在执行器线程上执行
+  void flush(const std::shared_ptr<Batch> &batch) {
+    {
+      std::lock_guard lock(batch_lock);
+      if (batch->flushed) {
+        return;
+      }
+      batch->flushed = true;
+      if (current_batch == batch) {
+        current_batch.reset();
+      }
+      flushed_batches++;
+      flushed_keys += batch->awaiters.size();
+    }
+
+    std::vector<K> keys;
+    keys.reserve(batch->awaiters.size());
+    for (auto awaiter : batch->awaiters) {
+      keys.push_back(awaiter->key);
+    }
+
+    try {
+      auto values = batch_function(keys);
+      if (values.size() != keys.size()) {
+        throw std::length_error("batch function returned wrong number of values");
+      }
+      for (std::size_t i = 0; i < values.size(); i++) {
+        batch->awaiters[i]->value = std::move(values[i]);
+      }
+    } catch (...) {
+      auto exception_ptr = std::current_exception();
+      for (auto awaiter : batch->awaiters) {
+        awaiter->exception_ptr = exception_ptr;
+      }
+    }
+
+    // 恢复之后协程可能结束并销毁 awaiter，先取出所有 handle
+    std::vector<std::coroutine_handle<>> handles;
+    handles.reserve(batch->awaiters.size());
+    for (auto awaiter : batch->awaiters) {
+      handles.push_back(awaiter->handle);
+    }
+    for (auto handle : handles) {
+      handle.resume();
+    }
+  }
+
+  executor::LooperExecutor &executor;
+  BatchFunction batch_function;
+  std::size_t max_batch_size;
+  std::chrono::microseconds max_delay;
+
+  std::mutex batch_lock;
+  std::shared_ptr<Batch> current_batch;
+  std::size_t flushed_batches = 0;
+  std::size_t flushed_keys = 0;
+};
+
+void Run();
+
+} // namespace batch
+} // namespace co
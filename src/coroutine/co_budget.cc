@@ -0,0 +1,131 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <climits>
+#include <iostream>
+#include "co_task.h"
+#include "co_load.h"
+#include "co_budget.h"
+
+namespace co {
+namespace budget {
+
+namespace {
+
+std::atomic<int> operation_limit{ OPERATION_BUDGET };
+
+thread_local executor::AbstractExecutor *running_executor = nullptr;
+thread_local int remaining = INT_MAX;
+
+} // namespace
+
+BudgetScope::BudgetScope(executor::AbstractExecutor *executor)
+    : saved_executor(running_executor), saved_remaining(remaining) {
+  running_executor = executor;
+  auto operations = operation_limit.load(std::memory_order_relaxed);
+  remaining = operations > 0 ? operations : INT_MAX;
+}
+
+BudgetScope::~BudgetScope() {
+  running_executor = saved_executor;
+  remaining = saved_remaining;
+}
+
+void set_limit(int operations) {
+  operation_limit.store(operations, std::memory_order_relaxed);
+}
+
+int limit() {
+  return operation_limit.load(std::memory_order_relaxed);
+}
+
+bool consume() {
+  if (remaining > 0) {
+    remaining--;
+    return true;
+  }
+  return running_executor == nullptr;
+}
+
+void reschedule(std::coroutine_handle<> handle) {
+  if (running_executor) {
+    running_executor->execute([handle]() { handle.resume(); });
+  } else {
+    handle.resume();
+  }
+}
+
+executor::AbstractExecutor *current_executor() {
+  return running_executor;
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int HOG_STEPS = 2'000'000;
+constexpr auto PROBE_INTERVAL = std::chrono::milliseconds(1);
+
+task::Task<int> ready_step(int value) {
+  co_return value;
+}
+
+/**
+ * 一个很长的同步循环：每一步等待的 Task 都已经完成，不会挂起。
+ * yield_every 大于 0 时每隔这么多步手动让出一次
+*/
+task::Task<int64_t> hog(executor::LooperExecutor &executor, int yield_every) {
+  co_await executor::switch_to(executor);
+  int64_t sum = 0;
+  for (int i = 0; i < HOG_STEPS; i++) {
+    sum += co_await ready_step(i);
+    if (yield_every > 0 && i % yield_every == 0) {
+      co_await yield_now();
+    }
+  }
+  co_return sum;
+}
+
+/**
+ * 与 hog 共用一个事件循环，每隔 PROBE_INTERVAL 提交一个探针，
+ * 记录它从提交到开始执行的等待时间，即同一线程上其他逻辑看到的调度延迟
+*/
+void measure(const char *name, int operations, int yield_every) {
+  set_limit(operations);
+  executor::LooperExecutor executor;
+  load::Histogram probe_delays;
+  auto start = Clock::now();
+  auto task = hog(executor, yield_every);
+  while (!task.handle.promise().is_completed()) {
+    auto posted = Clock::now();
+    executor.execute([&probe_delays, posted]() {
+      probe_delays.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - posted).count());
+    });
+    std::this_thread::sleep_for(PROBE_INTERVAL);
+  }
+  auto sum = task.get_result();
+  auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  executor.shutdown();
+  std::cout << name << ": hog " << seconds * 1e3 << " ms, " << probe_delays.count() << " probes, delay p50 "
+            << probe_delays.value_at_percentile(50) / 1e3 << " us, p99 " << probe_delays.value_at_percentile(99) / 1e3
+            << " us, max " << probe_delays.max() / 1e3 << " us"
+            << (sum == int64_t(HOG_STEPS) * (HOG_STEPS - 1) / 2 ? "" : ", WRONG") << std::endl;
+}
+
+} // namespace
+
+void Run() {
+  std::cout << "start run budget" << std::endl;
+  std::cout << "hardware threads: " << std::thread::hardware_concurrency() << ", " << HOG_STEPS
+            << " ready awaits on one event loop" << std::endl;
+  auto saved = limit();
+  measure("no budget", 0, 0);
+  measure("budget 128", 128, 0);
+  measure("budget 1024", 1024, 0);
+  measure("no budget, yield_now every 1000", 0, 1000);
+  set_limit(saved);
+  std::cout << "end run budget" << std::endl;
+}
+
+} // namespace budget
+} // namespace co
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <coroutine>
+#include "co_executor.h"
+
+namespace co {
+namespace budget {
+
+// 默认的操作预算
+constexpr int OPERATION_BUDGET = 128;
+
+/**
+ * 协作式调度的预算：执行器每取出一个逻辑执行，当前线程的预算重置为 limit()。
+ * 等待已经完成的 Task、不需要等待的 Channel 操作都不会挂起，各消耗一次预算；
+ * 预算用完之后，下一次这样的等待改为在当前执行器上重新排队，
+ * 同一个线程上排在后面的逻辑因此不会被一个长时间不挂起的协程一直占住。
+ * 不在执行器线程上（例如在反应器线程上直接恢复）时不限制
+*/
+struct BudgetScope {
+  explicit BudgetScope(executor::AbstractExecutor *executor);
+  ~BudgetScope();
+
+  BudgetScope(BudgetScope &) = delete;
+  BudgetScope &operator=(BudgetScope &) = delete;
+
+private:
+  // 执行器可能嵌套执行（例如 NoopExecutor），退出时恢复外层的状态
+  executor::AbstractExecutor *saved_executor;
+  int saved_remaining;
+};
+
+// 修改之后新开始执行的逻辑生效，0 表示不限制
+void set_limit(int operations);
+
+int limit();
+
+// 消耗一次预算，预算已经用完并且当前线程正在执行某个执行器的逻辑时返回 false
+bool consume();
+
+// 在当前线程所属的执行器上重新排队，不在执行器上时直接恢复
+void reschedule(std::coroutine_handle<> handle);
+
+// 当前线程正在执行的逻辑所属的执行器，没有时为空
+executor::AbstractExecutor *current_executor();
+
+/**
+ * co_await yield_now() 主动让出：在当前执行器上重新排队，排在已经提交的逻辑之后。
+ * 不在执行器上时不挂起
+*/
+struct YieldAwaiter {
+  bool await_ready() const noexcept {
+    return current_executor() == nullptr;
+  }
+
+  void await_suspend(std::coroutine_handle<> handle) {
+    reschedule(handle);
+  }
+
+  void await_resume() const noexcept {}
+};
+
+inline YieldAwaiter yield_now() {
+  return {};
+}
+
+void Run();
+
+} // namespace budget
+
+using budget::yield_now;
+
+} // namespace co
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <deque>
+#include <cstddef>
+#include <utility>
+#include <optional>
+#include <coroutine>
+#include "co_budget.h"
+#include "co_executor.h"
+
+namespace co {
+namespace channel {
+
+/**
+ * 有界通道，协程之间按先进先出传递值：
+ * co_await channel.send(value) 在缓冲区满时挂起，co_await channel.receive() 在缓冲区空时挂起，
+ * 通道关闭并且缓冲区为空时 receive 返回空。
+ * 被对方唤醒的协程在 resume_on 上恢复，resume_on 为空时直接在对方的线程上恢复
+*/
+template <typename T>
+struct Channel {
+  struct SendAwaiter;
+  struct ReceiveAwaiter;
+
+  explicit Channel(std::size_t capacity) : capacity(capacity) {}
+
+  Channel(Channel &) = delete;
+  Channel &operator=(Channel &) = delete;
+
+  SendAwaiter send(T value, executor::AbstractExecutor *resume_on = nullptr) {
+    return SendAwaiter(this, std::move(value), resume_on);
+  }
+
+  ReceiveAwaiter receive(executor::AbstractExecutor *resume_on = nullptr) {
+    return ReceiveAwaiter(this, resume_on);
+  }
+
+  // 关闭之后 send 的值被丢弃，等待中的 receive 全部返回空，等待中的 send 全部恢复
+  void close() {
+    std::unique_lock lock(channel_lock);
+    closed = true;
+    auto receivers = std::move(waiting_receivers);
+    auto senders = std::move(waiting_senders);
+    waiting_receivers.clear();
+    waiting_senders.clear();
+    lock.unlock();
+    for (auto receiver : receivers) {
+      resume(receiver->handle, receiver->resume_on);
+    }
+    for (auto sender : senders) {
+      resume(sender->handle, sender->resume_on);
+    }
+  }
+
+  struct SendAwaiter {
+    constexpr bool await_ready() const noexcept {
+      return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+      this->handle = handle;
+      return channel->try_send(this) || channel->yield_if_exhausted(handle);
+    }
+
+    void await_resume() const noexcept {}
+
+    SendAwaiter(Channel *channel, T &&value, executor::AbstractExecutor *resume_on)
+        : channel(channel), value(std::move(value)), resume_on(resume_on) {}
+
+  private:
+    friend struct Channel;
+
+    Channel *channel;
+    T value;
+    executor::AbstractExecutor *resume_on;
+    std::coroutine_handle<> handle;
+  };
+
+  struct ReceiveAwaiter {
+    constexpr bool await_ready() const noexcept {
+      return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+      this->handle = handle;
+      return channel->try_receive(this) || channel->yield_if_exhausted(handle);
+    }
+
+    std::optional<T> await_resume() {
+      return std::move(value);
+    }
+
+    ReceiveAwaiter(Channel *channel, executor::AbstractExecutor *resume_on)
+        : channel(channel), resume_on(resume_on) {}
+
+  private:
+    friend struct Channel;
+
+    Channel *channel;
+    std::optional<T> value;
+    executor::AbstractExecutor *resume_on;
+    std::coroutine_handle<> handle;
+  };
+
+private:
+  static void resume(std::coroutine_handle<> handle, executor::AbstractExecutor *resume_on) {
+    if (resume_on) {
+      resume_on->execute([handle]() { handle.resume(); });
+    } else {
+      handle.resume();
+    }
+  }
+
+  // 不需要等待的操作也消耗一次预算，预算用完时在当前执行器上重新排队，返回 true 表示需要挂起
+  static bool yield_if_exhausted(std::coroutine_handle<> handle) {
+    if (budget::consume()) {
+      return false;
+    }
+    budget::reschedule(handle);
+    return true;
+  }
+
+  // 返回 true 表示需要挂起
+  bool try_send(SendAwaiter *sender) {
+    std::unique_lock lock(channel_lock);
+    if (closed) {
+      return false;
+    }
+    if (!waiting_receivers.empty()) {
+      // 有等待的接收方时直接交给它，不经过缓冲区
+      auto receiver = waiting_receivers.front();
+      waiting_receivers.pop_front();
+      receiver->value = std::move(sender->value);
+      lock.unlock();
+      resume(receiver->handle, receiver->resume_on);
+      return false;
+    }
+    if (buffer.size() < capacity) {
+      buffer.push_back(std::move(sender->value));
+      return false;
+    }
+    waiting_senders.push_back(sender);
+    return true;
+  }
+
+  bool try_receive(ReceiveAwaiter *receiver) {
+    std::unique_lock lock(channel_lock);
+    if (!buffer.empty()) {
+      receiver->value = std::move(buffer.front());
+      buffer.pop_front();
+      // 缓冲区空出一个位置，第一个等待的发送方的值进入缓冲区
+      if (!waiting_senders.empty()) {
+        auto sender = waiting_senders.front();
+        waiting_senders.pop_front();
+        buffer.push_back(std::move(sender->value));
+        lock.unlock();
+        resume(sender->handle, sender->resume_on);
+      }
+      return false;
+    }
+    if (!waiting_senders.empty()) {
+      // 容量为 0 时发送方直接把值交给接收方
+      auto sender = waiting_senders.front();
+      waiting_senders.pop_front();
+      receiver->value = std::move(sender->value);
+      lock.unlock();
+      resume(sender->handle, sender->resume_on);
+      return false;
+    }
+    if (closed) {
+      return false;
+    }
+    waiting_receivers.push_back(receiver);
+    return true;
+  }
+
+  std::size_t capacity;
+  std::mutex channel_lock;
+  std::deque<T> buffer;
+  std::list<SendAwaiter *> waiting_senders;
+  std::list<ReceiveAwaiter *> waiting_receivers;
+  bool closed = false;
+};
+
+} // namespace channel
+} // namespace co
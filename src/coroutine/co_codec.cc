@@ -0,0 +1,591 @@
+#include <array>
+#include <chrono>
+#include <string>
+#include <cstring>
+#include <utility>
+#include <iostream>
+#include <algorithm>
+#include "co_codec.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace co {
+namespace codec {
+
+namespace {
+
+// 编码结果末尾补齐的字节，SIMD 解码时可以越界读取而不必检查
+constexpr std::size_t PADDING = 16;
+
+uint32_t load32(const uint8_t *input) {
+  uint32_t value;
+  std::memcpy(&value, input, sizeof(value));
+  return value;
+}
+
+void put32(std::vector<uint8_t> &output, uint32_t value) {
+  auto size = output.size();
+  output.resize(size + sizeof(value));
+  std::memcpy(output.data() + size, &value, sizeof(value));
+}
+
+uint32_t bit_width(uint32_t value) {
+  return value == 0 ? 0 : 32 - __builtin_clz(value);
+}
+
+uint32_t low_mask(uint32_t bits) {
+  return bits >= 32 ? ~0u : (1u << bits) - 1;
+}
+
+// 按字节数计算一个数在 GroupVarint 中的长度，1~4 字节
+uint32_t byte_length(uint32_t value) {
+  return value < (1u << 8) ? 1 : value < (1u << 16) ? 2 : value < (1u << 24) ? 3 : 4;
+}
+
+} // namespace
+
+Kernel resolve_kernel([[maybe_unused]] Kernel kernel) {
+#if defined(__x86_64__) || defined(__i386__)
+  if (kernel != Kernel::Auto) {
+    return kernel;
+  }
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return Kernel::AVX2;
+  }
+  if (__builtin_cpu_supports("ssse3")) {
+    return Kernel::SSE;
+  }
+#endif
+  return Kernel::Scalar;
+}
+
+const char *codec_name(Codec codec) {
+  switch (codec) {
+    case Codec::Varint: return "varint";
+    case Codec::GroupVarint: return "group-varint";
+    case Codec::PFor: return "pfor";
+  }
+  return "unknown";
+}
+
+const char *kernel_name(Kernel kernel) {
+  switch (kernel) {
+    case Kernel::Auto: return "auto";
+    case Kernel::Scalar: return "scalar";
+    case Kernel::SSE: return "sse";
+    case Kernel::AVX2: return "avx2";
+  }
+  return "unknown";
+}
+
+// ---------------- 编码 ----------------
+
+void encode_varint(std::vector<uint8_t> &output, std::span<const uint32_t> values) {
+  for (auto value : values) {
+    while (value >= 0x80) {
+      output.push_back(static_cast<uint8_t>(value | 0x80));
+      value >>= 7;
+    }
+    output.push_back(static_cast<uint8_t>(value));
+  }
+}
+
+// 最后一组不满 4 个时补 0
+void encode_group_varint(std::vector<uint8_t> &output, std::span<const uint32_t> values) {
+  for (std::size_t i = 0; i < values.size(); i += 4) {
+    uint32_t group[4] = { 0, 0, 0, 0 };
+    std::copy(values.begin() + i, values.begin() + std::min(i + 4, values.size()), group);
+    uint8_t tag = 0;
+    for (int k = 0; k < 4; k++) {
+      tag |= (byte_length(group[k]) - 1) << (k * 2);
+    }
+    output.push_back(tag);
+    for (int k = 0; k < 4; k++) {
+      for (uint32_t j = 0; j < byte_length(group[k]); j++) {
+        output.push_back(static_cast<uint8_t>(group[k] >> (j * 8)));
+      }
+    }
+  }
+}
+
+/**
+ * PFor 块的格式：位宽 b（1 字节）、异常个数（2 字节）、8 * b 个 32 位字、
+ * 异常的位置（每个 1 字节）、异常的高位（每个 4 字节）。
+ * 第 i 个数属于第 i % 8 路，是这一路的第 i / 8 个数；每一路的数在自己的位流中依次排列，
+ * 第 w 个字存放在 w * 8 + 路号处，这样解码时一次 SIMD 加载就是 8 路的同一个字，
+ * 解出的 8 个数在输出中也正好是连续的
+*/
+void encode_pfor(std::vector<uint8_t> &output, std::span<const uint32_t> values) {
+  // 选择总字节数最少的位宽：位压缩部分 32 * b 字节，每个异常 5 字节
+  std::array<uint32_t, 33> histogram{};
+  for (auto value : values) {
+    histogram[bit_width(value)]++;
+  }
+  uint32_t best_bits = 32;
+  std::size_t best_cost = 32 * 32;
+  std::size_t exceptions = 0;
+  for (int bits = 32; bits >= 0; bits--) {
+    auto cost = 32 * bits + exceptions * 5;
+    if (cost <= best_cost) {
+      best_cost = cost;
+      best_bits = bits;
+    }
+    exceptions += histogram[bits];
+  }
+
+  std::array<uint32_t, 8 * 32> words{};
+  std::vector<uint8_t> positions;
+  std::vector<uint32_t> highs;
+  auto mask = low_mask(best_bits);
+  for (std::size_t i = 0; i < BLOCK_SIZE; i++) {
+    auto value = values[i];
+    if (bit_width(value) > best_bits) {
+      positions.push_back(static_cast<uint8_t>(i));
+      highs.push_back(value >> best_bits);
+    }
+    if (best_bits == 0) {
+      continue;
+    }
+    auto lane = i % 8;
+    auto bit = (i / 8) * best_bits;
+    auto word = bit / 32;
+    auto offset = bit % 32;
+    words[word * 8 + lane] |= (value & mask) << offset;
+    if (offset + best_bits > 32) {
+      words[(word + 1) * 8 + lane] |= (value & mask) >> (32 - offset);
+    }
+  }
+
+  output.push_back(static_cast<uint8_t>(best_bits));
+  output.push_back(static_cast<uint8_t>(positions.size()));
+  output.push_back(static_cast<uint8_t>(positions.size() >> 8));
+  for (uint32_t i = 0; i < 8 * best_bits; i++) {
+    put32(output, words[i]);
+  }
+  output.insert(output.end(), positions.begin(), positions.end());
+  for (auto high : highs) {
+    put32(output, high);
+  }
+}
+
+Encoder::Encoder(Codec codec) {
+  encoded.codec = codec;
+  pending.reserve(BLOCK_SIZE);
+  deltas.reserve(BLOCK_SIZE);
+}
+
+void Encoder::append(std::span<const uint32_t> values) {
+  while (!values.empty()) {
+    auto count = std::min(BLOCK_SIZE - pending.size(), values.size());
+    pending.insert(pending.end(), values.begin(), values.begin() + count);
+    values = values.subspan(count);
+    if (pending.size() == BLOCK_SIZE) {
+      encode_block(pending);
+      pending.clear();
+    }
+  }
+}
+
+EncodedSequence Encoder::finish() {
+  if (!pending.empty()) {
+    encode_block(pending);
+    pending.clear();
+  }
+  encoded.bytes.resize(encoded.bytes.size() + PADDING);
+  encoded.bytes.shrink_to_fit();
+  return std::move(encoded);
+}
+
+void Encoder::encode_block(std::span<const uint32_t> values) {
+  deltas.clear();
+  for (auto value : values) {
+    deltas.push_back(value - previous);
+    previous = value;
+  }
+  encoded.count += values.size();
+  switch (encoded.codec) {
+    case Codec::Varint:
+      encode_varint(encoded.bytes, deltas);
+      break;
+    case Codec::GroupVarint:
+      encode_group_varint(encoded.bytes, deltas);
+      break;
+    case Codec::PFor:
+      // 不满一块的尾部用 Varint
+      if (deltas.size() == BLOCK_SIZE) {
+        encode_pfor(encoded.bytes, deltas);
+      } else {
+        encode_varint(encoded.bytes, deltas);
+      }
+      break;
+  }
+}
+
+EncodedSequence encode(std::span<const uint32_t> values, Codec codec) {
+  Encoder encoder(codec);
+  encoder.append(values);
+  return encoder.finish();
+}
+
+EncodedSequence encode(generator::BatchGenerator<uint32_t> values, Codec codec) {
+  Encoder encoder(codec);
+  for (auto batch : values) {
+    encoder.append(batch);
+  }
+  return encoder.finish();
+}
+
+// ---------------- 解码 ----------------
+
+const uint8_t *decode_varint(const uint8_t *input, std::size_t count, uint32_t *output) {
+  for (std::size_t i = 0; i < count; i++) {
+    uint32_t value = *input & 0x7F;
+    // 绝大多数差值只有 1 字节
+    for (int shift = 7; *input++ & 0x80; shift += 7) {
+      value |= static_cast<uint32_t>(*input & 0x7F) << shift;
+    }
+    output[i] = value;
+  }
+  return input;
+}
+
+const uint8_t *decode_group_varint_scalar(const uint8_t *input, std::size_t count, uint32_t *output) {
+  for (std::size_t i = 0; i < count; i += 4) {
+    auto tag = *input++;
+    for (int k = 0; k < 4; k++) {
+      auto length = ((tag >> (k * 2)) & 3) + 1;
+      // 末尾有补齐的字节，可以直接读 4 个字节再截断
+      output[i + k] = load32(input) & low_mask(length * 8);
+      input += length;
+    }
+  }
+  return input;
+}
+
+struct GroupVarintTables {
+  alignas(16) std::array<std::array<int8_t, 16>, 256> shuffles;
+  std::array<uint8_t, 256> lengths;
+};
+
+// 每个标记对应的 pshufb 重排表：第 k 个数取自己的 1~4 个字节，其余字节置 0
+constexpr GroupVarintTables make_group_varint_tables() {
+  GroupVarintTables tables{};
+  for (int tag = 0; tag < 256; tag++) {
+    int source = 0;
+    for (int k = 0; k < 4; k++) {
+      auto length = ((tag >> (k * 2)) & 3) + 1;
+      for (int j = 0; j < 4; j++) {
+        tables.shuffles[tag][k * 4 + j] = static_cast<int8_t>(j < length ? source + j : -1);
+      }
+      source += length;
+    }
+    tables.lengths[tag] = static_cast<uint8_t>(source);
+  }
+  return tables;
+}
+
+constexpr auto GROUP_VARINT_TABLES = make_group_varint_tables();
+
+// 以下 SIMD 解码依赖 x86 的内建函数，其他平台都走标量版本
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("ssse3")))
+const uint8_t *decode_group_varint_sse(const uint8_t *input, std::size_t count, uint32_t *output) {
+  for (std::size_t i = 0; i < count; i += 4) {
+    auto tag = *input++;
+    auto data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input));
+    auto shuffle = _mm_load_si128(reinterpret_cast<const __m128i *>(GROUP_VARINT_TABLES.shuffles[tag].data()));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(output + i), _mm_shuffle_epi8(data, shuffle));
+    input += GROUP_VARINT_TABLES.lengths[tag];
+  }
+  return input;
+}
+#endif
+
+void unpack_scalar(const uint8_t *packed, uint32_t bits, uint32_t *output) {
+  if (bits == 0) {
+    std::fill(output, output + BLOCK_SIZE, 0);
+    return;
+  }
+  auto mask = low_mask(bits);
+  for (uint32_t lane = 0; lane < 8; lane++) {
+    uint32_t bit = 0;
+    for (uint32_t row = 0; row < 32; row++, bit += bits) {
+      auto word = bit / 32;
+      auto offset = bit % 32;
+      auto value = load32(packed + (word * 8 + lane) * 4) >> offset;
+      if (offset + bits > 32) {
+        value |= load32(packed + ((word + 1) * 8 + lane) * 4) << (32 - offset);
+      }
+      output[row * 8 + lane] = value & mask;
+    }
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/**
+ * SIMD 解包按位宽生成专门的版本，32 行完全展开，每行的字偏移和移位量都是常量
+*/
+using UnpackFunction = void (*)(const uint8_t *, uint32_t *);
+
+// 8 路分成两个 128 位向量处理
+template <uint32_t BITS>
+__attribute__((target("sse2")))
+void unpack_sse(const uint8_t *packed, uint32_t *output) {
+  if constexpr (BITS == 0) {
+    std::fill(output, output + BLOCK_SIZE, 0);
+  } else {
+    auto mask = _mm_set1_epi32(static_cast<int>(low_mask(BITS)));
+#pragma GCC unroll 32
+    for (uint32_t row = 0; row < 32; row++) {
+      auto bit = row * BITS;
+      auto word = packed + (bit / 32) * 32;
+      auto offset = bit % 32;
+      auto low = _mm_srli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(word)), offset);
+      auto high = _mm_srli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(word + 16)), offset);
+      if (offset + BITS > 32) {
+        auto next_low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(word + 32));
+        auto next_high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(word + 48));
+        low = _mm_or_si128(low, _mm_slli_epi32(next_low, 32 - offset));
+        high = _mm_or_si128(high, _mm_slli_epi32(next_high, 32 - offset));
+      }
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(output + row * 8), _mm_and_si128(low, mask));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(output + row * 8 + 4), _mm_and_si128(high, mask));
+    }
+  }
+}
+
+template <uint32_t BITS>
+__attribute__((target("avx2")))
+void unpack_avx2(const uint8_t *packed, uint32_t *output) {
+  if constexpr (BITS == 0) {
+    std::fill(output, output + BLOCK_SIZE, 0);
+  } else {
+    auto mask = _mm256_set1_epi32(static_cast<int>(low_mask(BITS)));
+#pragma GCC unroll 32
+    for (uint32_t row = 0; row < 32; row++) {
+      auto bit = row * BITS;
+      auto word = packed + (bit / 32) * 32;
+      auto offset = bit % 32;
+      auto value = _mm256_srli_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(word)), offset);
+      if (offset + BITS > 32) {
+        auto next = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(word + 32));
+        value = _mm256_or_si256(value, _mm256_slli_epi32(next, 32 - offset));
+      }
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(output + row * 8), _mm256_and_si256(value, mask));
+    }
+  }
+}
+
+template <uint32_t... BITS>
+constexpr std::array<UnpackFunction, sizeof...(BITS)> make_unpack_table(bool avx2,
+                                                                       std::integer_sequence<uint32_t, BITS...>) {
+  if (avx2) {
+    return { unpack_avx2<BITS>... };
+  }
+  return { unpack_sse<BITS>... };
+}
+
+const auto UNPACK_SSE = make_unpack_table(false, std::make_integer_sequence<uint32_t, 33>());
+const auto UNPACK_AVX2 = make_unpack_table(true, std::make_integer_sequence<uint32_t, 33>());
+#endif
+
+const uint8_t *decode_pfor(const uint8_t *input, Kernel kernel, uint32_t *output) {
+  uint32_t bits = input[0];
+  uint32_t exceptions = input[1] | (input[2] << 8);
+  input += 3;
+  switch (kernel) {
+#if defined(__x86_64__) || defined(__i386__)
+    case Kernel::AVX2: UNPACK_AVX2[bits](input, output); break;
+    case Kernel::SSE: UNPACK_SSE[bits](input, output); break;
+#endif
+    default: unpack_scalar(input, bits, output); break;
+  }
+  input += 32 * bits;
+  // 把异常的高位补回去
+  auto positions = input;
+  auto highs = input + exceptions;
+  for (uint32_t i = 0; i < exceptions; i++) {
+    output[positions[i]] |= load32(highs + i * 4) << bits;
+  }
+  return highs + exceptions * 4;
+}
+
+// 差分还原：就地求前缀和，返回最后一个值
+uint32_t prefix_sum_scalar(uint32_t *values, std::size_t count, uint32_t previous) {
+  for (std::size_t i = 0; i < count; i++) {
+    previous += values[i];
+    values[i] = previous;
+  }
+  return previous;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// 4 个一组在寄存器内求前缀和，再加上前一组的最后一个值；块内按 4 的倍数处理，超出 count 的部分不影响结果
+__attribute__((target("sse2")))
+uint32_t prefix_sum_sse(uint32_t *values, std::size_t count, uint32_t previous) {
+  auto carry = _mm_set1_epi32(static_cast<int>(previous));
+  for (std::size_t i = 0; i < count; i += 4) {
+    auto x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(values + i));
+    x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+    x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+    x = _mm_add_epi32(x, carry);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(values + i), x);
+    carry = _mm_shuffle_epi32(x, 0xFF);
+  }
+  return values[count - 1];
+}
+
+// 每个 128 位的半边各自求前缀和，再把低半边的最后一个值加到高半边
+__attribute__((target("avx2")))
+uint32_t prefix_sum_avx2(uint32_t *values, std::size_t count, uint32_t previous) {
+  auto carry = _mm256_set1_epi32(static_cast<int>(previous));
+  auto last_of_low = _mm256_set1_epi32(3);
+  auto last = _mm256_set1_epi32(7);
+  for (std::size_t i = 0; i < count; i += 8) {
+    auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+    x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+    x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+    auto low = _mm256_permutevar8x32_epi32(x, last_of_low);
+    x = _mm256_add_epi32(x, _mm256_blend_epi32(_mm256_setzero_si256(), low, 0xF0));
+    x = _mm256_add_epi32(x, carry);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(values + i), x);
+    carry = _mm256_permutevar8x32_epi32(x, last);
+  }
+  return values[count - 1];
+}
+#endif
+
+generator::BatchGenerator<uint32_t> decode(const EncodedSequence &encoded, Kernel kernel) {
+  kernel = resolve_kernel(kernel);
+#if defined(__x86_64__) || defined(__i386__)
+  auto decode_group_varint = kernel == Kernel::Scalar ? decode_group_varint_scalar : decode_group_varint_sse;
+  auto prefix_sum = kernel == Kernel::AVX2 ? prefix_sum_avx2 : kernel == Kernel::SSE ? prefix_sum_sse : prefix_sum_scalar;
+#else
+  auto decode_group_varint = decode_group_varint_scalar;
+  auto prefix_sum = prefix_sum_scalar;
+#endif
+
+  std::array<uint32_t, BLOCK_SIZE> block;
+  auto input = encoded.bytes.data();
+  auto remaining = encoded.count;
+  uint32_t previous = 0;
+  while (remaining > 0) {
+    auto count = std::min(BLOCK_SIZE, remaining);
+    switch (encoded.codec) {
+      case Codec::Varint:
+        input = decode_varint(input, count, block.data());
+        break;
+      case Codec::GroupVarint:
+        input = decode_group_varint(input, count, block.data());
+        break;
+      case Codec::PFor:
+        input = count == BLOCK_SIZE ? decode_pfor(input, kernel, block.data())
+                                    : decode_varint(input, count, block.data());
+        break;
+    }
+    previous = prefix_sum(block.data(), count, previous);
+    remaining -= count;
+    co_yield std::span<const uint32_t>(block.data(), count);
+  }
+}
+
+// ---------------- 测试 ----------------
+
+// 有序的文档编号：间隔大多在 1~16 之间，少数间隔很大
+std::vector<uint32_t> make_postings(std::size_t count) {
+  std::vector<uint32_t> values(count);
+  uint64_t state = 88172645463325252ULL;
+  uint32_t id = 0;
+  for (auto &value : values) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    id += state % 64 == 0 ? state % 4096 : 1 + state % 16;
+    value = id;
+  }
+  return values;
+}
+
+// 变长记录的偏移：记录长度在 100~1000 字节之间
+std::vector<uint32_t> make_offsets(std::size_t count) {
+  std::vector<uint32_t> values(count);
+  uint64_t state = 88172645463325252ULL;
+  uint32_t offset = 0;
+  for (auto &value : values) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    value = offset;
+    offset += 100 + state % 900;
+  }
+  return values;
+}
+
+// 不压缩时按同样的块产出
+generator::BatchGenerator<uint32_t> plain_blocks(const std::vector<uint32_t> &values) {
+  for (std::size_t begin = 0; begin < values.size(); begin += BLOCK_SIZE) {
+    co_yield std::span<const uint32_t>(values.data() + begin, std::min(BLOCK_SIZE, values.size() - begin));
+  }
+}
+
+template <typename Func>
+void measure(const std::string &name, std::size_t count, std::size_t bytes, Func &&func) {
+  constexpr int REPEAT = 5;
+  uint64_t checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < REPEAT; i++) {
+    checksum = 0;
+    // 只读取每块的最后一个值，测量的是解码本身的开销
+    for (auto block : func()) {
+      checksum += block.back();
+    }
+  }
+  auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / REPEAT;
+  std::cout << "  " << name << ": " << count / seconds / 1e9 << " G ints/s, " << static_cast<double>(bytes) / count
+            << " bytes/int, checksum " << checksum << std::endl;
+}
+
+void benchmark(const char *name, const std::vector<uint32_t> &values) {
+  std::cout << name << ": " << values.size() << " ints" << std::endl;
+  measure("plain", values.size(), values.size() * sizeof(uint32_t), [&]() { return plain_blocks(values); });
+  for (auto codec : { Codec::Varint, Codec::GroupVarint, Codec::PFor }) {
+    auto encoded = encode(plain_blocks(values), codec);
+    for (auto kernel : { Kernel::Scalar, Kernel::SSE, Kernel::AVX2 }) {
+      if (codec == Codec::Varint && kernel != Kernel::Scalar) {
+        continue;
+      }
+      // SSE、AVX2 只在这台机器能运行时测量
+      auto best = resolve_kernel(Kernel::Auto);
+      if ((kernel == Kernel::AVX2 && best != Kernel::AVX2) || (kernel == Kernel::SSE && best == Kernel::Scalar)) {
+        continue;
+      }
+      // 先确认解码结果与原始数据一致
+      std::size_t index = 0;
+      bool matched = true;
+      for (auto block : decode(encoded, kernel)) {
+        matched = matched && std::equal(block.begin(), block.end(), values.begin() + index);
+        index += block.size();
+      }
+      if (!matched || index != values.size()) {
+        std::cerr << codec_name(codec) << " " << kernel_name(kernel) << " result mismatch" << std::endl;
+      }
+      measure(std::string(codec_name(codec)) + " " + kernel_name(kernel), values.size(), encoded.size_bytes(),
+              [&]() { return decode(encoded, kernel); });
+    }
+  }
+}
+
+void Run() {
+  std::cout << "start run codec" << std::endl;
+  // 最后一块故意不满
+  constexpr std::size_t COUNT = (16 << 20) + 100;
+  benchmark("postings", make_postings(COUNT));
+  benchmark("offsets", make_offsets(COUNT));
+  std::cout << "end run codec" << std::endl;
+}
+
+} // namespace codec
+} // namespace co
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "co_generator.h"
+
+namespace co {
+namespace codec {
+
+// 编码和解码都按块进行，解码时每次产出一块
+constexpr std::size_t BLOCK_SIZE = 256;
+
+/**
+ * 整数序列先做差分（与前一个值相减，按无符号数回绕，有序序列的差值很小），再按以下方式压缩差值：
+ * Varint：每个数 1~5 字节，每字节 7 位数据，最高位表示后面还有字节；
+ * GroupVarint：4 个数一组，1 字节标记每个数占 1~4 字节，后面紧跟数据；
+ * PFor：每块选一个位宽 b，按 8 路交错的方式位压缩，放不下的少数值作为异常单独保存高位
+*/
+enum class Codec {
+  Varint,
+  GroupVarint,
+  PFor,
+};
+
+// 解码时使用的指令集，Varint 只有标量实现
+enum class Kernel {
+  Auto,
+  Scalar,
+  SSE,
+  AVX2,
+};
+
+// Auto 时按 CPU 支持的指令集选择；不是 x86 时总是 Scalar
+Kernel resolve_kernel(Kernel kernel);
+
+const char *codec_name(Codec codec);
+
+const char *kernel_name(Kernel kernel);
+
+struct EncodedSequence {
+  Codec codec = Codec::Varint;
+  // 原始整数的个数
+  std::size_t count = 0;
+  std::vector<uint8_t> bytes;
+
+  // 压缩后占用的内存
+  std::size_t size_bytes() const {
+    return bytes.size();
+  }
+};
+
+/**
+ * 流式编码器，可以分多次追加，凑满一块就编码一块，finish 之后不能再追加
+*/
+struct Encoder {
+  explicit Encoder(Codec codec);
+
+  void append(std::span<const uint32_t> values);
+
+  EncodedSequence finish();
+
+private:
+  void encode_block(std::span<const uint32_t> values);
+
+  EncodedSequence encoded;
+  std::vector<uint32_t> pending;
+  std::vector<uint32_t> deltas;
+  uint32_t previous = 0;
+};
+
+EncodedSequence encode(std::span<const uint32_t> values, Codec codec);
+
+// 消费按块产出的整数序列并编码
+EncodedSequence encode(generator::BatchGenerator<uint32_t> values, Codec codec);
+
+/**
+ * 解码，每次产出一块（最后一块可能不满），产出的块只在生成器下一次恢复之前有效，
+ * 解码过程中 encoded 需要保持有效
+*/
+generator::BatchGenerator<uint32_t> decode(const EncodedSequence &encoded, Kernel kernel = Kernel::Auto);
+
+void Run();
+
+} // namespace codec
+} // namespace co
@@ -0,0 +1,231 @@
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <optional>
+#include <thread>
+#include <vector>
+#include <climits>
+#include <iostream>
+#include <algorithm>
+#include "co_task.h"
+#include "co_budget.h"
+#include "co_executor.h"
+#include "co_continuation.h"
+
+namespace co {
+namespace continuation {
+
+namespace {
+
+std::atomic<int> depth_limit{ INLINE_DEPTH };
+
+thread_local int inline_depth = 0;
+// 超过深度上限并且没有执行器时推迟的恢复，由最外层的 resume 取出
+thread_local std::deque<std::coroutine_handle<>> trampoline;
+
+void resume_inline(std::coroutine_handle<> handle) {
+  inline_depth++;
+  handle.resume();
+  inline_depth--;
+}
+
+} // namespace
+
+void resume(std::coroutine_handle<> handle, executor::AbstractExecutor *executor) {
+  auto current = budget::current_executor();
+  if (executor && current != executor) {
+    executor->execute([handle]() { handle.resume(); });
+    return;
+  }
+  if (inline_depth >= depth_limit.load(std::memory_order_relaxed)) {
+    auto target = executor ? executor : current;
+    if (target) {
+      target->execute([handle]() { handle.resume(); });
+    } else {
+      trampoline.push_back(handle);
+    }
+    // 没有外层 resume 时（上限为 0）立即在这里取出
+    if (inline_depth > 0 || trampoline.empty()) {
+      return;
+    }
+  } else {
+    resume_inline(handle);
+    if (inline_depth > 0) {
+      return;
+    }
+  }
+  while (!trampoline.empty()) {
+    auto next = trampoline.front();
+    trampoline.pop_front();
+    resume_inline(next);
+  }
+}
+
+void set_inline_limit(int depth) {
+  depth_limit.store(depth, std::memory_order_relaxed);
+}
+
+int inline_limit() {
+  return depth_limit.load(std::memory_order_relaxed);
+}
+
+int depth() {
+  return inline_depth;
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int FANOUT = 16;
+constexpr int LEVELS = 4;
+constexpr int SHORT_CHAIN = 2'000;
+constexpr int LONG_CHAIN = 100'000;
+
+// 观察到的最大内联深度，每次只在一个线程上更新
+int max_depth = 0;
+
+void observe_depth() {
+  max_depth = std::max(max_depth, depth());
+}
+
+// 所有叶子等待同一个事件，open 在调用线程上依次恢复它们
+struct Gate {
+  struct Awaiter {
+    constexpr bool await_ready() const noexcept {
+      return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+      gate->waiting.push_back(handle);
+    }
+
+    void await_resume() const noexcept {}
+
+    Gate *gate;
+  };
+
+  Awaiter wait() {
+    return Awaiter{ this };
+  }
+
+  void open() {
+    auto handles = std::move(waiting);
+    for (auto handle : handles) {
+      continuation::resume(handle, nullptr);
+    }
+  }
+
+  std::vector<std::coroutine_handle<>> waiting;
+};
+
+task::Task<int64_t> leaf(Gate &gate) {
+  co_await gate.wait();
+  observe_depth();
+  co_return 1;
+}
+
+// 宽扇入：先启动所有子节点，再依次等待
+task::Task<int64_t> node(Gate &gate, int level) {
+  if (level == 0) {
+    co_return co_await leaf(gate);
+  }
+  std::vector<task::Task<int64_t>> children;
+  for (int i = 0; i < FANOUT; i++) {
+    children.push_back(node(gate, level - 1));
+  }
+  int64_t sum = 0;
+  for (auto &child : children) {
+    sum += co_await std::move(child);
+    observe_depth();
+  }
+  co_return sum;
+}
+
+task::Task<int64_t> link(task::Task<int64_t> previous) {
+  auto value = co_await std::move(previous);
+  observe_depth();
+  co_return value + 1;
+}
+
+// 长度为 length 的等待链，叶子完成之后每一环依次恢复下一环
+task::Task<int64_t> make_chain(Gate &gate, int length) {
+  std::optional<task::Task<int64_t>> chain;
+  chain.emplace(leaf(gate));
+  for (int i = 1; i < length; i++) {
+    auto next = link(std::move(*chain));
+    chain.emplace(std::move(next));
+  }
+  return std::move(*chain);
+}
+
+void report(const std::string &name, int limit, Clock::time_point start, int64_t result, int64_t expected,
+            int64_t continuations) {
+  auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+  std::cout << name << ", limit " << (limit == INT_MAX ? std::string("unlimited") : std::to_string(limit)) << ": "
+            << elapsed / continuations << " ns per continuation, max inline depth " << max_depth
+            << (result == expected ? ", correct" : ", WRONG") << std::endl;
+}
+
+void run_tree(int limit) {
+  set_inline_limit(limit);
+  max_depth = 0;
+  Gate gate;
+  auto root = node(gate, LEVELS);
+  // 每个叶子被 gate 恢复一次，每个非根节点和叶子完成时各恢复一次等待方
+  int64_t leaves = 1;
+  int64_t continuations = 0;
+  for (int i = 0; i < LEVELS; i++) {
+    leaves *= FANOUT;
+    continuations += leaves;
+  }
+  continuations += leaves * 2;
+  auto start = Clock::now();
+  gate.open();
+  auto result = root.get_result();
+  report("fan-in tree " + std::to_string(FANOUT) + "^" + std::to_string(LEVELS), limit, start, result, leaves,
+         continuations);
+}
+
+// executor 不为空时在它上面打开 gate，超过上限的恢复提交到这个执行器，否则在当前线程上用蹦床
+void run_chain(int length, int limit, executor::AbstractExecutor *executor) {
+  set_inline_limit(limit);
+  max_depth = 0;
+  Gate gate;
+  auto chain = make_chain(gate, length);
+  auto start = Clock::now();
+  if (executor) {
+    executor->execute([&gate]() { gate.open(); });
+  } else {
+    gate.open();
+  }
+  auto result = chain.get_result();
+  report("chain of " + std::to_string(length) + (executor ? " on event loop" : " on caller thread"), limit, start,
+         result, length, length);
+}
+
+} // namespace
+
+void Run() {
+  std::cout << "start run continuation" << std::endl;
+  auto saved = inline_limit();
+  for (int limit : { INT_MAX, INLINE_DEPTH, 0 }) {
+    run_tree(limit);
+  }
+  // 不限制深度时链的每一环都在上一环的调用栈里恢复，链太长会栈溢出，这里只用较短的链比较
+  for (int limit : { INT_MAX, INLINE_DEPTH, 0 }) {
+    run_chain(SHORT_CHAIN, limit, nullptr);
+  }
+  run_chain(LONG_CHAIN, INLINE_DEPTH, nullptr);
+  {
+    executor::LooperExecutor executor;
+    run_chain(LONG_CHAIN, INLINE_DEPTH, &executor);
+    executor.shutdown();
+  }
+  set_inline_limit(saved);
+  std::cout << "end run continuation" << std::endl;
+}
+
+} // namespace continuation
+} // namespace co
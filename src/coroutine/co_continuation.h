@@ -0,0 +1,35 @@
+#pragma once
+
+#include <coroutine>
+#include "co_executor.h"
+
+namespace co {
+namespace continuation {
+
+// 默认的内联嵌套深度上限
+constexpr int INLINE_DEPTH = 32;
+
+/**
+ * 恢复等待方（continuation）的策略：
+ * 等待方有自己的执行器并且当前线程不在这个执行器上时，提交到这个执行器；
+ * 否则直接在当前线程上恢复，但同一个线程上嵌套恢复的深度超过 inline_limit() 时不再内联：
+ * 有执行器时提交到执行器（等待方自己的，或者当前线程正在执行的），
+ * 都没有时放进当前线程的蹦床队列，由最外层的 resume 返回之前依次恢复。
+ * 一个 Task 完成时会恢复它的等待方，等待方完成又会恢复它的等待方，
+ * 限制深度之后这样的连锁恢复不会无限加深调用栈。
+ * 调用时不能持有任何 promise 的锁
+*/
+void resume(std::coroutine_handle<> handle, executor::AbstractExecutor *executor);
+
+// 修改内联嵌套深度上限，0 表示总是提交
+void set_inline_limit(int depth);
+
+int inline_limit();
+
+// 当前线程上 resume 内联嵌套的深度
+int depth();
+
+void Run();
+
+} // namespace continuation
+} // namespace co
@@ -0,0 +1,408 @@
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <unistd.h>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+#include "co_csv.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace co {
+namespace csv {
+
+/**
+ * 一个 64 字节块的扫描结果，每个 bit 对应块中的一个字节。
+ * quote_region 为引号字符的前缀异或，引号内（含开引号，不含闭引号）的 bit 为 1，还没有考虑上一个块带过来的状态
+*/
+struct BlockMasks {
+  uint64_t quote_region;
+  uint64_t delimiter;
+  uint64_t newline;
+};
+
+using ScanFunction = BlockMasks (*)(const char *block, char delimiter, char quote);
+
+uint64_t prefix_xor(uint64_t bits) {
+  bits ^= bits << 1;
+  bits ^= bits << 2;
+  bits ^= bits << 4;
+  bits ^= bits << 8;
+  bits ^= bits << 16;
+  bits ^= bits << 32;
+  return bits;
+}
+
+BlockMasks scan_scalar(const char *block, char delimiter, char quote) {
+  uint64_t quotes = 0;
+  BlockMasks masks{ 0, 0, 0 };
+  for (int i = 0; i < 64; i++) {
+    auto c = block[i];
+    quotes |= static_cast<uint64_t>(c == quote) << i;
+    masks.delimiter |= static_cast<uint64_t>(c == delimiter) << i;
+    masks.newline |= static_cast<uint64_t>(c == '\n') << i;
+  }
+  masks.quote_region = prefix_xor(quotes);
+  return masks;
+}
+
+// SIMD 实现只在 x86 上编译，其他平台只有标量实现
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+BlockMasks scan_sse(const char *block, char delimiter, char quote) {
+  auto quote_vector = _mm_set1_epi8(quote);
+  auto delimiter_vector = _mm_set1_epi8(delimiter);
+  auto newline_vector = _mm_set1_epi8('\n');
+  uint64_t quotes = 0;
+  BlockMasks masks{ 0, 0, 0 };
+  for (int i = 0; i < 4; i++) {
+    auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + i * 16));
+    auto shift = i * 16;
+    quotes |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, quote_vector)))) << shift;
+    masks.delimiter |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, delimiter_vector)))) << shift;
+    masks.newline |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline_vector)))) << shift;
+  }
+  masks.quote_region = prefix_xor(quotes);
+  return masks;
+}
+
+__attribute__((target("avx2")))
+inline uint64_t match_avx2(__m256i low, __m256i high, char c) {
+  auto target = _mm256_set1_epi8(c);
+  uint64_t low_bits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, target)));
+  uint64_t high_bits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, target)));
+  return low_bits | (high_bits << 32);
+}
+
+__attribute__((target("avx2,pclmul")))
+BlockMasks scan_avx2(const char *block, char delimiter, char quote) {
+  auto low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block));
+  auto high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + 32));
+  auto quotes = match_avx2(low, high, quote);
+  // 与全 1 做无进位乘法即为前缀异或
+  auto region = _mm_clmulepi64_si128(_mm_set_epi64x(0, static_cast<int64_t>(quotes)), _mm_set1_epi8(-1), 0);
+  return BlockMasks{
+    static_cast<uint64_t>(_mm_cvtsi128_si64(region)),
+    match_avx2(low, high, delimiter),
+    match_avx2(low, high, '\n'),
+  };
+}
+#endif
+
+Kernel resolve_kernel([[maybe_unused]] Kernel kernel) {
+#if defined(__x86_64__) || defined(__i386__)
+  if (kernel != Kernel::Auto) {
+    return kernel;
+  }
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("pclmul")) {
+    return Kernel::AVX2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return Kernel::SSE;
+  }
+#endif
+  return Kernel::Scalar;
+}
+
+const char *kernel_name(Kernel kernel) {
+  switch (kernel) {
+    case Kernel::Auto: return "auto";
+    case Kernel::Scalar: return "scalar";
+    case Kernel::SSE: return "sse";
+    case Kernel::AVX2: return "avx2";
+  }
+  return "unknown";
+}
+
+ScanFunction scan_function(Kernel kernel) {
+  switch (resolve_kernel(kernel)) {
+#if defined(__x86_64__) || defined(__i386__)
+    case Kernel::AVX2: return scan_avx2;
+    case Kernel::SSE: return scan_sse;
+#endif
+    default: return scan_scalar;
+  }
+}
+
+/**
+ * 把缓冲区切分为行和字段，分两步完成：
+ *   1. 逐块扫描，块之间通过 in_quote 传递是否处于引号内，把引号外的分隔符和换行的位置写入 indexes，
+ *      每个块一次写入 8 个位置，不按字节或字段分支
+ *   2. 相邻两个位置之间就是一个字段，遇到换行结束一行
+*/
+struct Tokenizer {
+  explicit Tokenizer(const CsvOptions &options) : options(options), scan(scan_function(options.kernel)) {}
+
+  // 切分 [data, data + size) 中所有完整的行，返回已经消费的字节数；last 为 true 时末尾没有换行的部分也作为一行
+  std::size_t tokenize(const char *data, std::size_t size, bool last) {
+    auto index_count = find_structurals(data, size);
+
+    fields.clear();
+    row_ends.clear();
+    rows.clear();
+    std::size_t field_start = 0;
+    std::size_t row_start = 0;
+    for (std::size_t i = 0; i < index_count; i++) {
+      auto index = indexes[i];
+      auto is_newline = data[index] == '\n';
+      fields.push_back(make_field(data, field_start, index, is_newline));
+      if (is_newline) {
+        row_ends.push_back(fields.size());
+        row_start = index + 1;
+      }
+      field_start = index + 1;
+    }
+
+    if (last && row_start < size) {
+      fields.push_back(make_field(data, field_start, size, true));
+      row_ends.push_back(fields.size());
+      row_start = size;
+    }
+
+    // 不完整的行里已经切出来的字段直接丢弃，下次和后续输入一起重新切分；fields 不再变化，可以安全地引用
+    std::size_t row_begin = 0;
+    for (auto row_end : row_ends) {
+      rows.emplace_back(fields.data() + row_begin, row_end - row_begin);
+      row_begin = row_end;
+    }
+    return row_start;
+  }
+
+  std::span<const CsvRow> batch() const {
+    return rows;
+  }
+
+private:
+  std::size_t find_structurals(const char *data, std::size_t size) {
+    // 每个块最多 64 个位置，展开写入时最多多写 7 个
+    if (indexes.size() < size + 72) {
+      indexes.resize(size + 72);
+    }
+    auto output = indexes.data();
+    uint64_t in_quote = 0;
+    alignas(64) char tail[64];
+    for (std::size_t position = 0; position < size; position += 64) {
+      auto block = data + position;
+      auto length = std::min<std::size_t>(64, size - position);
+      uint64_t valid = ~uint64_t(0);
+      if (length < 64) {
+        // 最后一个不完整的块补零再扫描
+        std::memset(tail, 0, sizeof(tail));
+        std::memcpy(tail, block, length);
+        block = tail;
+        valid = (uint64_t(1) << length) - 1;
+      }
+
+      auto masks = scan(block, options.delimiter, options.quote);
+      auto region = masks.quote_region ^ in_quote;
+      // 最高位表示块结束时是否还在引号内，算术右移扩展为全 0 或全 1
+      in_quote = static_cast<uint64_t>(static_cast<int64_t>(region) >> 63);
+
+      auto structural = (masks.delimiter | masks.newline) & ~region & valid;
+      auto count = __builtin_popcountll(structural);
+      auto next = output + count;
+      auto base = static_cast<uint32_t>(position);
+      while (structural) {
+        for (int i = 0; i < 8; i++) {
+          output[i] = base + __builtin_ctzll(structural | (uint64_t(1) << 63));
+          structural &= structural - 1;
+        }
+        output += 8;
+      }
+      output = next;
+    }
+    return output - indexes.data();
+  }
+
+  std::string_view make_field(const char *data, std::size_t begin, std::size_t end, bool at_line_end) const {
+    if (at_line_end && end > begin && data[end - 1] == '\r') {
+      end--;
+    }
+    if (end - begin >= 2 && data[begin] == options.quote && data[end - 1] == options.quote) {
+      begin++;
+      end--;
+    }
+    return { data + begin, end - begin };
+  }
+
+  CsvOptions options;
+  ScanFunction scan;
+  std::vector<uint32_t> indexes;
+  std::vector<std::string_view> fields;
+  std::vector<std::size_t> row_ends;
+  std::vector<CsvRow> rows;
+};
+
+generator::BatchGenerator<char> file_chunks(std::string path, std::size_t chunk_size) {
+  auto fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "open " + path);
+  }
+  // 协程被提前销毁时也要关闭文件
+  struct FileCloser {
+    int fd;
+    ~FileCloser() { ::close(fd); }
+  } closer{ fd };
+
+  std::vector<char> chunk(chunk_size);
+  while (true) {
+    auto size = ::read(fd, chunk.data(), chunk.size());
+    if (size < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(), "read " + path);
+    }
+    if (size == 0) {
+      break;
+    }
+    co_yield std::span<const char>(chunk.data(), size);
+  }
+}
+
+generator::BatchGenerator<CsvRow> csv_rows(generator::BatchGenerator<char> chunks, CsvOptions options) {
+  Tokenizer tokenizer(options);
+  std::vector<char> buffer;
+  std::size_t size = 0;
+  bool exhausted = false;
+  while (!exhausted) {
+    if (chunks.has_next()) {
+      auto chunk = chunks.next();
+      if (buffer.size() < size + chunk.size()) {
+        buffer.resize(size + chunk.size());
+      }
+      std::memcpy(buffer.data() + size, chunk.data(), chunk.size());
+      size += chunk.size();
+    } else {
+      exhausted = true;
+    }
+
+    auto consumed = tokenizer.tokenize(buffer.data(), size, exhausted);
+    if (!tokenizer.batch().empty()) {
+      co_yield tokenizer.batch();
+    }
+    // 不完整的行移到缓冲区开头，行首一定在引号之外，下次从这里重新扫描
+    std::memmove(buffer.data(), buffer.data() + consumed, size - consumed);
+    size -= consumed;
+  }
+}
+
+struct CsvStats {
+  uint64_t rows = 0;
+  uint64_t fields = 0;
+  uint64_t field_bytes = 0;
+
+  bool operator==(const CsvStats &) const = default;
+};
+
+// 对照：逐字节的状态机，只统计不产出字段
+CsvStats scan_bytewise(const std::string &path, char delimiter, char quote) {
+  CsvStats stats;
+  bool in_quote = false;
+  uint64_t field_bytes = 0;
+  bool pending = false;
+  auto end_field = [&](bool at_line_end, char last, char first) {
+    auto bytes = field_bytes;
+    if (at_line_end && bytes > 0 && last == '\r') {
+      bytes--;
+    }
+    if (bytes >= 2 && first == quote && last == quote) {
+      bytes -= 2;
+    }
+    stats.fields++;
+    stats.field_bytes += bytes;
+    field_bytes = 0;
+  };
+  char first = 0;
+  char last = 0;
+  for (auto chunk : file_chunks(path)) {
+    for (auto c : chunk) {
+      if (c == quote) {
+        in_quote = !in_quote;
+      } else if (!in_quote && (c == delimiter || c == '\n')) {
+        end_field(c == '\n', last, first);
+        if (c == '\n') {
+          stats.rows++;
+        }
+        pending = false;
+        continue;
+      }
+      if (field_bytes == 0) {
+        first = c;
+      }
+      last = c;
+      field_bytes++;
+      pending = true;
+    }
+  }
+  if (pending) {
+    end_field(true, last, first);
+    stats.rows++;
+  }
+  return stats;
+}
+
+void Run() {
+  std::cout << "start run csv" << std::endl;
+  auto path = (std::filesystem::temp_directory_path() / "co_csv.csv").string();
+  std::size_t file_size = 0;
+  {
+    // 混合普通字段、带分隔符的引号字段和跨行的引号字段
+    std::ofstream output(path, std::ios::trunc);
+    std::mt19937 random(3);
+    for (int i = 0; i < 2000000; i++) {
+      output << i << ",user" << random() % 100000 << ',' << (random() % 100000) / 100.0 << ",\"city, state\","
+             << (i % 10 == 0 ? "\"line one\nline \"\"two\"\"\"" : "plain") << ",tag" << i % 13 << "\r\n";
+    }
+    file_size = output.tellp();
+  }
+
+  auto measure = [&](const char *name, auto &&func) {
+    auto start = std::chrono::steady_clock::now();
+    CsvStats stats = func();
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << name << ": " << file_size / seconds / (1 << 30) << " GB/s, " << stats.rows << " rows, "
+              << stats.fields << " fields, " << stats.field_bytes << " field bytes" << std::endl;
+    return stats;
+  };
+
+  auto expected = measure("bytewise", [&]() { return scan_bytewise(path, ',', '"'); });
+  for (auto kernel : { Kernel::Scalar, Kernel::SSE, Kernel::AVX2 }) {
+    // 跳过当前机器不支持的实现，不是 x86 时只有标量实现
+    auto best = resolve_kernel(Kernel::Auto);
+    if ((kernel == Kernel::AVX2 && best != Kernel::AVX2) || (kernel == Kernel::SSE && best == Kernel::Scalar)) {
+      continue;
+    }
+    auto stats = measure(kernel_name(kernel), [&]() {
+      CsvStats stats;
+      for (auto batch : csv_rows(file_chunks(path), { .kernel = kernel })) {
+        stats.rows += batch.size();
+        for (auto row : batch) {
+          stats.fields += row.size();
+          for (auto field : row) {
+            stats.field_bytes += field.size();
+          }
+        }
+      }
+      return stats;
+    });
+    if (!(stats == expected)) {
+      std::cerr << kernel_name(kernel) << " result mismatch" << std::endl;
+    }
+  }
+  std::filesystem::remove(path);
+  std::cout << "end run csv" << std::endl;
+}
+
+} // namespace csv
+} // namespace co
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <cstddef>
+#include <string_view>
+#include "co_generator.h"
+
+namespace co {
+namespace csv {
+
+// 一行由若干个字段组成，字段直接引用输入缓冲区，只在生成器下一次恢复之前有效
+using CsvRow = std::span<const std::string_view>;
+
+// 按 64 字节的块查找分隔符、换行和引号时使用的指令集
+enum class Kernel {
+  Auto,
+  Scalar,
+  SSE,
+  AVX2,
+};
+
+struct CsvOptions {
+  char delimiter = ',';
+  char quote = '"';
+  Kernel kernel = Kernel::Auto;
+};
+
+// Auto 时按 CPU 支持的指令集选择；不是 x86 时总是 Scalar
+Kernel resolve_kernel(Kernel kernel);
+
+const char *kernel_name(Kernel kernel);
+
+/**
+ * 按块读取文件，每次产出最多 chunk_size 个字节，读取失败时抛出 std::system_error
+*/
+generator::BatchGenerator<char> file_chunks(std::string path, std::size_t chunk_size = 1 << 20);
+
+/**
+ * 流式切分 CSV，每次产出当前缓冲区中所有完整的行。
+ * 引号内的分隔符和换行不会切分字段，引号可以跨越 64 字节的块以及输入块的边界；
+ * 字段两端的引号会被去掉，但字段内转义的 "" 保持原样，行尾的 \r 会被去掉
+*/
+generator::BatchGenerator<CsvRow> csv_rows(generator::BatchGenerator<char> chunks, CsvOptions options = {});
+
+void Run();
+
+} // namespace csv
+} // namespace co
@@ -0,0 +1,132 @@
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <unistd.h>
+#include <system_error>
+#include "co_task.h"
+#include "co_reactor.h"
+#include "co_deadline.h"
+
+namespace co {
+namespace deadline {
+
+namespace {
+
+using namespace std::chrono_literals;
+
+constexpr int PIPES = 200;
+
+double milliseconds(Clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+task::Task<Clock::duration> child_remaining(Clock::duration timeout) {
+  set_timeout(timeout);
+  co_return co_await remaining_time();
+}
+
+// 子协程设置的截止时间晚于父协程时不生效，早于父协程时只影响它自己
+task::Task<void> inheritance() {
+  set_timeout(50ms);
+  auto looser = co_await child_remaining(200ms);
+  auto tighter = co_await child_remaining(10ms);
+  auto own = co_await remaining_time();
+  std::cout << "parent 50 ms: child asking 200 ms gets " << milliseconds(looser) << " ms, child asking 10 ms gets "
+            << milliseconds(tighter) << " ms, parent still has " << milliseconds(own) << " ms" << std::endl;
+}
+
+task::Task<Clock::duration> sleep_past_deadline(executor::LooperExecutor &executor) {
+  set_timeout(20ms);
+  auto start = Clock::now();
+  try {
+    co_await sleep_for(executor, 1s);
+  } catch (DeadlineExceeded &) {
+    co_return Clock::now() - start;
+  }
+  co_return Clock::duration::max();
+}
+
+/**
+ * 在 fd 上等待可读，截止时间为 timeout 之后；
+ * 超时返回恢复时间比截止时间晚了多久，数据先到时返回负数
+*/
+task::Task<Clock::duration> read_with_timeout(reactor::Reactor &reactor, int fd, Clock::duration timeout) {
+  set_timeout(timeout);
+  auto expires = current();
+  try {
+    co_await reactor.readable(fd);
+  } catch (DeadlineExceeded &) {
+    co_return Clock::now() - expires;
+  }
+  co_return Clock::duration(-1);
+}
+
+void make_pipe(int fds[2]) {
+  if (::pipe(fds) < 0) {
+    throw std::system_error(errno, std::generic_category(), "pipe");
+  }
+}
+
+} // namespace
+
+void Run() {
+  std::cout << "start run deadline" << std::endl;
+  inheritance().get_result();
+  std::cout << "outside any task: " << (remaining() == Clock::duration::max() ? "no deadline" : "deadline")
+            << std::endl;
+
+  {
+    executor::LooperExecutor executor;
+    auto slept = sleep_past_deadline(executor).get_result();
+    std::cout << "sleep 1 s under a 20 ms deadline: DeadlineExceeded after " << milliseconds(slept) << " ms"
+              << std::endl;
+    executor.shutdown();
+  }
+
+  {
+    reactor::Reactor reactor;
+    std::vector<int> fds(PIPES * 2);
+    for (int i = 0; i < PIPES; i++) {
+      make_pipe(&fds[i * 2]);
+    }
+    // 每个管道都没有数据，截止时间分布在 10 ms 到 30 ms 之间；最后一个管道在截止时间之前写入数据
+    std::vector<task::Task<Clock::duration>> waits;
+    for (int i = 0; i < PIPES; i++) {
+      auto timeout = i == PIPES - 1 ? 1s : 10ms + i * 100us;
+      waits.push_back(read_with_timeout(reactor, fds[i * 2], timeout));
+    }
+    std::this_thread::sleep_for(40ms);
+    char byte = 1;
+    [[maybe_unused]] auto written = ::write(fds[(PIPES - 1) * 2 + 1], &byte, 1);
+    int expired = 0;
+    Clock::duration total{ 0 };
+    Clock::duration latest{ 0 };
+    bool data_won = false;
+    for (int i = 0; i < PIPES; i++) {
+      auto lateness = waits[i].get_result();
+      if (lateness < Clock::duration::zero()) {
+        data_won = i == PIPES - 1;
+        continue;
+      }
+      expired++;
+      total += lateness;
+      latest = std::max(latest, lateness);
+    }
+    std::cout << PIPES - 1 << " reactor reads with 10-30 ms deadlines: " << expired << " timed out, lateness mean "
+              << milliseconds(total) / std::max(expired, 1) << " ms, max " << milliseconds(latest)
+              << " ms; read with data before its deadline " << (data_won ? "completed" : "WRONG") << std::endl;
+    for (int i = 0; i < PIPES; i++) {
+      reactor.forget(fds[i * 2]);
+    }
+    reactor.shutdown();
+    for (auto fd : fds) {
+      ::close(fd);
+    }
+  }
+  std::cout << "end run deadline" << std::endl;
+}
+
+} // namespace deadline
+} // namespace co
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cerrno>
+#include <chrono>
+#include <algorithm>
+#include <coroutine>
+#include <system_error>
+#include "co_local.h"
+#include "co_executor.h"
+
+namespace co {
+namespace deadline {
+
+using Clock = std::chrono::steady_clock;
+
+// 没有截止时间
+constexpr Clock::time_point NONE = Clock::time_point::max();
+
+// 操作因为截止时间已过而失败
+struct DeadlineExceeded : std::system_error {
+  explicit DeadlineExceeded(const char *operation) : std::system_error(ETIMEDOUT, std::generic_category(), operation) {}
+};
+
+/**
+ * 截止时间保存在协程局部存储里：子协程创建时继承父协程的截止时间，
+ * 自己设置时只能提前，实际生效的是 min(父协程, 子协程)
+*/
+inline const local::Slot<Clock::time_point> &slot() {
+  static local::Slot<Clock::time_point> deadline;
+  return deadline;
+}
+
+// 当前协程的截止时间，没有时为 NONE
+inline Clock::time_point current() {
+  return slot().get_or(NONE);
+}
+
+// 设置当前协程的截止时间，晚于已有的截止时间时不生效；不在协程中时抛出 std::logic_error
+inline void set(Clock::time_point deadline) {
+  if (deadline < current()) {
+    slot().set(deadline);
+  }
+}
+
+inline void set_timeout(Clock::duration timeout) {
+  set(Clock::now() + timeout);
+}
+
+/**
+ * 去掉当前协程的截止时间，只用于生命周期与请求无关的后台协程，
+ * 例如在某个请求中建立的连接的读写循环
+*/
+inline void clear() {
+  slot().reset();
+}
+
+// 距离截止时间还有多久，已过时为 0，没有截止时间时为 Clock::duration::max()
+inline Clock::duration remaining() {
+  auto deadline = current();
+  if (deadline == NONE) {
+    return Clock::duration::max();
+  }
+  return std::max(deadline - Clock::now(), Clock::duration::zero());
+}
+
+inline bool expired() {
+  auto deadline = current();
+  return deadline != NONE && Clock::now() >= deadline;
+}
+
+// 截止时间已过时抛出 DeadlineExceeded
+inline void check(const char *operation) {
+  if (expired()) {
+    throw DeadlineExceeded(operation);
+  }
+}
+
+// co_await remaining_time() 不挂起，返回 remaining()
+struct RemainingAwaiter {
+  constexpr bool await_ready() const noexcept {
+    return true;
+  }
+
+  constexpr void await_suspend(std::coroutine_handle<>) const noexcept {}
+
+  Clock::duration await_resume() const {
+    return remaining();
+  }
+};
+
+inline RemainingAwaiter remaining_time() {
+  return {};
+}
+
+/**
+ * co_await sleep_for(executor, duration) 在 executor 上延迟之后恢复；
+ * 截止时间先到时在截止时间恢复，并抛出 DeadlineExceeded
+*/
+struct SleepAwaiter {
+  bool await_ready() {
+    auto left = remaining();
+    truncated = left < duration;
+    duration = std::min(duration, left);
+    return duration <= Clock::duration::zero();
+  }
+
+  void await_suspend(std::coroutine_handle<> handle) {
+    executor.execute_delayed([handle]() { handle.resume(); }, duration);
+  }
+
+  void await_resume() const {
+    if (truncated) {
+      throw DeadlineExceeded("sleep");
+    }
+  }
+
+  executor::LooperExecutor &executor;
+  Clock::duration duration;
+  bool truncated = false;
+};
+
+inline SleepAwaiter sleep_for(executor::LooperExecutor &executor, Clock::duration duration) {
+  return SleepAwaiter{ executor, duration };
+}
+
+void Run();
+
+} // namespace deadline
+
+using deadline::remaining_time;
+
+} // namespace co
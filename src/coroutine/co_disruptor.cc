@@ -0,0 +1,243 @@
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <condition_variable>
+#include "co_channel.h"
+#include "co_disruptor.h"
+
+namespace co {
+namespace disruptor {
+
+namespace {
+
+constexpr int64_t EVENT_COUNT = 5'000'000;
+constexpr std::size_t RING_SIZE = 1024;
+constexpr std::size_t CLAIM_BATCH = 64;
+
+struct Event {
+  int64_t value = 0;
+  int64_t result = 0;
+};
+
+// 三个阶段对事件做的处理，各种实现都相同
+int64_t first_step(int64_t value) {
+  return value * 3;
+}
+
+int64_t second_step(int64_t value, int64_t result) {
+  return result + (value ^ 0x5bd1e995);
+}
+
+int64_t expected_sum() {
+  int64_t sum = 0;
+  for (int64_t i = 0; i < EVENT_COUNT; i++) {
+    sum += second_step(i, first_step(i));
+  }
+  return sum;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+task::Task<void> produce(executor::AbstractExecutor &executor, RingBuffer<Event> &ring) {
+  co_await executor::switch_to(executor);
+  for (int64_t next = 0; next < EVENT_COUNT;) {
+    auto count = std::min<int64_t>(CLAIM_BATCH, EVENT_COUNT - next);
+    auto last = co_await ring.claim(count, &executor);
+    for (; next <= last; next++) {
+      ring[next].value = next;
+    }
+    ring.publish(last);
+  }
+  ring.close();
+}
+
+// 生产者和三个阶段各自在一个事件循环线程上运行
+int64_t run_disruptor(std::size_t spin_budget) {
+  RingBuffer<Event> ring(RING_SIZE, spin_budget);
+  Sequence first;
+  Sequence second;
+  Sequence sink;
+  ring.add_gating(sink);
+  SequenceBarrier<Event> first_barrier(ring);
+  SequenceBarrier<Event> second_barrier(ring, { &first });
+  SequenceBarrier<Event> sink_barrier(ring, { &second });
+
+  executor::LooperExecutor producer_executor;
+  executor::LooperExecutor first_executor;
+  executor::LooperExecutor second_executor;
+  executor::LooperExecutor sink_executor;
+  int64_t sum = 0;
+  auto first_stage = run_stage(first_executor, ring, first_barrier, first,
+                               [](Event &event, int64_t, bool) { event.result = first_step(event.value); });
+  auto second_stage = run_stage(second_executor, ring, second_barrier, second, [](Event &event, int64_t, bool) {
+    event.result = second_step(event.value, event.result);
+  });
+  auto sink_stage =
+    run_stage(sink_executor, ring, sink_barrier, sink, [&sum](Event &event, int64_t, bool) { sum += event.result; });
+  auto producer = produce(producer_executor, ring);
+  producer.get_result();
+  first_stage.get_result();
+  second_stage.get_result();
+  sink_stage.get_result();
+  return sum;
+}
+
+using EventChannel = channel::Channel<Event>;
+
+task::Task<void> channel_produce(executor::AbstractExecutor &executor, EventChannel &output) {
+  co_await executor::switch_to(executor);
+  for (int64_t i = 0; i < EVENT_COUNT; i++) {
+    co_await output.send(Event{ i, 0 }, &executor);
+  }
+  output.close();
+}
+
+template <typename Func>
+task::Task<void> channel_stage(executor::AbstractExecutor &executor, EventChannel &input, EventChannel &output,
+                               Func func) {
+  co_await executor::switch_to(executor);
+  while (auto event = co_await input.receive(&executor)) {
+    func(*event);
+    co_await output.send(*event, &executor);
+  }
+  output.close();
+}
+
+task::Task<int64_t> channel_sink(executor::AbstractExecutor &executor, EventChannel &input) {
+  co_await executor::switch_to(executor);
+  int64_t sum = 0;
+  while (auto event = co_await input.receive(&executor)) {
+    sum += event->result;
+  }
+  co_return sum;
+}
+
+// 同样的流水线，阶段之间用 Channel 连接，每个阶段是一个 Task
+int64_t run_channels() {
+  EventChannel produced(RING_SIZE);
+  EventChannel first(RING_SIZE);
+  EventChannel second(RING_SIZE);
+  executor::LooperExecutor producer_executor;
+  executor::LooperExecutor first_executor;
+  executor::LooperExecutor second_executor;
+  executor::LooperExecutor sink_executor;
+  auto sink = channel_sink(sink_executor, second);
+  auto second_stage = channel_stage(second_executor, first, second,
+                                    [](Event &event) { event.result = second_step(event.value, event.result); });
+  auto first_stage =
+    channel_stage(first_executor, produced, first, [](Event &event) { event.result = first_step(event.value); });
+  auto producer = channel_produce(producer_executor, produced);
+  producer.get_result();
+  first_stage.get_result();
+  second_stage.get_result();
+  return sink.get_result();
+}
+
+// 用互斥锁和条件变量实现的有界阻塞队列
+struct BlockingQueue {
+  void push(Event event) {
+    std::unique_lock lock(queue_lock);
+    not_full.wait(lock, [this]() { return events.size() < RING_SIZE; });
+    events.push_back(event);
+    lock.unlock();
+    not_empty.notify_one();
+  }
+
+  // 队列关闭并且为空时返回 false
+  bool pop(Event &event) {
+    std::unique_lock lock(queue_lock);
+    not_empty.wait(lock, [this]() { return !events.empty() || closed; });
+    if (events.empty()) {
+      return false;
+    }
+    event = events.front();
+    events.pop_front();
+    lock.unlock();
+    not_full.notify_one();
+    return true;
+  }
+
+  void close() {
+    std::lock_guard lock(queue_lock);
+    closed = true;
+    not_empty.notify_all();
+  }
+
+  std::mutex queue_lock;
+  std::condition_variable not_empty;
+  std::condition_variable not_full;
+  std::deque<Event> events;
+  bool closed = false;
+};
+
+// 同样的流水线，每个阶段一个线程，阶段之间用阻塞队列连接
+int64_t run_mutex_queues() {
+  BlockingQueue produced;
+  BlockingQueue first;
+  BlockingQueue second;
+  int64_t sum = 0;
+  std::thread producer([&]() {
+    for (int64_t i = 0; i < EVENT_COUNT; i++) {
+      produced.push(Event{ i, 0 });
+    }
+    produced.close();
+  });
+  std::thread first_stage([&]() {
+    Event event;
+    while (produced.pop(event)) {
+      event.result = first_step(event.value);
+      first.push(event);
+    }
+    first.close();
+  });
+  std::thread second_stage([&]() {
+    Event event;
+    while (first.pop(event)) {
+      event.result = second_step(event.value, event.result);
+      second.push(event);
+    }
+    second.close();
+  });
+  std::thread sink([&]() {
+    Event event;
+    while (second.pop(event)) {
+      sum += event.result;
+    }
+  });
+  producer.join();
+  first_stage.join();
+  second_stage.join();
+  sink.join();
+  return sum;
+}
+
+template <typename Func>
+void benchmark(const char *name, int64_t expected, Func &&func) {
+  auto start = std::chrono::steady_clock::now();
+  auto sum = func();
+  auto seconds = seconds_since(start);
+  std::cout << name << ": " << EVENT_COUNT / seconds / 1e6 << " M events/s, "
+            << (sum == expected ? "correct" : "WRONG") << std::endl;
+}
+
+} // namespace
+
+void Run() {
+  std::cout << "start run disruptor" << std::endl;
+  std::cout << "hardware threads: " << std::thread::hardware_concurrency() << ", " << EVENT_COUNT
+            << " events through 3 stages" << std::endl;
+  auto expected = expected_sum();
+  for (std::size_t spin_budget : { 0, 100, 10'000 }) {
+    auto name = "disruptor, spin " + std::to_string(spin_budget);
+    benchmark(name.c_str(), expected, [&]() { return run_disruptor(spin_budget); });
+  }
+  benchmark("channel of tasks", expected, run_channels);
+  benchmark("mutex queues", expected, run_mutex_queues);
+  std::cout << "end run disruptor" << std::endl;
+}
+
+} // namespace disruptor
+} // namespace co
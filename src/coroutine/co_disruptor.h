@@ -0,0 +1,327 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <coroutine>
+#include <stdexcept>
+#include "co_task.h"
+#include "co_executor.h"
+
+namespace co {
+namespace disruptor {
+
+// 默认的自旋次数，超过之后挂起协程
+constexpr std::size_t SPIN_BUDGET = 1000;
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+/**
+ * 单调递增的序号，表示某个生产者或者阶段已经完成到哪个位置，初始为 -1。
+ * 独占一个缓存行，避免不同阶段的序号互相干扰
+*/
+struct alignas(64) Sequence {
+  int64_t get() const {
+    return value.load(std::memory_order_acquire);
+  }
+
+  // 与 Notifier 的等待方构成先写后读的同步，写入和之后 signal 读取 has_waiters 都需要 seq_cst
+  void set(int64_t sequence) {
+    value.store(sequence, std::memory_order_seq_cst);
+  }
+
+private:
+  std::atomic<int64_t> value{ -1 };
+};
+
+// 挂起在 Notifier 上的等待者，条件满足时在 resume_on 上恢复，resume_on 为空时在唤醒方的线程上恢复
+struct WaitNode {
+  virtual ~WaitNode() = default;
+
+  virtual bool ready() = 0;
+
+  std::coroutine_handle<> handle;
+  executor::AbstractExecutor *resume_on = nullptr;
+};
+
+/**
+ * 唤醒挂起在环上的协程。序号推进之后调用 signal，没有等待者时只有一次原子读；
+ * 所有等待者共用一个 Notifier，signal 时逐个检查条件，只恢复条件已经满足的等待者
+*/
+struct Notifier {
+  Notifier() = default;
+
+  Notifier(Notifier &) = delete;
+  Notifier &operator=(Notifier &) = delete;
+
+  /**
+   * 登记等待者之后再检查一次条件，避免在检查和登记之间错过 signal。
+   * 条件已经满足时返回 false，不需要挂起
+  */
+  bool wait(WaitNode *waiter) {
+    std::lock_guard lock(waiters_lock);
+    waiters.push_back(waiter);
+    has_waiters.store(true, std::memory_order_seq_cst);
+    // ready 用 acquire 读取序号，没有这个屏障时读取可能早于上面的写入，与 signal 双方都看到旧值而永远挂起
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiter->ready()) {
+      waiters.pop_back();
+      has_waiters.store(!waiters.empty(), std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+
+  void signal() {
+    if (!has_waiters.load(std::memory_order_seq_cst)) {
+      return;
+    }
+    std::unique_lock lock(waiters_lock);
+    auto waiting = std::partition(waiters.begin(), waiters.end(), [](WaitNode *waiter) { return !waiter->ready(); });
+    std::vector<WaitNode *> resumed(waiting, waiters.end());
+    waiters.erase(waiting, waiters.end());
+    has_waiters.store(!waiters.empty(), std::memory_order_relaxed);
+    lock.unlock();
+    for (auto waiter : resumed) {
+      if (waiter->resume_on) {
+        waiter->resume_on->execute([handle = waiter->handle]() { handle.resume(); });
+      } else {
+        waiter->handle.resume();
+      }
+    }
+  }
+
+private:
+  std::mutex waiters_lock;
+  std::vector<WaitNode *> waiters;
+  std::atomic<bool> has_waiters{ false };
+};
+
+/**
+ * 等待 condition() 成立的等待体：先自旋 spin_budget 次，仍不成立时挂起，
+ * 由 Notifier 在条件成立之后唤醒；恢复时返回 result()
+*/
+template <typename Condition, typename Result>
+struct SpinAwaiter : WaitNode {
+  SpinAwaiter(Notifier &notifier, std::size_t spin_budget, executor::AbstractExecutor *resume_on,
+              Condition &&condition, Result &&result)
+      : notifier(notifier), spin_budget(spin_budget), condition(std::move(condition)), result(std::move(result)) {
+    this->resume_on = resume_on;
+  }
+
+  bool ready() override {
+    return condition();
+  }
+
+  bool await_ready() {
+    for (std::size_t i = 0; i < spin_budget; i++) {
+      if (condition()) {
+        return true;
+      }
+      cpu_relax();
+    }
+    return condition();
+  }
+
+  bool await_suspend(std::coroutine_handle<> handle) {
+    this->handle = handle;
+    return notifier.wait(this);
+  }
+
+  auto await_resume() {
+    return result();
+  }
+
+private:
+  Notifier &notifier;
+  std::size_t spin_budget;
+  Condition condition;
+  Result result;
+};
+
+template <typename Condition, typename Result>
+SpinAwaiter<Condition, Result> spin_then_suspend(Notifier &notifier, std::size_t spin_budget,
+                                                 executor::AbstractExecutor *resume_on, Condition condition,
+                                                 Result result) {
+  return SpinAwaiter<Condition, Result>(notifier, spin_budget, resume_on, std::move(condition), std::move(result));
+}
+
+/**
+ * 预先分配的环形缓冲区，只支持一个生产者，可以接多级消费者：
+ * 生产者 claim 一段序号，写入 ring[sequence] 之后 publish；消费者通过 SequenceBarrier 等待上游，
+ * 一次取走所有可用的序号批量处理。生产者不能超过 gating 序号中最慢的一个一整圈。
+ * 环上的元素不会被销毁和重新构造，生产者直接覆盖
+*/
+template <typename T>
+struct RingBuffer {
+  explicit RingBuffer(std::size_t capacity, std::size_t spin_budget = SPIN_BUDGET)
+      : spin_budget(spin_budget), entries(capacity), mask(capacity - 1) {
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+      throw std::invalid_argument("ring buffer capacity must be a power of 2");
+    }
+  }
+
+  RingBuffer(RingBuffer &) = delete;
+  RingBuffer &operator=(RingBuffer &) = delete;
+
+  T &operator[](int64_t sequence) {
+    return entries[sequence & mask];
+  }
+
+  std::size_t capacity() const {
+    return entries.size();
+  }
+
+  // 生产者等待这些序号（通常是最后一级消费者）之后才能覆盖对应的位置，需要在开始生产之前添加
+  void add_gating(const Sequence &sequence) {
+    gating.push_back(&sequence);
+  }
+
+  /**
+   * co_await ring.claim(count) 占用接下来的 count 个位置，返回其中最后一个序号，
+   * 即 [返回值 - count + 1, 返回值]。位置都被下游释放之前先自旋再挂起。
+   * count 超过容量时永远等不到足够的位置，直接抛出 std::invalid_argument
+  */
+  auto claim(std::size_t count = 1, executor::AbstractExecutor *resume_on = nullptr) {
+    if (count > entries.size()) {
+      throw std::invalid_argument("ring buffer claim larger than its capacity");
+    }
+    auto last = next_claim + static_cast<int64_t>(count) - 1;
+    auto wrap = last - static_cast<int64_t>(entries.size());
+    // 缓存上次看到的最慢序号，大多数时候不需要读取其他阶段的序号
+    return spin_then_suspend(
+      notifier, spin_budget, resume_on, [this, wrap]() { return wrap <= cached_gating || minimum_gating() >= wrap; },
+      [this, wrap, last]() {
+        if (wrap > cached_gating) {
+          cached_gating = minimum_gating();
+        }
+        next_claim = last + 1;
+        return last;
+      });
+  }
+
+  // 发布到 sequence 为止的所有位置
+  void publish(int64_t sequence) {
+    cursor.set(sequence);
+    notifier.signal();
+  }
+
+  /**
+   * 生产结束，所有消费者处理完已发布的位置之后，等待返回结束标记。
+   * 需要在最后一次 publish 之后调用
+  */
+  void close() {
+    closed.store(true, std::memory_order_seq_cst);
+    notifier.signal();
+  }
+
+  bool is_closed() const {
+    return closed.load(std::memory_order_acquire);
+  }
+
+  Sequence cursor;
+  Notifier notifier;
+  std::size_t spin_budget;
+
+private:
+  int64_t minimum_gating() const {
+    auto minimum = cursor.get();
+    for (auto sequence : gating) {
+      minimum = std::min(minimum, sequence->get());
+    }
+    return minimum;
+  }
+
+  std::vector<T> entries;
+  int64_t mask;
+  std::vector<const Sequence *> gating;
+  std::atomic<bool> closed{ false };
+
+  // 只由生产者访问
+  int64_t next_claim = 0;
+  int64_t cached_gating = -1;
+};
+
+// 环已经关闭，并且上游已经处理完所有位置
+constexpr int64_t END_OF_STREAM = -2;
+
+/**
+ * 序号屏障：一个阶段只能处理生产者已经发布、并且所有上游阶段都已经处理完的位置
+*/
+template <typename T>
+struct SequenceBarrier {
+  // 没有上游阶段时只依赖生产者的 cursor
+  SequenceBarrier(RingBuffer<T> &ring, std::vector<const Sequence *> dependencies = {})
+      : ring(ring), dependencies(std::move(dependencies)) {
+    if (this->dependencies.empty()) {
+      this->dependencies.push_back(&ring.cursor);
+    }
+  }
+
+  // 当前可以处理到的最大序号
+  int64_t available() const {
+    auto minimum = dependencies[0]->get();
+    for (std::size_t i = 1; i < dependencies.size(); i++) {
+      minimum = std::min(minimum, dependencies[i]->get());
+    }
+    return minimum;
+  }
+
+  /**
+   * 等待 sequence 可以处理，返回可以处理到的最大序号（可能远大于 sequence，一次批量处理）；
+   * 环已关闭并且上游都已处理完时返回 END_OF_STREAM
+  */
+  auto wait_for(int64_t sequence, executor::AbstractExecutor *resume_on = nullptr) {
+    return spin_then_suspend(
+      ring.notifier, ring.spin_budget, resume_on,
+      [this, sequence]() { return available() >= sequence || finished(); },
+      [this, sequence]() {
+        auto result = available();
+        return result >= sequence ? result : END_OF_STREAM;
+      });
+  }
+
+private:
+  // 关闭之后 cursor 不再变化，上游都追上 cursor 就不会再有新的位置
+  bool finished() const {
+    return ring.is_closed() && available() >= ring.cursor.get();
+  }
+
+  RingBuffer<T> &ring;
+  std::vector<const Sequence *> dependencies;
+};
+
+/**
+ * 运行一个消费阶段：在 executor 上循环等待屏障，批量调用 handler(entry, sequence, end_of_batch)，
+ * 每批处理完再推进自己的 sequence 并唤醒等待者。环关闭并处理完所有位置之后返回
+*/
+template <typename T, typename Handler>
+task::Task<void> run_stage(executor::AbstractExecutor &executor, RingBuffer<T> &ring, SequenceBarrier<T> &barrier,
+                           Sequence &sequence, Handler handler) {
+  co_await executor::switch_to(executor);
+  auto next = sequence.get() + 1;
+  while (true) {
+    auto available = co_await barrier.wait_for(next, &executor);
+    if (available == END_OF_STREAM) {
+      co_return;
+    }
+    for (; next <= available; next++) {
+      handler(ring[next], next, next == available);
+    }
+    sequence.set(available);
+    ring.notifier.signal();
+  }
+}
+
+void Run();
+
+} // namespace disruptor
+} // namespace co
@@ -0,0 +1,322 @@
+#include <algorithm>
+#include <stdexcept>
+#include "co_budget.h"
+#include "co_executor.h"
+
+namespace co {
+namespace executor {
+
+LooperExecutor::LooperExecutor() {
+  work_thread = std::thread(&LooperExecutor::run_loop, this);
+}
+
+LooperExecutor::~LooperExecutor() {
+  shutdown(false);
+  if (work_thread.joinable()) {
+    work_thread.join();
+  }
+}
+
+void LooperExecutor::execute(std::function<void()> &&func) {
+  std::unique_lock lock(queue_lock);
+  if (!accepts_tasks()) {
+    return;
+  }
+  ready_queue.push_back(std::move(func));
+  lock.unlock();
+  queue_condition.notify_one();
+}
+
+void LooperExecutor::execute_delayed(std::function<void()> &&func, Clock::duration delay) {
+  std::unique_lock lock(queue_lock);
+  if (!accepts_tasks()) {
+    return;
+  }
+  delayed_queue.emplace(Clock::now() + delay, std::move(func));
+  lock.unlock();
+  // 新的延迟逻辑可能比之前最早的还要早，唤醒事件循环重新计算等待时间
+  queue_condition.notify_one();
+}
+
+void LooperExecutor::defer(std::function<void()> &&func) {
+  if (in_loop()) {
+    deferred_queue.push_back(std::move(func));
+  } else {
+    execute(std::move(func));
+  }
+}
+
+bool LooperExecutor::accepts_tasks() const {
+  // 关闭过程中执行的逻辑还可以继续提交，以便等待中的协程都能执行完
+  return is_active || drain_on_shutdown;
+}
+
+bool LooperExecutor::in_loop() const {
+  return std::this_thread::get_id() == work_thread.get_id();
+}
+
+void LooperExecutor::shutdown(bool wait_for_complete) {
+  {
+    std::lock_guard lock(queue_lock);
+    if (!is_active) {
+      return;
+    }
+    is_active = false;
+    drain_on_shutdown = wait_for_complete;
+    if (!wait_for_complete) {
+      ready_queue.clear();
+      delayed_queue.clear();
+    }
+  }
+  queue_condition.notify_all();
+  if (work_thread.joinable() && !in_loop()) {
+    work_thread.join();
+  }
+}
+
+void LooperExecutor::run_loop() {
+  std::deque<std::function<void()>> tick;
+  while (true) {
+    {
+      std::unique_lock lock(queue_lock);
+      while (true) {
+        // 到期的延迟逻辑进入本 tick
+        auto now = Clock::now();
+        while (!delayed_queue.empty() && delayed_queue.begin()->first <= now) {
+          ready_queue.push_back(std::move(delayed_queue.begin()->second));
+          delayed_queue.erase(delayed_queue.begin());
+        }
+        if (!ready_queue.empty()) {
+          break;
+        }
+        if (!is_active) {
+          if (!drain_on_shutdown || delayed_queue.empty()) {
+            drain_on_shutdown = false;
+            return;
+          }
+          // 关闭时不再等待，剩余的延迟逻辑立即执行
+          for (auto &[_, func] : delayed_queue) {
+            ready_queue.push_back(std::move(func));
+          }
+          delayed_queue.clear();
+          break;
+        }
+        if (delayed_queue.empty()) {
+          queue_condition.wait(lock);
+        } else {
+          queue_condition.wait_until(lock, delayed_queue.begin()->first);
+        }
+      }
+      std::swap(tick, ready_queue);
+    }
+
+    for (auto &func : tick) {
+      budget::BudgetScope scope(this);
+      func();
+    }
+    tick.clear();
+
+    // defer 的逻辑中可能继续 defer，一并在本 tick 执行完
+    while (!deferred_queue.empty()) {
+      auto deferred = std::move(deferred_queue);
+      deferred_queue.clear();
+      for (auto &func : deferred) {
+        budget::BudgetScope scope(this);
+        func();
+      }
+    }
+  }
+}
+
+ThreadPoolExecutor::ThreadPoolExecutor(std::size_t thread_count) {
+  thread_count = std::max<std::size_t>(thread_count, 1);
+  running = thread_count;
+  for (std::size_t i = 0; i < thread_count; i++) {
+    threads.emplace_back(&ThreadPoolExecutor::run_worker, this);
+  }
+}
+
+ThreadPoolExecutor::~ThreadPoolExecutor() {
+  shutdown();
+}
+
+void ThreadPoolExecutor::execute(std::function<void()> &&func) {
+  std::unique_lock lock(queue_lock);
+  // 线程全部退出之后没有人会再取队列
+  if (running == 0) {
+    return;
+  }
+  ready_queue.push_back(std::move(func));
+  lock.unlock();
+  queue_condition.notify_one();
+}
+
+void ThreadPoolExecutor::shutdown() {
+  for (auto &thread : threads) {
+    if (thread.get_id() == std::this_thread::get_id()) {
+      throw std::logic_error("thread pool shut down from one of its own threads");
+    }
+  }
+  {
+    std::lock_guard lock(queue_lock);
+    if (!is_active) {
+      return;
+    }
+    is_active = false;
+  }
+  queue_condition.notify_all();
+  for (auto &thread : threads) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+
+void ThreadPoolExecutor::run_worker() {
+  while (true) {
+    std::unique_lock lock(queue_lock);
+    queue_condition.wait(lock, [this]() { return !ready_queue.empty() || !is_active; });
+    // 关闭之后仍然把队列执行完，正在执行的逻辑提交的新逻辑由还没退出的线程执行
+    if (ready_queue.empty()) {
+      running--;
+      return;
+    }
+    auto func = std::move(ready_queue.front());
+    ready_queue.pop_front();
+    lock.unlock();
+    budget::BudgetScope scope(this);
+    func();
+  }
+}
+
+namespace {
+
+// 当前线程所属的工作窃取线程池和线程序号
+thread_local WorkStealingExecutor *current_pool = nullptr;
+thread_local std::size_t current_worker = 0;
+
+} // namespace
+
+WorkStealingExecutor::WorkStealingExecutor(std::size_t thread_count) {
+  thread_count = std::max<std::size_t>(thread_count, 1);
+  for (std::size_t i = 0; i < thread_count; i++) {
+    workers.push_back(std::make_unique<Worker>());
+  }
+  running = thread_count;
+  // 所有队列都建好之后再启动线程，线程启动后就可能窃取其他队列
+  for (std::size_t i = 0; i < thread_count; i++) {
+    workers[i]->thread = std::thread(&WorkStealingExecutor::run_worker, this, i);
+  }
+}
+
+WorkStealingExecutor::~WorkStealingExecutor() {
+  shutdown();
+}
+
+bool WorkStealingExecutor::in_pool() const {
+  return current_pool == this;
+}
+
+void WorkStealingExecutor::execute(std::function<void()> &&func) {
+  // 持有 sleep_lock 入队，线程要么在之后看到这个逻辑，要么已经全部退出、在这里被拒绝
+  std::unique_lock lock(sleep_lock);
+  if (running == 0) {
+    return;
+  }
+  if (in_pool()) {
+    auto &worker = *workers[current_worker];
+    std::lock_guard queue_guard(worker.lock);
+    worker.queue.push_back(std::move(func));
+  } else {
+    std::lock_guard queue_guard(injection_lock);
+    injection_queue.push_back(std::move(func));
+  }
+  pending++;
+  // 没有空闲线程时不需要唤醒，避免每次提交都进行系统调用
+  if (sleeping > 0) {
+    lock.unlock();
+    sleep_condition.notify_one();
+  }
+}
+
+bool WorkStealingExecutor::take(std::size_t index, std::function<void()> &func) {
+  // 自己队列的尾部
+  {
+    auto &worker = *workers[index];
+    std::lock_guard lock(worker.lock);
+    if (!worker.queue.empty()) {
+      func = std::move(worker.queue.back());
+      worker.queue.pop_back();
+      return true;
+    }
+  }
+  // 外部提交的逻辑
+  {
+    std::lock_guard lock(injection_lock);
+    if (!injection_queue.empty()) {
+      func = std::move(injection_queue.front());
+      injection_queue.pop_front();
+      return true;
+    }
+  }
+  // 从下一个线程开始依次尝试窃取其他队列的头部
+  for (std::size_t i = 1; i < workers.size(); i++) {
+    auto &victim = *workers[(index + i) % workers.size()];
+    std::lock_guard lock(victim.lock);
+    if (!victim.queue.empty()) {
+      func = std::move(victim.queue.front());
+      victim.queue.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingExecutor::run_worker(std::size_t index) {
+  current_pool = this;
+  current_worker = index;
+  std::function<void()> func;
+  while (true) {
+    if (take(index, func)) {
+      pending--;
+      budget::BudgetScope scope(this);
+      func();
+      func = nullptr;
+      continue;
+    }
+    std::unique_lock lock(sleep_lock);
+    if (pending > 0) {
+      // 还有已提交的逻辑没被取走（可能正被其他线程取走），重新尝试
+      continue;
+    }
+    if (!is_active) {
+      running--;
+      return;
+    }
+    sleeping++;
+    sleep_condition.wait(lock, [this]() { return pending > 0 || !is_active; });
+    sleeping--;
+  }
+}
+
+void WorkStealingExecutor::shutdown() {
+  if (in_pool()) {
+    throw std::logic_error("thread pool shut down from one of its own threads");
+  }
+  {
+    std::lock_guard lock(sleep_lock);
+    if (!is_active) {
+      return;
+    }
+    is_active = false;
+  }
+  sleep_condition.notify_all();
+  for (auto &worker : workers) {
+    if (worker->thread.joinable()) {
+      worker->thread.join();
+    }
+  }
+}
+
+} // namespace executor
+} // namespace co
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <coroutine>
+#include <functional>
+#include <condition_variable>
+
+namespace co {
+namespace executor {
+
+/**
+ * 执行器，决定一段逻辑（通常是协程的恢复）在哪个线程上执行
+*/
+struct AbstractExecutor {
+  virtual ~AbstractExecutor() = default;
+
+  virtual void execute(std::function<void()> &&func) = 0;
+};
+
+// 在当前线程上直接执行
+struct NoopExecutor : AbstractExecutor {
+  void execute(std::function<void()> &&func) override {
+    func();
+  }
+};
+
+// 每次都新建一个线程执行
+struct NewThreadExecutor : AbstractExecutor {
+  void execute(std::function<void()> &&func) override {
+    std::thread(std::move(func)).detach();
+  }
+};
+
+/**
+ * 事件循环执行器，所有逻辑都在同一个线程上按 tick 执行：
+ * 每个 tick 取出队列中所有已就绪的逻辑依次执行，然后再执行本 tick 内通过 defer 推迟的逻辑
+*/
+struct LooperExecutor : AbstractExecutor {
+  using Clock = std::chrono::steady_clock;
+
+  LooperExecutor();
+  ~LooperExecutor() override;
+
+  LooperExecutor(LooperExecutor &) = delete;
+  LooperExecutor &operator=(LooperExecutor &) = delete;
+
+  // 放到下一个 tick 执行
+  void execute(std::function<void()> &&func) override;
+
+  // 延迟 delay 之后执行
+  void execute_delayed(std::function<void()> &&func, Clock::duration delay);
+
+  // 在当前 tick 结束时执行，不在事件循环线程上调用时等价于 execute
+  void defer(std::function<void()> &&func);
+
+  // 当前线程是否为事件循环线程
+  bool in_loop() const;
+
+  /**
+   * 停止事件循环，wait_for_complete 为 true 时先执行完已提交的逻辑（包括还没到期的延迟逻辑），
+   * 否则直接丢弃
+  */
+  void shutdown(bool wait_for_complete = true);
+
+private:
+  void run_loop();
+
+  // 需要持有 queue_lock
+  bool accepts_tasks() const;
+
+  std::mutex queue_lock;
+  std::condition_variable queue_condition;
+  std::deque<std::function<void()>> ready_queue;
+  std::multimap<Clock::time_point, std::function<void()>> delayed_queue;
+
+  // 只在事件循环线程上访问
+  std::vector<std::function<void()>> deferred_queue;
+
+  std::atomic<bool> is_active{ true };
+  bool drain_on_shutdown = true;
+  std::thread work_thread;
+};
+
+/**
+ * 固定线程数的线程池，所有线程共享一个队列，逻辑由空闲的线程领取执行
+*/
+struct ThreadPoolExecutor : AbstractExecutor {
+  explicit ThreadPoolExecutor(std::size_t thread_count = std::thread::hardware_concurrency());
+  ~ThreadPoolExecutor() override;
+
+  ThreadPoolExecutor(ThreadPoolExecutor &) = delete;
+  ThreadPoolExecutor &operator=(ThreadPoolExecutor &) = delete;
+
+  void execute(std::function<void()> &&func) override;
+
+  std::size_t thread_count() const {
+    return threads.size();
+  }
+
+  /**
+   * 执行完队列中的逻辑之后停止所有线程，执行过程中提交的逻辑也会被执行，
+   * 线程全部退出之后提交的逻辑会被丢弃。
+   * 不能在线程池自己的线程上关闭或者销毁线程池，这样调用时抛出 std::logic_error（在析构函数中即终止程序）
+  */
+  void shutdown();
+
+private:
+  void run_worker();
+
+  std::mutex queue_lock;
+  std::condition_variable queue_condition;
+  std::deque<std::function<void()>> ready_queue;
+  bool is_active = true;
+  // 还没有退出的线程数，为 0 之后提交的逻辑被丢弃
+  std::size_t running = 0;
+  std::vector<std::thread> threads;
+};
+
+/**
+ * 工作窃取线程池：每个线程有自己的双端队列，线程池内部提交的逻辑放入当前线程队列的尾部，
+ * 线程优先从自己队列的尾部取（后进先出，缓存更热），空闲时从其他线程队列的头部窃取（先进先出，
+ * 通常是更大块的工作）；线程池外部提交的逻辑进入共享的注入队列。
+ * 线程数固定，递归拆分出再多的任务也不会超额占用 CPU
+*/
+struct WorkStealingExecutor : AbstractExecutor {
+  explicit WorkStealingExecutor(std::size_t thread_count = std::thread::hardware_concurrency());
+  ~WorkStealingExecutor() override;
+
+  WorkStealingExecutor(WorkStealingExecutor &) = delete;
+  WorkStealingExecutor &operator=(WorkStealingExecutor &) = delete;
+
+  void execute(std::function<void()> &&func) override;
+
+  std::size_t thread_count() const {
+    return workers.size();
+  }
+
+  // 当前线程是否为本线程池的线程
+  bool in_pool() const;
+
+  /**
+   * 执行完队列中的逻辑之后停止所有线程，执行过程中提交的逻辑也会被执行，
+   * 线程全部退出之后提交的逻辑会被丢弃。
+   * 与 ThreadPoolExecutor 相同，不能在线程池自己的线程上关闭或者销毁
+  */
+  void shutdown();
+
+private:
+  struct Worker {
+    std::mutex lock;
+    std::deque<std::function<void()>> queue;
+    std::thread thread;
+  };
+
+  void run_worker(std::size_t index);
+  bool take(std::size_t index, std::function<void()> &func);
+
+  std::vector<std::unique_ptr<Worker>> workers;
+
+  std::mutex injection_lock;
+  std::deque<std::function<void()>> injection_queue;
+
+  // 已提交还没有被取走的逻辑数，空闲线程在 sleep_condition 上等待它变为非 0
+  std::atomic<std::size_t> pending{ 0 };
+  std::mutex sleep_lock;
+  std::condition_variable sleep_condition;
+  std::size_t sleeping = 0;
+  bool is_active = true;
+  // 还没有退出的线程数，为 0 之后提交的逻辑被丢弃
+  std::size_t running = 0;
+};
+
+/**
+ * co_await switch_to(executor) 挂起当前协程，之后在 executor 上恢复执行。
+ * 协程已经有执行器（Task 创建在某个执行器上，见 TaskPromise::get_executor）时一并换成 executor，
+ * 之后等待的 Task 完成时回到 executor 上，而不是被送回原来的执行器（例如 I/O 线程）；
+ * 没有执行器的协程只切换这一次，之后在完成 Task 的线程上继续
+*/
+struct SwitchAwaiter {
+  bool await_ready() const noexcept {
+    return false;
+  }
+
+  template <typename Promise>
+  void await_suspend(std::coroutine_handle<Promise> handle) {
+    if constexpr (requires { handle.promise().set_executor(&executor); }) {
+      if (handle.promise().get_executor()) {
+        handle.promise().set_executor(&executor);
+      }
+    }
+    executor.execute([handle]() { handle.resume(); });
+  }
+
+  void await_resume() const noexcept {}
+
+  AbstractExecutor &executor;
+};
+
+inline SwitchAwaiter switch_to(AbstractExecutor &executor) {
+  return SwitchAwaiter{ executor };
+}
+
+} // namespace executor
+} // namespace co
@@ -0,0 +1,153 @@
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <unistd.h>
+#include <filesystem>
+#include <sys/resource.h>
+#include <system_error>
+#include "co_external_sort.h"
+
+namespace co {
+namespace sort {
+
+File::File(const std::string &path, int flags) {
+  fd = ::open(path.c_str(), flags | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "open " + path);
+  }
+}
+
+File::~File() {
+  ::close(fd);
+}
+
+void File::write_at(const void *data, std::size_t size, uint64_t offset) {
+  auto bytes = static_cast<const char *>(data);
+  while (size > 0) {
+    auto written = ::pwrite(fd, bytes, size, offset);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(), "pwrite");
+    }
+    bytes += written;
+    size -= written;
+    offset += written;
+  }
+}
+
+std::size_t File::read_at(void *data, std::size_t size, uint64_t offset) {
+  auto bytes = static_cast<char *>(data);
+  std::size_t total = 0;
+  while (total < size) {
+    auto count = ::pread(fd, bytes + total, size - total, offset + total);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(), "pread");
+    }
+    if (count == 0) {
+      break;
+    }
+    total += count;
+  }
+  return total;
+}
+
+void File::will_need(uint64_t offset, std::size_t length) {
+  ::posix_fadvise(fd, offset, length, POSIX_FADV_WILLNEED);
+}
+
+task::Task<std::size_t> write_async(executor::AbstractExecutor &io, executor::AbstractExecutor &resume, File &file,
+                                    std::span<const std::byte> data, uint64_t offset) {
+  co_await executor::switch_to(io);
+  std::exception_ptr error;
+  try {
+    file.write_at(data.data(), data.size(), offset);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  co_await executor::switch_to(resume);
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  co_return data.size();
+}
+
+std::string run_path(const std::string &out_path, std::size_t pass, std::size_t index) {
+  return out_path + ".run" + std::to_string(pass) + "." + std::to_string(index);
+}
+
+void remove_file(const std::string &path) {
+  ::unlink(path.c_str());
+}
+
+void rename_file(const std::string &from, const std::string &to) {
+  if (::rename(from.c_str(), to.c_str()) != 0) {
+    throw std::system_error(errno, std::generic_category(), "rename " + from);
+  }
+}
+
+generator::Generator<uint64_t> random_keys(uint64_t count) {
+  uint64_t state = 88172645463325252ULL;
+  for (uint64_t i = 0; i < count; i++) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    co_yield state;
+  }
+}
+
+// 逐块读回输出文件，检查有序并计算异或校验和
+bool verify(const std::string &path, uint64_t count, uint64_t checksum) {
+  uint64_t previous = 0;
+  uint64_t elements = 0;
+  uint64_t sorted_checksum = 0;
+  for (auto block : read_run<uint64_t>(path, 1 << 20)) {
+    for (auto key : block) {
+      if (key < previous) {
+        return false;
+      }
+      previous = key;
+      sorted_checksum ^= key;
+      elements++;
+    }
+  }
+  return elements == count && sorted_checksum == checksum;
+}
+
+void benchmark(const std::string &path, uint64_t count, std::size_t mem_budget) {
+  uint64_t checksum = 0;
+  for (auto key : random_keys(count)) {
+    checksum ^= key;
+  }
+  auto start = std::chrono::steady_clock::now();
+  auto stats = external_sort(random_keys(count), path, mem_budget);
+  auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  auto megabytes = count * sizeof(uint64_t) / double(1 << 20);
+  std::cout << megabytes << " MB with " << mem_budget / (1 << 20) << " MB budget: " << seconds << " s, "
+            << megabytes / seconds << " MB/s, runs " << stats.runs << ", merge passes " << stats.merge_passes
+            << ", run phase " << std::chrono::duration<double>(stats.run_time).count() << " s, merge phase "
+            << std::chrono::duration<double>(stats.merge_time).count() << " s, "
+            << (verify(path, count, checksum) ? "sorted" : "NOT SORTED") << std::endl;
+  remove_file(path);
+}
+
+void Run() {
+  std::cout << "start run external sort" << std::endl;
+  auto path = (std::filesystem::temp_directory_path() / "co_external_sort.bin").string();
+  // 预算很小时每轮只能合并少量有序段，需要多轮合并
+  benchmark(path, 8 << 20, 8 << 20);
+  // 数据量为内存预算的 10 倍
+  benchmark(path, 320 << 20, 256 << 20);
+
+  struct rusage usage;
+  ::getrusage(RUSAGE_SELF, &usage);
+  std::cout << "peak rss: " << usage.ru_maxrss / 1024 << " MB" << std::endl;
+  std::cout << "end run external sort" << std::endl;
+}
+
+} // namespace sort
+} // namespace co
@@ -0,0 +1,410 @@
+#pragma once
+
+#include <span>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <utility>
+#include <optional>
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <type_traits>
+#include "co_task.h"
+#include "co_executor.h"
+#include "co_generator.h"
+
+namespace co {
+namespace sort {
+
+// 合并时每个有序段的读缓冲不小于这个大小，预算放不下所有有序段时分多轮合并
+constexpr std::size_t MIN_MERGE_BLOCK = 1 << 20;
+
+struct SortStats {
+  uint64_t elements = 0;
+  // 第一阶段生成的有序段数
+  std::size_t runs = 0;
+  // 合并的轮数，只有一个有序段时为 1（直接改名为输出文件时为 0）
+  std::size_t merge_passes = 0;
+  std::chrono::nanoseconds run_time{ 0 };
+  std::chrono::nanoseconds merge_time{ 0 };
+};
+
+/**
+ * 文件描述符的简单封装，打开和读写失败时抛出 std::system_error
+*/
+struct File {
+  File(const std::string &path, int flags);
+  ~File();
+
+  File(File &) = delete;
+  File &operator=(File &) = delete;
+
+  // 写入全部 size 个字节
+  void write_at(const void *data, std::size_t size, uint64_t offset);
+
+  // 读取最多 size 个字节，只有到达文件末尾时才会少于 size
+  std::size_t read_at(void *data, std::size_t size, uint64_t offset);
+
+  // 通知内核异步预读 [offset, offset + length)
+  void will_need(uint64_t offset, std::size_t length);
+
+private:
+  int fd;
+};
+
+/**
+ * 切换到 io 上把 data 写入 file 的 offset 处，写完之后再切换到 resume 上完成，
+ * 这样等待者不会在 io 线程上恢复、占住后续的写入。返回写入的字节数，
+ * 返回的 Task 完成之前 file 和 data 都需要保持有效
+*/
+task::Task<std::size_t> write_async(executor::AbstractExecutor &io, executor::AbstractExecutor &resume, File &file,
+                                    std::span<const std::byte> data, uint64_t offset);
+
+// 第 pass 轮合并的第 index 个输入有序段的临时文件
+std::string run_path(const std::string &out_path, std::size_t pass, std::size_t index);
+
+// 删除文件，忽略错误
+void remove_file(const std::string &path);
+
+// 重命名文件，失败时抛出 std::system_error
+void rename_file(const std::string &from, const std::string &to);
+
+/**
+ * 按块读取文件中的有序段，每块 block_size 个元素；
+ * 交出当前块之前先通知内核预读下一块，调用方处理当前块时磁盘读取同时进行
+*/
+template <typename T>
+generator::BatchGenerator<T> read_run(std::string path, std::size_t block_size) {
+  File file(path, O_RDONLY);
+  std::vector<T> block(block_size);
+  auto block_bytes = block_size * sizeof(T);
+  file.will_need(0, block_bytes);
+  uint64_t offset = 0;
+  while (true) {
+    auto bytes = file.read_at(block.data(), block_bytes, offset);
+    if (bytes == 0) {
+      break;
+    }
+    offset += bytes;
+    file.will_need(offset, block_bytes);
+    co_yield std::span<const T>(block.data(), bytes / sizeof(T));
+  }
+}
+
+template <typename T, typename Compare>
+task::Task<std::size_t> parallel_sort(executor::AbstractExecutor &executor, std::span<T> data, Compare comp,
+                                      std::size_t grain);
+
+// 切换到 executor 上再排序，用于把一半的数据交给其他线程
+template <typename T, typename Compare>
+task::Task<std::size_t> parallel_sort_on(executor::AbstractExecutor &executor, std::span<T> data, Compare comp,
+                                         std::size_t grain) {
+  co_await executor::switch_to(executor);
+  co_return co_await parallel_sort(executor, data, comp, grain);
+}
+
+/**
+ * 原地并行排序：用 nth_element 按中位数把数据分成大小相等的两半，
+ * 前一半交给 executor 上的其他线程，后一半在当前线程继续递归，不超过 grain 时直接 std::sort。
+ * 不需要额外的内存，返回排序的元素个数
+*/
+template <typename T, typename Compare>
+task::Task<std::size_t> parallel_sort(executor::AbstractExecutor &executor, std::span<T> data, Compare comp,
+                                      std::size_t grain) {
+  if (data.size() <= grain) {
+    std::sort(data.begin(), data.end(), comp);
+    co_return data.size();
+  }
+  auto half = data.size() / 2;
+  std::nth_element(data.begin(), data.begin() + half, data.end(), comp);
+  auto left = parallel_sort_on(executor, data.first(half), comp, grain);
+  auto sorted = co_await parallel_sort(executor, data.subspan(half), comp, grain);
+  co_return sorted + co_await std::move(left);
+}
+
+/**
+ * 两个缓冲区轮流使用的异步输出：一个缓冲区在 io 上写入文件时，另一个继续填充。
+ * 销毁之前必须 co_await finish()，等待所有写入完成
+*/
+template <typename T>
+struct DoubleBufferedWriter {
+  DoubleBufferedWriter(executor::AbstractExecutor &io, executor::AbstractExecutor &resume, const std::string &path,
+                       std::size_t buffer_size)
+      : io(io), resume(resume), file(path, O_WRONLY | O_CREAT | O_TRUNC),
+        buffers{ std::vector<T>(buffer_size), std::vector<T>(buffer_size) } {}
+
+  DoubleBufferedWriter(DoubleBufferedWriter &) = delete;
+  DoubleBufferedWriter &operator=(DoubleBufferedWriter &) = delete;
+
+  // 当前可以填充的缓冲区
+  std::vector<T> &buffer() {
+    return buffers[current];
+  }
+
+  /**
+   * 开始异步写入当前缓冲区的前 size 个元素，然后切换到另一个缓冲区，
+   * 另一个缓冲区上一次的写入还没完成时等待它完成
+  */
+  task::Task<std::size_t> flush(std::size_t size) {
+    auto data = std::as_bytes(std::span<const T>(buffers[current].data(), size));
+    writing[current].emplace(write_async(io, resume, file, data, offset));
+    offset += size * sizeof(T);
+    current ^= 1;
+    co_return co_await wait(current);
+  }
+
+  // 等待所有写入完成，返回写入的总字节数
+  task::Task<uint64_t> finish() {
+    co_await wait(0);
+    co_await wait(1);
+    co_return offset;
+  }
+
+private:
+  task::Task<std::size_t> wait(std::size_t index) {
+    if (!writing[index]) {
+      co_return 0;
+    }
+    auto task = std::move(*writing[index]);
+    writing[index].reset();
+    co_return co_await std::move(task);
+  }
+
+  executor::AbstractExecutor &io;
+  executor::AbstractExecutor &resume;
+  File file;
+  std::vector<T> buffers[2];
+  std::optional<task::Task<std::size_t>> writing[2];
+  std::size_t current = 0;
+  uint64_t offset = 0;
+};
+
+/**
+ * 把 inputs 中的有序段 k 路合并写入 output：每个有序段由 read_run 按块读入，用小顶堆选出最小值。
+ * 内存为 inputs.size() 个读缓冲加两个写缓冲，每个缓冲 block_size 个元素，返回合并的元素个数
+*/
+template <typename T, typename Compare>
+task::Task<uint64_t> merge_runs(executor::AbstractExecutor &io, executor::AbstractExecutor &pool,
+                                std::vector<std::string> inputs, std::string output, std::size_t block_size,
+                                Compare comp) {
+  // 每个有序段当前块中的读取位置
+  struct Cursor {
+    generator::BatchGenerator<T> blocks;
+    std::span<const T> block{};
+    std::size_t position = 0;
+
+    bool advance() {
+      if (++position < block.size()) {
+        return true;
+      }
+      while (blocks.has_next()) {
+        block = blocks.next();
+        position = 0;
+        if (!block.empty()) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    const T &current() const {
+      return block[position];
+    }
+  };
+
+  DoubleBufferedWriter<T> writer(io, pool, output, block_size);
+  uint64_t elements = 0;
+  std::exception_ptr error;
+  try {
+    std::vector<Cursor> cursors;
+    for (auto &input : inputs) {
+      cursors.push_back(Cursor{ read_run<T>(input, block_size) });
+      if (!cursors.back().advance()) {
+        cursors.pop_back();
+      }
+    }
+    // 堆中保存的是 cursor 的下标，比较方向反过来构成小顶堆
+    std::vector<std::size_t> heap;
+    for (std::size_t i = 0; i < cursors.size(); i++) {
+      heap.push_back(i);
+    }
+    auto greater = [&](std::size_t l, std::size_t r) { return comp(cursors[r].current(), cursors[l].current()); };
+    std::make_heap(heap.begin(), heap.end(), greater);
+
+    std::size_t size = 0;
+    while (!heap.empty()) {
+      std::pop_heap(heap.begin(), heap.end(), greater);
+      auto &cursor = cursors[heap.back()];
+      writer.buffer()[size++] = cursor.current();
+      if (cursor.advance()) {
+        std::push_heap(heap.begin(), heap.end(), greater);
+      } else {
+        heap.pop_back();
+      }
+      if (size == block_size) {
+        elements += size;
+        co_await writer.flush(size);
+        size = 0;
+      }
+    }
+    if (size > 0) {
+      elements += size;
+      co_await writer.flush(size);
+    }
+  } catch (...) {
+    error = std::current_exception();
+  }
+  // 出错时也要等待已经开始的写入完成，之后才能释放缓冲区
+  co_await writer.finish();
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  co_return elements;
+}
+
+/**
+ * 外部排序的协程部分：
+ * 1. 从 input 读满一个缓冲区，在 pool 上并行排序，然后在 io 上异步写成一个有序段，
+ *    写入的同时用另一个缓冲区读取和排序下一个有序段，两个缓冲区各占预算的一半；
+ * 2. 按预算计算每轮最多合并的有序段数，多轮 k 路合并直到只剩一个，最后改名为 out_path
+*/
+template <typename T, typename Compare>
+task::Task<SortStats> external_sort_task(executor::AbstractExecutor &pool, std::size_t parallelism,
+                                         executor::AbstractExecutor &io, generator::Generator<T> input,
+                                         std::string out_path, std::size_t mem_budget, Compare comp) {
+  using Clock = std::chrono::steady_clock;
+  SortStats stats;
+  auto start = Clock::now();
+
+  auto run_size = std::max<std::size_t>(mem_budget / 2 / sizeof(T), 1);
+  auto grain = std::max<std::size_t>(run_size / (parallelism * 4), 1 << 14);
+  std::vector<std::string> runs;
+  {
+    std::vector<T> buffers[2] = { std::vector<T>(run_size), std::vector<T>(run_size) };
+    std::optional<File> files[2];
+    std::optional<task::Task<std::size_t>> writing[2];
+    std::size_t current = 0;
+    std::exception_ptr error;
+    try {
+      while (true) {
+        // 这个缓冲区上一次的写入完成之后才能重新填充
+        if (writing[current]) {
+          auto task = std::move(*writing[current]);
+          writing[current].reset();
+          co_await std::move(task);
+          files[current].reset();
+        }
+        auto &buffer = buffers[current];
+        std::size_t size = 0;
+        while (size < run_size && input.has_next()) {
+          buffer[size++] = input.next();
+        }
+        if (size == 0) {
+          break;
+        }
+        stats.elements += size;
+        co_await parallel_sort_on(pool, std::span<T>(buffer.data(), size), comp, grain);
+        runs.push_back(run_path(out_path, 0, runs.size()));
+        files[current].emplace(runs.back(), O_WRONLY | O_CREAT | O_TRUNC);
+        auto data = std::as_bytes(std::span<const T>(buffer.data(), size));
+        writing[current].emplace(write_async(io, pool, *files[current], data, 0));
+        current ^= 1;
+        if (size < run_size) {
+          break;
+        }
+      }
+    } catch (...) {
+      error = std::current_exception();
+    }
+    for (auto &task : writing) {
+      if (task) {
+        try {
+          co_await std::move(*task);
+        } catch (...) {
+          if (!error) {
+            error = std::current_exception();
+          }
+        }
+      }
+    }
+    if (error) {
+      for (auto &run : runs) {
+        remove_file(run);
+      }
+      std::rethrow_exception(error);
+    }
+  }
+  stats.runs = runs.size();
+  auto merge_start = Clock::now();
+  stats.run_time = merge_start - start;
+
+  if (runs.empty()) {
+    // 空输入也要生成一个空的输出文件
+    File(out_path, O_WRONLY | O_CREAT | O_TRUNC);
+  }
+  // 每个读缓冲至少 MIN_MERGE_BLOCK，另外两个是写缓冲
+  auto max_fan_in = std::max<std::size_t>(mem_budget / MIN_MERGE_BLOCK, 4) - 2;
+  std::exception_ptr error;
+  while (runs.size() > 1) {
+    stats.merge_passes++;
+    std::vector<std::string> next;
+    // 尽量平均地分组，最后一轮一次合并完
+    auto groups = (runs.size() + max_fan_in - 1) / max_fan_in;
+    auto group_size = (runs.size() + groups - 1) / groups;
+    std::size_t begin = 0;
+    for (; begin < runs.size() && !error; begin += group_size) {
+      std::vector<std::string> group(runs.begin() + begin, runs.begin() + std::min(begin + group_size, runs.size()));
+      auto output = groups == 1 ? out_path : run_path(out_path, stats.merge_passes, next.size());
+      auto block_size = std::max<std::size_t>(mem_budget / (group.size() + 2) / sizeof(T), 1);
+      try {
+        co_await merge_runs<T>(io, pool, group, output, block_size, comp);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      for (auto &run : group) {
+        remove_file(run);
+      }
+      next.push_back(output);
+    }
+    if (error) {
+      // 本轮还没有合并的分组和已经生成的输出都要删除
+      for (auto i = begin; i < runs.size(); i++) {
+        remove_file(runs[i]);
+      }
+      for (auto &run : next) {
+        remove_file(run);
+      }
+      std::rethrow_exception(error);
+    }
+    runs = std::move(next);
+  }
+  if (runs.size() == 1 && runs.front() != out_path) {
+    rename_file(runs.front(), out_path);
+  }
+  stats.merge_time = Clock::now() - merge_start;
+  co_return stats;
+}
+
+/**
+ * 外部排序：把 input 产出的所有元素按 comp 排序后写入 out_path，
+ * 生成有序段时使用的缓冲区和合并时使用的读写缓冲区总共不超过 mem_budget 字节。
+ * 有序段写在 out_path 所在的目录中，排序结束后删除；T 需要可以直接按字节读写
+*/
+template <typename T, typename Compare = std::less<T>>
+SortStats external_sort(generator::Generator<T> input, const std::string &out_path, std::size_t mem_budget,
+                        Compare comp = {}) {
+  static_assert(std::is_trivially_copyable_v<T>, "external_sort requires trivially copyable elements");
+  executor::ThreadPoolExecutor pool;
+  executor::LooperExecutor io;
+  auto task = external_sort_task<T>(pool, pool.thread_count(), io, std::move(input), out_path, mem_budget, comp);
+  return task.get_result();
+}
+
+void Run();
+
+} // namespace sort
+} // namespace co
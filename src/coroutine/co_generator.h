@@ -1,7 +1,195 @@
+#pragma once
+
+#include <span>
+#include <memory>
+#include <utility>
+#include <coroutine>
+#include <exception>
+#include <type_traits>
+#include "co_log.h"
 
 namespace co {
 namespace generator {
 
+template <typename T>
+struct Generator {
+
+  // 协程执行完成之后，外部读取值时抛出的异常
+  class ExhausteException: std::exception {};
+
+  // 引用类型保存指针，co_yield 的对象不会被拷贝
+  using storage_type = std::conditional_t<std::is_reference_v<T>, std::add_pointer_t<T>, T>;
+
+  struct promise_type {
+    storage_type value{};
+    bool is_ready = false;
+    std::exception_ptr exception_ptr;
+
+    // 开始执行时直接挂起等待外部调用 resume 获取下一个值
+    std::suspend_always initial_suspend() {
+      CO_LOG("generator initial suspend");
+      return {};
+    }
+
+    // 执行结束后不需要挂起
+    // std::suspend_never final_suspend() noexcept {
+    //   std::cout << "generator final suspend" << std::endl;
+    //   return {};
+    // }
+
+    // 总是挂起，让 Generator 来销毁
+    std::suspend_always final_suspend() noexcept {
+      CO_LOG("generator final suspend");
+      return {};
+    }
+
+    // 保存异常，在外部读取下一个值时抛出
+    void unhandled_exception() {
+      CO_LOG("generator unhandled exception");
+      exception_ptr = std::current_exception();
+    }
+
+    // 构造协程的返回值类型，绑定 handle
+    Generator get_return_object() {
+      CO_LOG("generator get return object");
+      return Generator{ std::coroutine_handle<promise_type>::from_promise(*this) };
+    }
+
+    // 没有返回值
+    void return_void() {
+      CO_LOG("generator return void");
+    }
+
+    // 将基本类型转化为 awaiter
+    // std::suspend_always await_transform(T value) {
+    //   std::cout << "generator await transform: " << this->value << " to " << value << std::endl;
+    //   this->value = value;
+    //   is_ready = true;
+    //   return {};
+    // }
+
+    // 将 await_transform 替换为 yield_value，对应 co_await 调整为 co_yield
+    // co_yield expr 等价于 co_await promise.yield_value(expr)
+    std::suspend_always yield_value(T value) {
+      CO_LOG("generator yield value");
+      if constexpr (std::is_reference_v<T>) {
+        this->value = std::addressof(value);
+      } else {
+        this->value = std::move(value);
+      }
+      is_ready = true;
+      return {};
+    }
+  };
+
+  // 支持 range-based for，比较是否到达 Sentinel 时推进协程
+  struct Sentinel {};
+
+  struct Iterator {
+    Generator *generator;
+
+    T operator*() const {
+      return generator->current();
+    }
+
+    Iterator &operator++() {
+      generator->handle.promise().is_ready = false;
+      return *this;
+    }
+
+    bool operator==(Sentinel) const {
+      return !generator->has_next();
+    }
+  };
+
+  std::coroutine_handle<promise_type> handle;
+
+  // 显示构造函数，禁止隐式转换
+  explicit Generator(std::coroutine_handle<promise_type> handle) noexcept
+    : handle(handle) {}
+
+
+  // 对于每一个协程实例，都有且仅能有一个 Generator 实例与之对应，因此只支持移动对象，而不支持复制对象。
+  Generator(Generator &&generator) noexcept
+    : handle(std::exchange(generator.handle, {})) {}
+  Generator(Generator &) = delete;
+  Generator &operator=(Generator &) = delete;
+
+  ~Generator() {
+    CO_LOG("generator destroy");
+    // 销毁协程
+    if (handle) {
+      handle.destroy();
+    }
+  }
+
+  bool has_next() {
+    // 协程已经执行完成
+    if (handle.done()) {
+      CO_LOG("generator has next, done(1)");
+      return false;
+    }
+
+    // 协程还没有执行完成，并且下一个值还没有准备好
+    if (!handle.promise().is_ready) {
+      CO_LOG("generator has next, hasn't done, not ready");
+      handle.resume();
+    }
+
+    if (handle.done()) {
+      // 恢复执行之后协程执行完，这时候必然没有通过 co_await 传出值来，如果是因为异常结束则抛出
+      CO_LOG("generator has next, done(2)");
+      if (auto exception_ptr = std::exchange(handle.promise().exception_ptr, nullptr)) {
+        std::rethrow_exception(exception_ptr);
+      }
+      return false;
+    } else {
+      CO_LOG("generator has next, hasn't done");
+      return true;
+    }
+  }
+
+  T next() {
+    if (has_next()) {
+      // 此时一定有值，is_ready 为 true
+      // 消费当前的值，重置 is_ready 为 false
+      handle.promise().is_ready = false;
+      return current();
+    }
+
+    throw ExhausteException();
+  }
+
+  Iterator begin() {
+    return Iterator{ this };
+  }
+
+  Sentinel end() {
+    return {};
+  }
+
+  // 使用 C++ 17 的折叠表达式（fold expression）的特性
+  template<typename ...TArgs>
+  Generator static from(TArgs ...args) {
+    (co_yield args, ...);
+  }
+
+private:
+  T current() {
+    if constexpr (std::is_reference_v<T>) {
+      return *handle.promise().value;
+    } else {
+      return handle.promise().value;
+    }
+  }
+};
+
+/**
+ * 批量生成器，一次 co_yield 传出一批连续的元素，摊薄每个元素恢复一次协程的开销
+*/
+template <typename T>
+using BatchGenerator = Generator<std::span<const T>>;
+
 void Run();
 
 } // end namespace generator
@@ -0,0 +1,292 @@
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include "co_graph.h"
+
+namespace co {
+namespace graph {
+
+TaskGraph::NodeId TaskGraph::add_node(Work &&work, uint64_t cost) {
+  nodes.push_back(Node{ std::move(work), cost });
+  prepared = false;
+  return static_cast<NodeId>(nodes.size() - 1);
+}
+
+void TaskGraph::add_edge(NodeId from, NodeId to) {
+  if (from >= nodes.size() || to >= nodes.size()) {
+    throw std::out_of_range("task graph node does not exist");
+  }
+  edges.emplace_back(from, to);
+  prepared = false;
+}
+
+uint64_t TaskGraph::critical_path() const {
+  uint64_t longest = 0;
+  for (auto root : roots) {
+    longest = std::max(longest, nodes[root].priority);
+  }
+  return longest;
+}
+
+void TaskGraph::prepare() {
+  if (prepared) {
+    return;
+  }
+  auto node_count = nodes.size();
+  successor_offsets.assign(node_count + 1, 0);
+  for (auto &node : nodes) {
+    node.predecessors = 0;
+  }
+  for (auto [from, to] : edges) {
+    successor_offsets[from + 1]++;
+    nodes[to].predecessors++;
+  }
+  for (std::size_t i = 0; i < node_count; i++) {
+    successor_offsets[i + 1] += successor_offsets[i];
+  }
+  successors.resize(edges.size());
+  {
+    std::vector<uint32_t> cursor(successor_offsets.begin(), successor_offsets.end() - 1);
+    for (auto [from, to] : edges) {
+      successors[cursor[from]++] = to;
+    }
+  }
+
+  // 拓扑排序，同时检查是否有环
+  std::vector<NodeId> order;
+  order.reserve(node_count);
+  std::vector<uint32_t> counts(node_count);
+  for (std::size_t i = 0; i < node_count; i++) {
+    counts[i] = nodes[i].predecessors;
+    if (counts[i] == 0) {
+      order.push_back(static_cast<NodeId>(i));
+    }
+  }
+  for (std::size_t i = 0; i < order.size(); i++) {
+    auto node = order[i];
+    for (auto j = successor_offsets[node]; j < successor_offsets[node + 1]; j++) {
+      if (--counts[successors[j]] == 0) {
+        order.push_back(successors[j]);
+      }
+    }
+  }
+  if (order.size() != node_count) {
+    throw std::invalid_argument("task graph has a cycle");
+  }
+
+  // 按拓扑序的逆序计算，后继的优先级总是先算好
+  for (auto it = order.rbegin(); it != order.rend(); it++) {
+    auto &node = nodes[*it];
+    uint64_t longest = 0;
+    for (auto j = successor_offsets[*it]; j < successor_offsets[*it + 1]; j++) {
+      longest = std::max(longest, nodes[successors[j]].priority);
+    }
+    node.priority = node.cost + longest;
+  }
+
+  // 后继和起点都按优先级从高到低排列，调度时逆序放入队列，优先级最高的在队尾，最先被本线程取出
+  auto by_priority = [this](NodeId a, NodeId b) { return nodes[a].priority > nodes[b].priority; };
+  roots.clear();
+  for (std::size_t i = 0; i < node_count; i++) {
+    if (nodes[i].predecessors == 0) {
+      roots.push_back(static_cast<NodeId>(i));
+    }
+  }
+  if (critical_path_first) {
+    for (std::size_t i = 0; i < node_count; i++) {
+      std::stable_sort(successors.begin() + successor_offsets[i], successors.begin() + successor_offsets[i + 1],
+                       by_priority);
+    }
+    std::stable_sort(roots.begin(), roots.end(), by_priority);
+  }
+
+  remaining = std::make_unique<std::atomic<uint32_t>[]>(node_count);
+  prepared = true;
+}
+
+task::Task<void> TaskGraph::run(executor::WorkStealingExecutor &executor) {
+  prepare();
+  if (nodes.empty()) {
+    co_return;
+  }
+  pool = &executor;
+  failed.store(false, std::memory_order_relaxed);
+  error = nullptr;
+  for (std::size_t i = 0; i < nodes.size(); i++) {
+    remaining[i].store(nodes[i].predecessors, std::memory_order_relaxed);
+  }
+  unfinished.store(nodes.size() + 1, std::memory_order_relaxed);
+
+  // 在线程池内调度起点，起点进入本地队列
+  co_await executor::switch_to(executor);
+  for (auto it = roots.rbegin(); it != roots.rend(); it++) {
+    schedule(*it);
+  }
+  co_await CompletionAwaiter{ *this };
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void TaskGraph::schedule(NodeId node) {
+  pool->execute([this, node]() { start(node); });
+}
+
+void TaskGraph::start(NodeId node) {
+  if (failed.load(std::memory_order_relaxed)) {
+    finish(node);
+    return;
+  }
+  // 节点完成之后整个图可能随之完成并被销毁，调用 finish 之后不能再访问成员
+  std::exception_ptr exception;
+  try {
+    nodes[node].task.emplace(nodes[node].work());
+  } catch (...) {
+    exception = std::current_exception();
+  }
+  if (exception) {
+    fail(std::move(exception));
+    finish(node);
+    return;
+  }
+  nodes[node].task->handle.promise().on_completed([this, node](auto result) {
+    try {
+      result.get_or_throw();
+    } catch (...) {
+      fail(std::current_exception());
+    }
+    finish(node);
+  });
+}
+
+void TaskGraph::fail(std::exception_ptr exception) {
+  std::lock_guard lock(error_lock);
+  if (!error) {
+    error = std::move(exception);
+  }
+  failed.store(true, std::memory_order_relaxed);
+}
+
+void TaskGraph::finish(NodeId node) {
+  for (auto i = successor_offsets[node + 1]; i > successor_offsets[node]; i--) {
+    auto successor = successors[i - 1];
+    if (remaining[successor].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      schedule(successor);
+    }
+  }
+  if (unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    waiting.resume();
+  }
+}
+
+namespace {
+
+struct Random {
+  uint64_t state = 88172645463325252ULL;
+
+  uint64_t next() {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+  }
+};
+
+// 模拟 cost 个单位的计算
+uint64_t spin(uint64_t cost) {
+  uint64_t value = cost;
+  for (uint64_t i = 0; i < cost * 64; i++) {
+    value = value * 6364136223846793005ULL + 1442695040888963407ULL;
+  }
+  return value;
+}
+
+/**
+ * 随机生成的 DAG：节点按编号拓扑有序，每个节点有 0~4 个前驱，从前面 1000 个节点中随机选取，
+ * 代价在 1~64 之间随机。每个节点记录自己完成的顺序，用于检查依赖是否被满足
+*/
+struct RandomDag {
+  std::vector<uint64_t> costs;
+  std::vector<std::pair<uint32_t, uint32_t>> edges;
+
+  explicit RandomDag(uint32_t node_count) {
+    Random random;
+    for (uint32_t i = 0; i < node_count; i++) {
+      costs.push_back(1 + random.next() % 64);
+      auto predecessor_count = i == 0 ? 0 : random.next() % 5;
+      for (uint64_t j = 0; j < predecessor_count; j++) {
+        edges.emplace_back(i - 1 - random.next() % std::min<uint32_t>(i, 1000), i);
+      }
+    }
+  }
+};
+
+} // namespace
+
+void Run() {
+  std::cout << "start run graph" << std::endl;
+  constexpr uint32_t NODE_COUNT = 100'000;
+  constexpr int RUNS = 5;
+  RandomDag dag(NODE_COUNT);
+  std::vector<uint64_t> finished(NODE_COUNT);
+  std::atomic<uint64_t> sequence{ 0 };
+  std::atomic<uint64_t> sink{ 0 };
+  std::cout << "nodes: " << NODE_COUNT << ", edges: " << dag.edges.size()
+            << ", hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+
+  // 按编号顺序直接执行，作为没有调度开销的基准
+  auto start = std::chrono::steady_clock::now();
+  uint64_t serial_sink = 0;
+  for (uint32_t i = 0; i < NODE_COUNT; i++) {
+    serial_sink += spin(dag.costs[i]);
+  }
+  auto serial = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000;
+  std::cout << "serial: " << serial << " ms" << std::endl;
+
+  for (bool critical_path_first : { true, false }) {
+    TaskGraph graph(critical_path_first);
+    for (uint32_t i = 0; i < NODE_COUNT; i++) {
+      graph.add_node(
+        [&, i]() -> task::Task<void> {
+          sink.fetch_add(spin(dag.costs[i]), std::memory_order_relaxed);
+          finished[i] = sequence.fetch_add(1, std::memory_order_relaxed);
+          co_return;
+        },
+        dag.costs[i]);
+    }
+    for (auto [from, to] : dag.edges) {
+      graph.add_edge(from, to);
+    }
+    start = std::chrono::steady_clock::now();
+    graph.prepare();
+    auto prepare = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000;
+    std::cout << (critical_path_first ? "critical path first" : "insertion order") << ": prepare " << prepare
+              << " ms, critical path " << graph.critical_path() << std::endl;
+
+    for (std::size_t threads : { 1, 2, 4 }) {
+      executor::WorkStealingExecutor executor(threads);
+      double total = 0;
+      bool correct = true;
+      for (int run = 0; run < RUNS; run++) {
+        sequence = 0;
+        sink = 0;
+        start = std::chrono::steady_clock::now();
+        graph.run(executor).get_result();
+        total += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000;
+        correct = correct && sink == serial_sink && sequence == NODE_COUNT;
+        for (auto [from, to] : dag.edges) {
+          correct = correct && finished[from] < finished[to];
+        }
+      }
+      std::cout << "  " << threads << " threads: " << total / RUNS << " ms/run, "
+                << NODE_COUNT * RUNS / total / 1000 << " M nodes/s, " << (correct ? "correct" : "WRONG")
+                << std::endl;
+    }
+  }
+  std::cout << "end run graph" << std::endl;
+}
+
+} // namespace graph
+} // namespace co
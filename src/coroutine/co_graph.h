@@ -0,0 +1,121 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <optional>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include "co_task.h"
+#include "co_executor.h"
+
+namespace co {
+namespace graph {
+
+/**
+ * 有向无环的任务图，每个节点是一个返回 Task 的函数，所有前驱完成之后才会启动。
+ * 每个节点持有一个原子的前驱计数，节点完成时把后继的计数减一，减到 0 的后继放入当前线程的本地队列；
+ * 图的结构在第一次运行时整理成紧凑的数组，之后结构不变就可以反复运行，不再分配内存。
+ * critical_path_first 为 true 时，同时就绪的节点中关键路径（到终点的最大代价之和）更长的先执行
+*/
+struct TaskGraph {
+  using NodeId = uint32_t;
+  using Work = std::function<task::Task<void>()>;
+
+  explicit TaskGraph(bool critical_path_first = true) : critical_path_first(critical_path_first) {}
+
+  TaskGraph(TaskGraph &) = delete;
+  TaskGraph &operator=(TaskGraph &) = delete;
+
+  // 添加节点，cost 为预估的执行代价，只用于计算关键路径
+  NodeId add_node(Work &&work, uint64_t cost = 1);
+
+  // from 完成之后才能启动 to
+  void add_edge(NodeId from, NodeId to);
+
+  std::size_t node_count() const {
+    return nodes.size();
+  }
+
+  // 节点到终点的最大代价之和（包括自己），运行过或者调用过 prepare 之后才有效
+  uint64_t priority(NodeId node) const {
+    return nodes[node].priority;
+  }
+
+  // 整个图的关键路径长度，即所有起点中最大的优先级
+  uint64_t critical_path() const;
+
+  /**
+   * 整理图的结构并计算优先级，存在环时抛出 std::invalid_argument。
+   * 结构没有变化时不做任何事，run 会自动调用
+  */
+  void prepare();
+
+  /**
+   * 在 executor 上运行整个图，所有节点完成之后返回。
+   * 有节点抛出异常时，尚未启动的节点不再执行，等正在执行的节点结束之后抛出第一个异常。
+   * 同一时间只能有一次运行，运行期间不能修改图
+  */
+  task::Task<void> run(executor::WorkStealingExecutor &executor);
+
+private:
+  struct Node {
+    Work work;
+    uint64_t cost;
+    uint64_t priority = 0;
+    uint32_t predecessors = 0;
+    // 最近一次运行的 Task，下一次运行或者图销毁时释放
+    std::optional<task::Task<void>> task{};
+  };
+
+  // 所有节点完成时恢复 run
+  struct CompletionAwaiter {
+    bool await_ready() const noexcept {
+      return false;
+    }
+
+    // run 自己也占一个计数，节点已经全部完成时不挂起
+    bool await_suspend(std::coroutine_handle<> handle) noexcept {
+      graph.waiting = handle;
+      return graph.unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1;
+    }
+
+    void await_resume() const noexcept {}
+
+    TaskGraph &graph;
+  };
+
+  void schedule(NodeId node);
+  void start(NodeId node);
+  void fail(std::exception_ptr exception);
+  void finish(NodeId node);
+
+  bool critical_path_first;
+  bool prepared = false;
+  std::vector<Node> nodes;
+  std::vector<std::pair<NodeId, NodeId>> edges;
+
+  // 按起点整理的邻接表：节点 i 的后继为 successors[successor_offsets[i], successor_offsets[i + 1])
+  std::vector<uint32_t> successor_offsets;
+  std::vector<NodeId> successors;
+  std::vector<NodeId> roots;
+
+  // 以下为一次运行的状态
+  std::unique_ptr<std::atomic<uint32_t>[]> remaining;
+  std::atomic<std::size_t> unfinished{ 0 };
+  std::coroutine_handle<> waiting;
+  executor::WorkStealingExecutor *pool = nullptr;
+  std::atomic<bool> failed{ false };
+  std::mutex error_lock;
+  std::exception_ptr error;
+};
+
+void Run();
+
+} // namespace graph
+} // namespace co
@@ -0,0 +1,224 @@
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <fcntl.h>
+#include <climits>
+#include <unistd.h>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <sys/uio.h>
+#include <system_error>
+#include "co_task.h"
+#include "co_group_commit.h"
+
+namespace co {
+namespace group_commit {
+
+AppendLog::AppendLog(const std::string &path, executor::AbstractExecutor *resume_executor, std::size_t max_group_size)
+  : resume_executor(resume_executor), max_group_size(std::max<std::size_t>(max_group_size, 1)) {
+  fd = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "open " + path);
+  }
+  file_size = ::lseek(fd, 0, SEEK_END);
+  io_thread = std::thread(&AppendLog::run_loop, this);
+}
+
+AppendLog::~AppendLog() {
+  {
+    std::lock_guard lock(queue_lock);
+    is_active = false;
+  }
+  queue_condition.notify_one();
+  // I/O 线程会先提交完队列中剩余的记录
+  io_thread.join();
+  ::close(fd);
+}
+
+CommitMetrics AppendLog::metrics() {
+  std::lock_guard lock(metrics_lock);
+  return commit_metrics;
+}
+
+void AppendLog::enqueue(AppendAwaiter *awaiter) {
+  awaiter->enqueue_time = std::chrono::steady_clock::now();
+  {
+    std::lock_guard lock(queue_lock);
+    pending.push_back(awaiter);
+  }
+  queue_condition.notify_one();
+}
+
+void AppendLog::run_loop() {
+  std::vector<AppendAwaiter *> group;
+  while (true) {
+    {
+      std::unique_lock lock(queue_lock);
+      queue_condition.wait(lock, [this]() { return !pending.empty() || !is_active; });
+      if (pending.empty()) {
+        return;
+      }
+      // 取走当前积累的所有记录作为一组
+      if (pending.size() <= max_group_size) {
+        std::swap(group, pending);
+      } else {
+        group.assign(pending.begin(), pending.begin() + max_group_size);
+        pending.erase(pending.begin(), pending.begin() + max_group_size);
+      }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::exception_ptr exception_ptr;
+    try {
+      commit(group);
+    } catch (...) {
+      exception_ptr = std::current_exception();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    {
+      std::lock_guard lock(metrics_lock);
+      commit_metrics.groups++;
+      commit_metrics.records += group.size();
+      commit_metrics.max_group_size = std::max<uint64_t>(commit_metrics.max_group_size, group.size());
+      commit_metrics.total_sync_time += end - start;
+      for (auto awaiter : group) {
+        auto latency = end - awaiter->enqueue_time;
+        commit_metrics.bytes += awaiter->record.size();
+        commit_metrics.total_latency += latency;
+        commit_metrics.max_latency = std::max<std::chrono::nanoseconds>(commit_metrics.max_latency, latency);
+      }
+    }
+
+    // 恢复之后 awaiter 可能随协程一起销毁，先取出所有 handle
+    std::vector<std::coroutine_handle<>> handles;
+    handles.reserve(group.size());
+    for (auto awaiter : group) {
+      awaiter->exception_ptr = exception_ptr;
+      handles.push_back(awaiter->handle);
+    }
+    group.clear();
+    for (auto handle : handles) {
+      if (resume_executor) {
+        resume_executor->execute([handle]() { handle.resume(); });
+      } else {
+        handle.resume();
+      }
+    }
+  }
+}
+
+void AppendLog::commit(std::vector<AppendAwaiter *> &group) {
+  std::vector<iovec> iovecs;
+  iovecs.reserve(group.size() * 2);
+  auto offset = file_size;
+  for (auto awaiter : group) {
+    awaiter->offset = offset;
+    awaiter->length_prefix = static_cast<uint32_t>(awaiter->record.size());
+    iovecs.push_back({ &awaiter->length_prefix, sizeof(awaiter->length_prefix) });
+    iovecs.push_back({ const_cast<char *>(awaiter->record.data()), awaiter->record.size() });
+    offset += sizeof(awaiter->length_prefix) + awaiter->record.size();
+  }
+
+  // pwritev 一次最多接受 IOV_MAX 个 iovec，并且可能只写入一部分，需要循环写
+  std::size_t index = 0;
+  auto position = file_size;
+  while (index < iovecs.size()) {
+    auto count = std::min<std::size_t>(iovecs.size() - index, IOV_MAX);
+    auto written = ::pwritev(fd, &iovecs[index], static_cast<int>(count), static_cast<off_t>(position));
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(), "pwritev");
+    }
+    position += written;
+    while (written > 0) {
+      auto &iov = iovecs[index];
+      if (static_cast<std::size_t>(written) >= iov.iov_len) {
+        written -= iov.iov_len;
+        index++;
+      } else {
+        iov.iov_base = static_cast<char *>(iov.iov_base) + written;
+        iov.iov_len -= written;
+        written = 0;
+      }
+    }
+  }
+
+  if (::fdatasync(fd) != 0) {
+    throw std::system_error(errno, std::generic_category(), "fdatasync");
+  }
+  file_size = offset;
+}
+
+task::Task<int> append_records(AppendLog &log, int id, int count) {
+  for (int i = 0; i < count; i++) {
+    auto record = "task " + std::to_string(id) + " record " + std::to_string(i);
+    co_await log.append(record);
+  }
+  co_return count;
+}
+
+// 对照：每条记录各自 write + fdatasync
+double append_with_fsync_per_record(const std::string &path, int count) {
+  auto fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "open " + path);
+  }
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < count; i++) {
+    auto record = "record " + std::to_string(i);
+    uint32_t length = record.size();
+    iovec iovecs[] = { { &length, sizeof(length) }, { record.data(), record.size() } };
+    if (::writev(fd, iovecs, 2) < 0 || ::fdatasync(fd) != 0) {
+      ::close(fd);
+      throw std::system_error(errno, std::generic_category(), "append");
+    }
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  ::close(fd);
+  return count / std::chrono::duration<double>(elapsed).count();
+}
+
+void Run() {
+  std::cout << "start run group commit" << std::endl;
+  // 放在 tmpfs 上时 fdatasync 几乎没有开销，需要放在真实的磁盘上才能看出组提交的收益
+  auto path = (std::filesystem::temp_directory_path() / "co_group_commit.log").string();
+  constexpr int TOTAL_RECORDS = 20000;
+
+  std::cout << "fsync per record: " << append_with_fsync_per_record(path, 2000) << " records/s" << std::endl;
+
+  for (int task_count : { 1, 16, 256 }) {
+    std::filesystem::remove(path);
+    executor::LooperExecutor executor;
+    CommitMetrics metrics;
+    auto start = std::chrono::steady_clock::now();
+    {
+      AppendLog log(path, &executor);
+      std::vector<task::Task<int>> tasks;
+      for (int id = 0; id < task_count; id++) {
+        tasks.push_back(append_records(log, id, TOTAL_RECORDS / task_count));
+      }
+      for (auto &task : tasks) {
+        task.get_result();
+      }
+      metrics = log.metrics();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "group commit with " << task_count << " tasks: "
+              << metrics.records / std::chrono::duration<double>(elapsed).count() << " records/s, "
+              << metrics.groups << " groups, average group size " << metrics.average_group_size()
+              << ", max group size " << metrics.max_group_size
+              << ", average latency " << std::chrono::duration<double, std::micro>(metrics.average_latency()).count() << " us"
+              << ", max latency " << std::chrono::duration<double, std::micro>(metrics.max_latency).count() << " us"
+              << std::endl;
+  }
+  std::filesystem::remove(path);
+  std::cout << "end run group commit" << std::endl;
+}
+
+} // namespace group_commit
+} // namespace co
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <coroutine>
+#include <exception>
+#include <string_view>
+#include <condition_variable>
+#include "co_executor.h"
+
+namespace co {
+namespace group_commit {
+
+/**
+ * 提交统计，group 为一次 pwritev + fdatasync，latency 为单条记录从 append 到落盘的时间
+*/
+struct CommitMetrics {
+  uint64_t groups = 0;
+  uint64_t records = 0;
+  uint64_t bytes = 0;
+  uint64_t max_group_size = 0;
+  std::chrono::nanoseconds total_latency{ 0 };
+  std::chrono::nanoseconds max_latency{ 0 };
+  std::chrono::nanoseconds total_sync_time{ 0 };
+
+  double average_group_size() const {
+    return groups == 0 ? 0 : static_cast<double>(records) / groups;
+  }
+
+  std::chrono::nanoseconds average_latency() const {
+    return records == 0 ? std::chrono::nanoseconds(0) : total_latency / static_cast<int64_t>(records);
+  }
+};
+
+/**
+ * 组提交的追加日志，co_await log.append(record) 在记录落盘之后才恢复，返回记录在文件中的偏移。
+ * 所有协程追加的记录先进入等待队列，由单独的 I/O 线程一次取走整组，
+ * 用一次 pwritev 写入、一次 fdatasync 落盘，再恢复这一组的所有等待者；
+ * I/O 线程在 fdatasync 的同时，新的记录在队列中积累成下一组。
+ * 每条记录在文件中以 4 字节的长度前缀开头，写入时直接引用调用方的内存，不做拷贝
+*/
+struct AppendLog {
+  struct AppendAwaiter;
+
+  /**
+   * resume_executor 决定等待者在哪里恢复，为空时直接在 I/O 线程上恢复；
+   * max_group_size 限制一组最多包含的记录数
+  */
+  explicit AppendLog(const std::string &path,
+                     executor::AbstractExecutor *resume_executor = nullptr,
+                     std::size_t max_group_size = 1024);
+  ~AppendLog();
+
+  AppendLog(AppendLog &) = delete;
+  AppendLog &operator=(AppendLog &) = delete;
+
+  // record 在 co_await 返回之前需要保持有效
+  AppendAwaiter append(std::string_view record) {
+    return AppendAwaiter(this, record);
+  }
+
+  CommitMetrics metrics();
+
+  struct AppendAwaiter {
+    constexpr bool await_ready() const noexcept {
+      return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+      this->handle = handle;
+      log->enqueue(this);
+    }
+
+    // 返回记录（包括长度前缀）在文件中的偏移，写入失败时抛出异常
+    uint64_t await_resume() {
+      if (exception_ptr) {
+        std::rethrow_exception(exception_ptr);
+      }
+      return offset;
+    }
+
+    AppendAwaiter(AppendLog *log, std::string_view record) : log(log), record(record) {}
+
+  private:
+    friend struct AppendLog;
+
+    AppendLog *log;
+    std::string_view record;
+    uint32_t length_prefix = 0;
+    std::chrono::steady_clock::time_point enqueue_time;
+    uint64_t offset = 0;
+    std::exception_ptr exception_ptr;
+    std::coroutine_handle<> handle;
+  };
+
+private:
+  void enqueue(AppendAwaiter *awaiter);
+
+  void run_loop();
+
+  // 写入并落盘一组记录，失败时抛出 std::system_error
+  void commit(std::vector<AppendAwaiter *> &group);
+
+  int fd = -1;
+  uint64_t file_size = 0;
+  executor::AbstractExecutor *resume_executor;
+  std::size_t max_group_size;
+
+  std::mutex queue_lock;
+  std::condition_variable queue_condition;
+  std::vector<AppendAwaiter *> pending;
+  bool is_active = true;
+
+  std::mutex metrics_lock;
+  CommitMetrics commit_metrics;
+
+  std::thread io_thread;
+};
+
+void Run();
+
+} // namespace group_commit
+} // namespace co
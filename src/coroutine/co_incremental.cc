@@ -0,0 +1,321 @@
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include "co_parallel.h"
+#include "co_incremental.h"
+
+namespace co {
+namespace incremental {
+
+bool Node::ComputingAwaiter::await_suspend(std::coroutine_handle<> handle) {
+  std::lock_guard guard(node.lock);
+  if (!node.computing) {
+    // 计算已经结束，不再挂起，结果由 refresh 重新检查
+    return false;
+  }
+  waiting = handle;
+  node.waiters.push_back(this);
+  return true;
+}
+
+task::Task<void> Node::refresh_all(executor::AbstractExecutor &executor, const std::vector<Node *> &nodes) {
+  std::vector<Node *> dirty_nodes;
+  for (auto node : nodes) {
+    if (node->is_dirty()) {
+      dirty_nodes.push_back(node);
+    }
+  }
+  if (dirty_nodes.empty()) {
+    co_return;
+  }
+  if (dirty_nodes.size() == 1) {
+    co_await dirty_nodes[0]->refresh();
+    co_return;
+  }
+  std::vector<task::Task<void>> refreshing;
+  refreshing.reserve(dirty_nodes.size());
+  for (auto node : dirty_nodes) {
+    refreshing.push_back(parallel::spawn(executor, [node]() { return node->refresh(); }));
+  }
+  co_await parallel::when_all(std::move(refreshing));
+}
+
+task::Task<void> Node::refresh() {
+  while (true) {
+    std::unique_lock guard(lock);
+    if (!dirty) {
+      co_return;
+    }
+    if (!computing) {
+      computing = true;
+      break;
+    }
+    // 其他协程正在计算，等它结束；计算失败时抛出同样的异常，否则节点已经是最新的
+    guard.unlock();
+    co_await ComputingAwaiter{ *this };
+  }
+
+  bool changed = false;
+  std::exception_ptr failure;
+  try {
+    // 从未计算过，或者上次读取的节点中有值在上次确认之后改变过，才需要重新计算
+    auto stale = verified_at == 0;
+    if (!stale) {
+      co_await refresh_all(runtime.executor, dependencies);
+      stale = std::any_of(dependencies.begin(), dependencies.end(),
+                          [this](Node *dependency) { return dependency->changed_at > verified_at; });
+    }
+    if (stale) {
+      // 依赖关系以本次计算实际读取的节点为准，先断开旧的依赖
+      std::vector<Node *> previous;
+      {
+        std::lock_guard guard(lock);
+        previous = std::exchange(dependencies, {});
+      }
+      for (auto dependency : previous) {
+        std::lock_guard guard(dependency->lock);
+        auto &list = dependency->dependents;
+        auto it = std::find(list.begin(), list.end(), this);
+        if (it != list.end()) {
+          *it = list.back();
+          list.pop_back();
+        }
+      }
+      changed = co_await recompute();
+    }
+  } catch (...) {
+    failure = std::current_exception();
+  }
+
+  if (!failure) {
+    auto revision = runtime.revision();
+    if (changed) {
+      changed_at = revision;
+    }
+    verified_at = revision;
+  } else {
+    // 旧的依赖可能已经断开，新的依赖只记录了抛出异常之前读取的部分，据此判断不出是否过期，下次必须重新计算
+    verified_at = 0;
+  }
+  std::unique_lock guard(lock);
+  computing = false;
+  dirty = failure != nullptr;
+  auto resumed = std::move(waiters);
+  waiters.clear();
+  guard.unlock();
+  for (auto waiter : resumed) {
+    waiter->error = failure;
+    waiter->waiting.resume();
+  }
+  if (failure) {
+    std::rethrow_exception(failure);
+  }
+}
+
+void Node::invalidate() {
+  std::vector<Node *> pending;
+  {
+    std::lock_guard guard(lock);
+    pending = dependents;
+  }
+  while (!pending.empty()) {
+    auto node = pending.back();
+    pending.pop_back();
+    std::lock_guard guard(node->lock);
+    // 已经需要刷新的节点，依赖它的节点也都已经标记过
+    if (node->dirty) {
+      continue;
+    }
+    node->dirty = true;
+    pending.insert(pending.end(), node->dependents.begin(), node->dependents.end());
+  }
+}
+
+task::Task<void> Scope::track(Node &dependency) {
+  co_await dependency.refresh();
+  record(dependency);
+}
+
+task::Task<void> Scope::track_all(std::vector<Node *> dependencies) {
+  co_await Node::refresh_all(node.runtime.executor, dependencies);
+  for (auto dependency : dependencies) {
+    record(*dependency);
+  }
+}
+
+void Scope::record(Node &dependency) {
+  {
+    std::lock_guard guard(node.lock);
+    auto &list = node.dependencies;
+    if (std::find(list.begin(), list.end(), &dependency) != list.end()) {
+      return;
+    }
+    list.push_back(&dependency);
+  }
+  std::lock_guard guard(dependency.lock);
+  dependency.dependents.push_back(&node);
+}
+
+namespace {
+
+constexpr std::size_t INPUT_COUNT = 100'000;
+constexpr std::size_t FAN_IN = 16;
+constexpr int64_t BUCKET = 100;
+
+/**
+ * 测试用的依赖图：每个输入对应一个分桶节点（输入值除以 100），
+ * 之后每 16 个节点求和作为上一层的一个节点，直到只剩一个根节点；
+ * 第一层求和节点还会读取下一组的第一个分桶节点，使相邻的子树共享依赖
+*/
+struct Graph {
+  explicit Graph(Runtime &runtime) {
+    for (std::size_t i = 0; i < INPUT_COUNT; i++) {
+      inputs.push_back(std::make_unique<Input<int64_t>>(runtime, static_cast<int64_t>(i * 7919 % 100'000)));
+      auto input = inputs.back().get();
+      buckets.push_back(std::make_unique<Derived<int64_t>>(runtime, [input](Scope &scope) -> task::Task<int64_t> {
+        co_return co_await input->get(scope) / BUCKET;
+      }));
+    }
+    std::vector<Derived<int64_t> *> level;
+    for (auto &bucket : buckets) {
+      level.push_back(bucket.get());
+    }
+    bool first_level = true;
+    while (level.size() > 1) {
+      std::vector<Derived<int64_t> *> next;
+      for (std::size_t begin = 0; begin < level.size(); begin += FAN_IN) {
+        std::vector<Derived<int64_t> *> children(level.begin() + begin,
+                                                 level.begin() + std::min(begin + FAN_IN, level.size()));
+        if (first_level) {
+          children.push_back(level[(begin + FAN_IN) % level.size()]);
+        }
+        sums.push_back(std::make_unique<Derived<int64_t>>(
+          runtime, [children = std::move(children)](Scope &scope) -> task::Task<int64_t> {
+            co_await scope.track_all(std::vector<Node *>(children.begin(), children.end()));
+            int64_t sum = 0;
+            for (auto child : children) {
+              sum += child->peek();
+            }
+            co_return sum;
+          }));
+        next.push_back(sums.back().get());
+      }
+      level = std::move(next);
+      first_level = false;
+    }
+    root = level[0];
+  }
+
+  // 不使用依赖图，直接从输入算出根节点的值
+  int64_t compute_directly() const {
+    std::vector<int64_t> level;
+    for (auto &input : inputs) {
+      level.push_back(input->get() / BUCKET);
+    }
+    bool first_level = true;
+    while (level.size() > 1) {
+      std::vector<int64_t> next;
+      for (std::size_t begin = 0; begin < level.size(); begin += FAN_IN) {
+        int64_t sum = 0;
+        for (auto i = begin; i < std::min(begin + FAN_IN, level.size()); i++) {
+          sum += level[i];
+        }
+        if (first_level) {
+          sum += level[(begin + FAN_IN) % level.size()];
+        }
+        next.push_back(sum);
+      }
+      level = std::move(next);
+      first_level = false;
+    }
+    return level[0];
+  }
+
+  std::vector<std::unique_ptr<Input<int64_t>>> inputs;
+  std::vector<std::unique_ptr<Derived<int64_t>>> buckets;
+  std::vector<std::unique_ptr<Derived<int64_t>>> sums;
+  Derived<int64_t> *root = nullptr;
+};
+
+template <typename Func>
+double measure(Func &&func) {
+  auto start = std::chrono::steady_clock::now();
+  func();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000;
+}
+
+} // namespace
+
+void Run() {
+  std::cout << "start run incremental" << std::endl;
+  constexpr int UPDATES = 100;
+  executor::WorkStealingExecutor executor(std::max(std::thread::hardware_concurrency(), 2u));
+  Runtime runtime(executor);
+  Graph graph(runtime);
+  std::cout << "nodes: " << graph.inputs.size() << " inputs, " << graph.buckets.size() + graph.sums.size()
+            << " derived" << std::endl;
+
+  int64_t value = 0;
+  auto initial = measure([&]() { value = graph.root->get().get_result(); });
+  int64_t expected = 0;
+  auto direct = measure([&]() { expected = graph.compute_directly(); });
+  std::cout << "initial compute: " << initial << " ms, " << runtime.recomputed() << " computed, "
+            << (value == expected ? "correct" : "WRONG") << std::endl;
+  std::cout << "direct compute from scratch: " << direct << " ms" << std::endl;
+
+  // 改变分桶结果的修改会一直传播到根节点；不改变分桶结果的修改在分桶节点就被截断
+  for (int64_t delta : { BUCKET, int64_t(1) }) {
+    uint64_t state = 88172645463325252ULL;
+    auto recomputed = runtime.recomputed();
+    double total = 0;
+    bool correct = true;
+    for (int i = 0; i < UPDATES; i++) {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      auto &input = *graph.inputs[state % INPUT_COUNT];
+      // 保证加 1 时不跨过分桶的边界
+      input.set(input.get() / BUCKET * BUCKET + (delta == 1 ? input.get() % BUCKET % (BUCKET - 1) + 1 : delta));
+      total += measure([&]() { value = graph.root->get().get_result(); });
+      correct = correct && value == graph.compute_directly();
+    }
+    std::cout << "single input change (" << (delta == 1 ? "same bucket" : "new bucket") << "): " << total / UPDATES
+              << " ms/update, " << static_cast<double>(runtime.recomputed() - recomputed) / UPDATES
+              << " recomputed/update, " << (correct ? "correct" : "WRONG") << std::endl;
+  }
+  // 计算在读取了一部分依赖之后失败，下次刷新必须重新计算，不能根据不完整的依赖认为值是最新的
+  {
+    Runtime small(executor);
+    Input<int64_t> a(small, 1);
+    Input<int64_t> b(small, 10);
+    bool fail = false;
+    Derived<int64_t> d(small, [&](Scope &scope) -> task::Task<int64_t> {
+      auto from_b = co_await b.get(scope);
+      if (fail) {
+        throw std::runtime_error("compute failed");
+      }
+      auto from_a = co_await a.get(scope);
+      co_return from_a + from_b;
+    });
+    auto before = d.get().get_result();
+    a.set(2);
+    fail = true;
+    auto threw = false;
+    try {
+      d.get().get_result();
+    } catch (std::runtime_error &) {
+      threw = true;
+    }
+    fail = false;
+    auto after = d.get().get_result();
+    std::cout << "refresh after a failed compute: " << before << " -> " << after << ", "
+              << (before == 11 && threw && after == 12 ? "correct" : "WRONG") << std::endl;
+  }
+  std::cout << "end run incremental" << std::endl;
+}
+
+} // namespace incremental
+} // namespace co
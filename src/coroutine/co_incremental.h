@@ -0,0 +1,235 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <optional>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include "co_task.h"
+#include "co_executor.h"
+
+namespace co {
+namespace incremental {
+
+struct Runtime;
+
+/**
+ * 依赖图中的节点，输入和派生值的公共部分。
+ * changed_at 为值最近一次真正改变时的版本号，verified_at 为最近一次确认值是最新的版本号；
+ * 派生值重新计算之后如果与原来的值相等，changed_at 不变，依赖它的节点就不需要重新计算
+*/
+struct Node {
+  explicit Node(Runtime &runtime) : runtime(runtime) {}
+  virtual ~Node() = default;
+
+  Node(Node &) = delete;
+  Node &operator=(Node &) = delete;
+
+  /**
+   * 使节点的值成为最新的：先并发地刷新上次计算时的依赖，
+   * 只有依赖的值在上次确认之后改变过才重新计算。多个协程同时刷新同一个节点时只计算一次
+  */
+  task::Task<void> refresh();
+
+  // 是否需要刷新
+  bool is_dirty() {
+    std::lock_guard guard(lock);
+    return dirty;
+  }
+
+protected:
+  // 刷新 nodes 中需要刷新的节点，多于一个时并发执行
+  static task::Task<void> refresh_all(executor::AbstractExecutor &executor, const std::vector<Node *> &nodes);
+
+  // 重新计算值，返回值是否改变；计算时通过 Scope 记录新的依赖
+  virtual task::Task<bool> recompute() = 0;
+
+  // 把所有直接、间接依赖自己的节点标记为需要刷新
+  void invalidate();
+
+  // 等待别的协程正在进行的计算结束，计算失败时抛出同样的异常
+  struct ComputingAwaiter {
+    bool await_ready() const noexcept {
+      return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle);
+
+    void await_resume() const {
+      if (error) {
+        std::rethrow_exception(error);
+      }
+    }
+
+    Node &node;
+    std::coroutine_handle<> waiting{};
+    std::exception_ptr error{};
+  };
+
+  friend struct Scope;
+
+  Runtime &runtime;
+
+  // 以下成员由 lock 保护
+  std::mutex lock;
+  bool dirty = true;
+  bool computing = false;
+  std::vector<ComputingAwaiter *> waiters;
+  std::vector<Node *> dependents;
+  // 最近一次计算读取的节点，计算过程中也可能被 Scope 并发修改
+  std::vector<Node *> dependencies;
+
+  // 只由正在计算的协程修改；计算抛出异常时节点保持 dirty，verified_at 清零，下次刷新时重新计算
+  uint64_t changed_at = 0;
+  uint64_t verified_at = 0;
+};
+
+/**
+ * 计算过程中读取其他节点的入口，读取的节点被记录为依赖
+*/
+struct Scope {
+  explicit Scope(Node &node) : node(node) {}
+
+  Scope(Scope &) = delete;
+  Scope &operator=(Scope &) = delete;
+
+  // 刷新 dependency 并记录为依赖，通常由 Input 和 Derived 的 get(scope) 调用
+  task::Task<void> track(Node &dependency);
+
+  // 并发刷新所有 dependencies 并记录为依赖
+  task::Task<void> track_all(std::vector<Node *> dependencies);
+
+private:
+  void record(Node &dependency);
+
+  Node &node;
+};
+
+/**
+ * 依赖图的运行环境，维护全局版本号。
+ * 修改输入时不能有正在进行的计算：修改输入会把依赖它的节点全部标记为需要刷新
+*/
+struct Runtime {
+  explicit Runtime(executor::AbstractExecutor &executor) : executor(executor) {}
+
+  Runtime(Runtime &) = delete;
+  Runtime &operator=(Runtime &) = delete;
+
+  uint64_t revision() const {
+    return current_revision.load(std::memory_order_acquire);
+  }
+
+  // 派生值实际执行计算的次数
+  uint64_t recomputed() const {
+    return recompute_count.load(std::memory_order_relaxed);
+  }
+
+  executor::AbstractExecutor &executor;
+
+private:
+  friend struct Node;
+  template <typename T>
+  friend struct Input;
+  template <typename T>
+  friend struct Derived;
+
+  // 版本号从 1 开始，0 表示从未计算过
+  std::atomic<uint64_t> current_revision{ 1 };
+  std::atomic<uint64_t> recompute_count{ 0 };
+};
+
+/**
+ * 输入值，由外部设置，值不同时才会使依赖它的节点失效
+*/
+template <typename T>
+struct Input : Node {
+  Input(Runtime &runtime, T initial) : Node(runtime), value(std::move(initial)) {
+    dirty = false;
+    changed_at = verified_at = runtime.revision();
+  }
+
+  const T &get() const {
+    return value;
+  }
+
+  // 在计算中读取，同时记录依赖
+  task::Task<T> get(Scope &scope) {
+    co_await scope.track(*this);
+    co_return value;
+  }
+
+  void set(T new_value) {
+    if (new_value == value) {
+      return;
+    }
+    value = std::move(new_value);
+    changed_at = verified_at = ++runtime.current_revision;
+    invalidate();
+  }
+
+protected:
+  // 输入总是最新的
+  task::Task<bool> recompute() override {
+    co_return false;
+  }
+
+private:
+  T value;
+};
+
+/**
+ * 派生值：由 compute(scope) 计算并缓存，计算过程中通过 scope 读取的节点被记录为依赖。
+ * T 需要支持 == 比较，重新计算得到相同的值时，依赖它的节点不会重新计算
+*/
+template <typename T>
+struct Derived : Node {
+  using Compute = std::function<task::Task<T>(Scope &)>;
+
+  Derived(Runtime &runtime, Compute &&compute) : Node(runtime), compute(std::move(compute)) {}
+
+  // 在图之外读取最新的值，不记录依赖
+  task::Task<T> get() {
+    co_await refresh();
+    co_return *value;
+  }
+
+  // 在其他节点的计算中读取，同时记录依赖
+  task::Task<T> get(Scope &scope) {
+    co_await scope.track(*this);
+    co_return *value;
+  }
+
+  /**
+   * 读取已经刷新过的值，通常在 scope.track_all 之后使用。
+   * 节点正在计算或者尚未计算过时结果未定义
+  */
+  const T &peek() const {
+    return *value;
+  }
+
+protected:
+  task::Task<bool> recompute() override {
+    runtime.recompute_count.fetch_add(1, std::memory_order_relaxed);
+    Scope scope(*this);
+    T result = co_await compute(scope);
+    if (value && *value == result) {
+      co_return false;
+    }
+    value = std::move(result);
+    co_return true;
+  }
+
+private:
+  Compute compute;
+  std::optional<T> value;
+};
+
+void Run();
+
+} // namespace incremental
+} // namespace co
@@ -0,0 +1,238 @@
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstdint>
+#include <numeric>
+#include <iostream>
+#include <algorithm>
+#include "co_interleave.h"
+
+namespace co {
+namespace prefetch {
+
+// 查找不到时返回 0，插入的 value 都不为 0
+constexpr uint64_t NOT_FOUND = 0;
+
+/**
+ * 链式哈希表，节点在内存中随机分布，沿着链表的每一次指针跳转都是一次 cache miss
+*/
+struct HashTable {
+  struct Node {
+    uint64_t key;
+    uint64_t value;
+    Node *next;
+  };
+
+  // 每个桶平均挂 load_factor 个节点，链越长指针跳转越多
+  explicit HashTable(std::size_t size, std::size_t load_factor = 4) : nodes(size) {
+    std::size_t bucket_count = 1;
+    while (bucket_count * load_factor < size) {
+      bucket_count <<= 1;
+    }
+    buckets.assign(bucket_count, nullptr);
+    mask = bucket_count - 1;
+
+    // 打乱节点的存放位置，让链表上相邻的节点在内存中不相邻
+    std::vector<std::size_t> slots(size);
+    std::iota(slots.begin(), slots.end(), 0);
+    std::shuffle(slots.begin(), slots.end(), std::mt19937_64(42));
+    for (uint64_t key = 0; key < size; key++) {
+      auto &node = nodes[slots[key]];
+      auto &bucket = buckets[hash(key) & mask];
+      node = Node{ key, key * 2 + 1, bucket };
+      bucket = &node;
+    }
+  }
+
+  static uint64_t hash(uint64_t key) {
+    // murmur3 的 finalizer
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+  }
+
+  // 顺序查找，作为对照
+  uint64_t find(uint64_t key) const {
+    for (auto node = buckets[hash(key) & mask]; node; node = node->next) {
+      if (node->key == key) {
+        return node->value;
+      }
+    }
+    return NOT_FOUND;
+  }
+
+  // 可交错执行的查找，每次访问新的内存之前先预取再挂起
+  Lookup<uint64_t> probe(uint64_t key) const {
+    auto bucket = &buckets[hash(key) & mask];
+    __builtin_prefetch(bucket);
+    co_await prefetch_yield{};
+
+    for (auto node = *bucket; node; node = node->next) {
+      __builtin_prefetch(node);
+      co_await prefetch_yield{};
+      if (node->key == key) {
+        co_return node->value;
+      }
+    }
+    co_return NOT_FOUND;
+  }
+
+private:
+  std::vector<Node *> buckets;
+  std::vector<Node> nodes;
+  uint64_t mask = 0;
+};
+
+/**
+ * 批量构建的静态 B+ 树，每层一次 cache miss，查找路径上的节点只有读到父节点之后才知道地址
+*/
+struct BPlusTree {
+  static constexpr std::size_t FANOUT = 16;
+
+  struct Node {
+    uint32_t count = 0;
+    bool leaf = true;
+    uint64_t keys[FANOUT];
+    union {
+      const Node *children[FANOUT];
+      uint64_t values[FANOUT];
+    };
+
+    // 第一个大于 key 的位置
+    std::size_t upper_bound(uint64_t key) const {
+      std::size_t i = 0;
+      while (i < count && keys[i] <= key) {
+        i++;
+      }
+      return i;
+    }
+
+    // 节点的 key 和指针跨了多个 cache line，全部预取
+    void prefetch() const {
+      auto begin = reinterpret_cast<const char *>(this);
+      for (std::size_t offset = 0; offset < sizeof(Node); offset += 64) {
+        __builtin_prefetch(begin + offset);
+      }
+    }
+  };
+
+  // keys 需要有序，value 为 key * 2 + 1
+  explicit BPlusTree(const std::vector<uint64_t> &keys) {
+    // 自底向上逐层构建，每一层放在一个单独的数组里，保证节点地址在构建过程中不变
+    auto &leaves = levels.emplace_back((keys.size() + FANOUT - 1) / FANOUT);
+    for (std::size_t i = 0; i < keys.size(); i++) {
+      auto &leaf = leaves[i / FANOUT];
+      leaf.keys[leaf.count] = keys[i];
+      leaf.values[leaf.count] = keys[i] * 2 + 1;
+      leaf.count++;
+    }
+
+    while (levels.back().size() > 1) {
+      auto &children = levels.back();
+      std::vector<Node> parents((children.size() + FANOUT - 1) / FANOUT);
+      for (std::size_t i = 0; i < children.size(); i++) {
+        auto &parent = parents[i / FANOUT];
+        parent.leaf = false;
+        parent.keys[parent.count] = children[i].keys[0];
+        parent.children[parent.count] = &children[i];
+        parent.count++;
+      }
+      // vector 的移动不会改变元素地址，子节点指针依然有效
+      levels.push_back(std::move(parents));
+    }
+    root = &levels.back().front();
+  }
+
+  uint64_t find(uint64_t key) const {
+    auto node = root;
+    while (true) {
+      auto i = node->upper_bound(key);
+      if (node->leaf) {
+        return i > 0 && node->keys[i - 1] == key ? node->values[i - 1] : NOT_FOUND;
+      }
+      node = node->children[i > 0 ? i - 1 : 0];
+    }
+  }
+
+  Lookup<uint64_t> probe(uint64_t key) const {
+    auto node = root;
+    while (true) {
+      node->prefetch();
+      co_await prefetch_yield{};
+      auto i = node->upper_bound(key);
+      if (node->leaf) {
+        co_return i > 0 && node->keys[i - 1] == key ? node->values[i - 1] : NOT_FOUND;
+      }
+      node = node->children[i > 0 ? i - 1 : 0];
+    }
+  }
+
+private:
+  std::vector<std::vector<Node>> levels;
+  const Node *root = nullptr;
+};
+
+template <typename Func>
+double measure_ns_per_op(std::size_t ops, Func &&func) {
+  auto start = std::chrono::steady_clock::now();
+  func();
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / ops;
+}
+
+/**
+ * 对比顺序查找与不同组大小的交错查找，组大小为 1 时可以看出协程本身的开销
+*/
+template <typename Table>
+void benchmark(const char *name, const Table &table, const std::vector<uint64_t> &keys) {
+  uint64_t checksum = 0;
+  auto sequential = measure_ns_per_op(keys.size(), [&]() {
+    for (auto key : keys) {
+      checksum += table.find(key);
+    }
+  });
+  std::cout << name << " sequential: " << sequential << " ns/lookup" << std::endl;
+
+  auto probes = keys | std::views::transform([&table](uint64_t key) { return table.probe(key); });
+  for (std::size_t group_size : { 1, 4, 8, 16, 32 }) {
+    uint64_t interleaved_checksum = 0;
+    auto interleaved = measure_ns_per_op(keys.size(), [&]() {
+      interleave(group_size, probes, [&](std::size_t, uint64_t value) {
+        interleaved_checksum += value;
+      });
+    });
+    std::cout << name << " interleave(" << group_size << "): " << interleaved << " ns/lookup, speedup "
+              << sequential / interleaved << "x"
+              << (interleaved_checksum == checksum ? "" : " (checksum mismatch)") << std::endl;
+  }
+}
+
+void Run() {
+  std::cout << "start run interleave" << std::endl;
+  // 表的大小需要超过 LLC 才能体现出交错执行的收益，按机器的 cache 大小调整
+  constexpr std::size_t TABLE_SIZE = 1 << 25;
+  constexpr std::size_t LOOKUP_COUNT = 1 << 22;
+
+  std::mt19937_64 random(7);
+  std::vector<uint64_t> keys(LOOKUP_COUNT);
+  for (auto &key : keys) {
+    key = random() % TABLE_SIZE;
+  }
+  {
+    HashTable table(TABLE_SIZE);
+    benchmark("hash table", table, keys);
+  }
+  {
+    std::vector<uint64_t> tree_keys(TABLE_SIZE);
+    std::iota(tree_keys.begin(), tree_keys.end(), 0);
+    BPlusTree tree(tree_keys);
+    benchmark("b+ tree", tree, keys);
+  }
+  std::cout << "end run interleave" << std::endl;
+}
+
+} // namespace prefetch
+} // namespace co
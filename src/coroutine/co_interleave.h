@@ -0,0 +1,235 @@
+#pragma once
+
+#include <vector>
+#include <ranges>
+#include <cstddef>
+#include <utility>
+#include <optional>
+#include <coroutine>
+#include <exception>
+
+namespace co {
+namespace prefetch {
+
+/**
+ * 协程帧池，交错执行时每个查找都会创建一个协程帧，每次都走 operator new 的开销会抵消掉重叠 cache miss 的收益。
+ * 同一个查找函数的协程帧大小是固定的，因此按大小缓存释放掉的帧，留给下一个查找复用
+*/
+struct FramePool {
+  static void *allocate(std::size_t size) {
+    auto &pool = instance();
+    if (pool.frame_size == size && !pool.frames.empty()) {
+      auto frame = pool.frames.back();
+      pool.frames.pop_back();
+      return frame;
+    }
+    return ::operator new(size);
+  }
+
+  static void deallocate(void *frame, std::size_t size) {
+    auto &pool = instance();
+    if (pool.frame_size != size) {
+      // 换了一种查找函数，之前缓存的帧已经用不上了
+      pool.release();
+      pool.frame_size = size;
+    }
+    if (pool.frames.size() < MAX_CACHED_FRAMES) {
+      pool.frames.push_back(frame);
+    } else {
+      ::operator delete(frame);
+    }
+  }
+
+  ~FramePool() {
+    release();
+  }
+
+private:
+  static constexpr std::size_t MAX_CACHED_FRAMES = 1024;
+
+  static FramePool &instance() {
+    // 调度器是单线程的，每个线程一个池，不需要加锁
+    thread_local FramePool pool;
+    return pool;
+  }
+
+  void release() {
+    for (auto frame : frames) {
+      ::operator delete(frame);
+    }
+    frames.clear();
+  }
+
+  std::size_t frame_size = 0;
+  std::vector<void *> frames;
+};
+
+/**
+ * 查找协程发出 __builtin_prefetch 之后 co_await prefetch_yield{} 挂起自己，
+ * 调度器转去执行同组的其他查找，等再次轮到它时，数据大概率已经进入 cache
+*/
+struct prefetch_yield {
+  constexpr bool await_ready() const noexcept {
+    return false;
+  }
+
+  // 只是挂起，何时恢复由 interleave 决定
+  constexpr void await_suspend(std::coroutine_handle<>) const noexcept {}
+
+  constexpr void await_resume() const noexcept {}
+};
+
+/**
+ * 查找协程，一次查找对应一个实例，通过 co_return 返回查找结果
+*/
+template <typename R>
+struct Lookup {
+
+  struct promise_type {
+    R value{};
+    std::exception_ptr exception_ptr;
+
+    // 创建后挂起，由 interleave 或者 get 驱动执行
+    std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    // 执行结束后挂起，让 Lookup 来读取结果并销毁
+    std::suspend_always final_suspend() noexcept {
+      return {};
+    }
+
+    Lookup get_return_object() {
+      return Lookup{ std::coroutine_handle<promise_type>::from_promise(*this) };
+    }
+
+    void return_value(R result) {
+      value = std::move(result);
+    }
+
+    void unhandled_exception() {
+      exception_ptr = std::current_exception();
+    }
+
+    // 协程帧从 FramePool 中分配
+    static void *operator new(std::size_t size) {
+      return FramePool::allocate(size);
+    }
+
+    static void operator delete(void *frame, std::size_t size) {
+      FramePool::deallocate(frame, size);
+    }
+  };
+
+  std::coroutine_handle<promise_type> handle;
+
+  explicit Lookup(std::coroutine_handle<promise_type> handle) noexcept
+    : handle(handle) {}
+
+  // 与 Generator 一样，一个协程实例只对应一个 Lookup，只支持移动
+  Lookup(Lookup &&lookup) noexcept
+    : handle(std::exchange(lookup.handle, {})) {}
+
+  Lookup &operator=(Lookup &&lookup) noexcept {
+    if (this != &lookup) {
+      if (handle) {
+        handle.destroy();
+      }
+      handle = std::exchange(lookup.handle, {});
+    }
+    return *this;
+  }
+
+  Lookup(Lookup &) = delete;
+  Lookup &operator=(Lookup &) = delete;
+
+  ~Lookup() {
+    if (handle) {
+      handle.destroy();
+    }
+  }
+
+  // 推进到下一个挂起点，返回查找是否已经完成
+  bool step() {
+    handle.resume();
+    return handle.done();
+  }
+
+  // 读取结果，有异常则抛出异常，只能在查找完成后调用
+  R result() {
+    if (handle.promise().exception_ptr) {
+      std::rethrow_exception(handle.promise().exception_ptr);
+    }
+    return std::move(handle.promise().value);
+  }
+
+  // 不交错，直接执行到结束
+  R get() {
+    while (!step()) {}
+    return result();
+  }
+};
+
+/**
+ * 交错执行一批查找：保持 group_size 个查找同时在执行中，轮流 resume，
+ * 每个查找预取之后挂起，因此同一组查找的 DRAM miss 可以相互重叠。
+ * lookups 是一个惰性产生 Lookup<R> 的 range（例如 keys | std::views::transform(probe)），
+ * 只有空出位置时才会创建下一个查找；每个查找完成后以 (序号, 结果) 调用 on_result。
+ * 结果的回调顺序与 lookups 的顺序不一定相同
+*/
+template <typename Lookups, typename OnResult>
+void interleave(std::size_t group_size, Lookups &&lookups, OnResult &&on_result) {
+  using LookupType = std::ranges::range_value_t<Lookups>;
+
+  struct Slot {
+    std::optional<LookupType> lookup;
+    std::size_t index = 0;
+  };
+
+  auto it = std::ranges::begin(lookups);
+  auto end = std::ranges::end(lookups);
+  std::size_t next_index = 0;
+
+  if (group_size == 0) {
+    group_size = 1;
+  }
+  std::vector<Slot> slots(group_size);
+  std::size_t active = 0;
+
+  // 先填满一组
+  for (; active < group_size && it != end; ++it, ++active) {
+    slots[active].lookup.emplace(*it);
+    slots[active].index = next_index++;
+  }
+
+  while (active > 0) {
+    for (std::size_t i = 0; i < active;) {
+      auto &slot = slots[i];
+      if (!slot.lookup->step()) {
+        i++;
+        continue;
+      }
+
+      on_result(slot.index, slot.lookup->result());
+      if (it != end) {
+        // 用下一个查找替换已完成的查找，下一轮再开始执行
+        slot.lookup.emplace(*it);
+        slot.index = next_index++;
+        ++it;
+        i++;
+      } else {
+        // 没有更多的查找了，把最后一个活跃的查找挪到空位上，本轮继续执行它
+        active--;
+        if (i != active) {
+          slot = std::move(slots[active]);
+        }
+        slots[active].lookup.reset();
+      }
+    }
+  }
+}
+
+void Run();
+
+} // namespace prefetch
+} // namespace co
@@ -0,0 +1,473 @@
+#include <bit>
+#include <cmath>
+#include <atomic>
+#include <random>
+#include <iomanip>
+#include <utility>
+#include <iostream>
+#include <optional>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <unistd.h>
+#include "co_rpc.h"
+#include "co_load.h"
+#include "co_reactor.h"
+#include "co_parallel.h"
+
+namespace co {
+namespace load {
+
+namespace {
+
+// 每组线性划分的桶数为 2^SUB_BUCKET_BITS，小于 2^(SUB_BUCKET_BITS + 1) 的值每个值一个桶
+constexpr int SUB_BUCKET_BITS = 10;
+constexpr uint64_t SUB_BUCKET_HALF = uint64_t(1) << SUB_BUCKET_BITS;
+constexpr uint64_t SUB_BUCKET_COUNT = SUB_BUCKET_HALF * 2;
+
+} // namespace
+
+Histogram::Histogram() : counts(index_of(HIGHEST_TRACKABLE) + 1) {}
+
+std::size_t Histogram::index_of(uint64_t value) {
+  if (value < SUB_BUCKET_COUNT) {
+    return value;
+  }
+  // value >> shift 落在 [SUB_BUCKET_HALF, SUB_BUCKET_COUNT)，精度随数量级降低
+  auto shift = std::bit_width(value) - 1 - SUB_BUCKET_BITS;
+  return shift * SUB_BUCKET_HALF + (value >> shift);
+}
+
+uint64_t Histogram::highest_equivalent(std::size_t index) {
+  if (index < SUB_BUCKET_COUNT) {
+    return index;
+  }
+  auto shift = index / SUB_BUCKET_HALF - 1;
+  auto sub_bucket = index - shift * SUB_BUCKET_HALF;
+  return ((sub_bucket + 1) << shift) - 1;
+}
+
+void Histogram::record(uint64_t value, uint64_t count) {
+  value = std::min(value, HIGHEST_TRACKABLE);
+  counts[index_of(value)] += count;
+  total += count;
+  sum += value * count;
+  min_value = std::min(min_value, value);
+  max_value = std::max(max_value, value);
+}
+
+void Histogram::record_corrected(uint64_t value, uint64_t expected_interval) {
+  record(value);
+  if (expected_interval == 0 || value <= expected_interval) {
+    return;
+  }
+  for (auto missing = value - expected_interval; missing >= expected_interval; missing -= expected_interval) {
+    record(missing);
+  }
+}
+
+void Histogram::merge(const Histogram &other) {
+  for (std::size_t i = 0; i < counts.size(); i++) {
+    counts[i] += other.counts[i];
+  }
+  total += other.total;
+  sum += other.sum;
+  min_value = std::min(min_value, other.min_value);
+  max_value = std::max(max_value, other.max_value);
+}
+
+void Histogram::reset() {
+  std::fill(counts.begin(), counts.end(), 0);
+  total = 0;
+  sum = 0;
+  min_value = UINT64_MAX;
+  max_value = 0;
+}
+
+uint64_t Histogram::value_at_percentile(double percentile) const {
+  if (total == 0) {
+    return 0;
+  }
+  auto rank = static_cast<uint64_t>(std::ceil(std::clamp(percentile, 0.0, 100.0) / 100 * total));
+  rank = std::max<uint64_t>(rank, 1);
+  uint64_t seen = 0;
+  for (std::size_t i = 0; i < counts.size(); i++) {
+    seen += counts[i];
+    if (seen >= rank) {
+      return std::min(highest_equivalent(i), max_value);
+    }
+  }
+  return max_value;
+}
+
+namespace {
+
+void print_histogram(std::ostream &output, const char *name, const Histogram &histogram) {
+  output << "  " << name << " us: p50 " << histogram.value_at_percentile(50) / 1e3 << ", p90 "
+         << histogram.value_at_percentile(90) / 1e3 << ", p99 " << histogram.value_at_percentile(99) / 1e3
+         << ", p99.9 " << histogram.value_at_percentile(99.9) / 1e3 << ", max " << histogram.max() / 1e3 << ", mean "
+         << histogram.mean() / 1e3 << std::endl;
+}
+
+} // namespace
+
+void Report::print(std::ostream &output, const std::string &name) const {
+  auto flags = output.flags();
+  auto precision = output.precision();
+  auto seconds = std::chrono::duration<double>(elapsed).count();
+  output << std::fixed << std::setprecision(1);
+  output << name << ": issued " << issued << " (" << issued / seconds / 1e3 << " K/s), failed " << failed
+         << ", max send lag " << max_lag.count() / 1e3 << " us" << std::endl;
+  print_histogram(output, "latency     ", latency);
+  print_histogram(output, "service time", service_time);
+  output.flags(flags);
+  output.precision(precision);
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+uint64_t nanoseconds_between(Clock::time_point from, Clock::time_point to) {
+  return std::max<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count(), 0);
+}
+
+// 请求在不同的线程上完成，结果在锁内记录
+struct Recorder {
+  void record(Clock::time_point intended, Clock::time_point sent, bool succeeded) {
+    auto completed = Clock::now();
+    std::lock_guard lock(report_lock);
+    if (!succeeded) {
+      report.failed++;
+      return;
+    }
+    report.latency.record(nanoseconds_between(intended, completed));
+    report.service_time.record(nanoseconds_between(sent, completed));
+  }
+
+  std::mutex report_lock;
+  Report report;
+};
+
+// co_await SleepAwaiter 在 until 之后于事件循环上恢复
+struct SleepAwaiter {
+  bool await_ready() const {
+    return Clock::now() >= until;
+  }
+
+  void await_suspend(std::coroutine_handle<> handle) {
+    executor.execute_delayed([handle]() { handle.resume(); }, until - Clock::now());
+  }
+
+  void await_resume() const noexcept {}
+
+  executor::LooperExecutor &executor;
+  Clock::time_point until;
+};
+
+task::Task<void> generate(executor::LooperExecutor &executor, const Target &target, const Options &options,
+                          Recorder &recorder, parallel::TaskSet &outstanding) {
+  co_await executor::switch_to(executor);
+  std::mt19937_64 random(options.seed);
+  std::exponential_distribution<double> exponential(options.rate);
+  auto start = Clock::now();
+  auto end = start + options.duration;
+  // 计划时间用距离开始的秒数累加，避免每次取整造成的漂移
+  double offset = 0;
+  std::chrono::nanoseconds max_lag{ 0 };
+  uint64_t issued = 0;
+  while (true) {
+    auto intended = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(offset));
+    if (intended >= end) {
+      break;
+    }
+    if (Clock::now() < intended) {
+      co_await SleepAwaiter{ executor, intended };
+    }
+    // 醒来时如果已经落后，接下来到期的请求不再等待，连续补发
+    auto sent = Clock::now();
+    max_lag = std::max<std::chrono::nanoseconds>(max_lag, sent - intended);
+    outstanding.add(target(), [&recorder, intended, sent](auto result) {
+      auto succeeded = true;
+      try {
+        result.get_or_throw();
+      } catch (...) {
+        succeeded = false;
+      }
+      recorder.record(intended, sent, succeeded);
+    });
+    issued++;
+    offset += options.arrival == Arrival::CONSTANT ? 1 / options.rate : exponential(random);
+  }
+  // 还没有完成的请求全部完成之后再汇总
+  co_await outstanding.drain();
+  std::lock_guard lock(recorder.report_lock);
+  recorder.report.issued = issued;
+  recorder.report.max_lag = max_lag;
+  recorder.report.elapsed = Clock::now() - start;
+}
+
+task::Task<void> closed_loop(executor::LooperExecutor &executor, const Target &target,
+                             std::chrono::nanoseconds duration, std::chrono::nanoseconds expected_interval,
+                             Report &report) {
+  co_await executor::switch_to(executor);
+  auto start = Clock::now();
+  auto end = start + duration;
+  while (Clock::now() < end) {
+    auto sent = Clock::now();
+    auto succeeded = true;
+    try {
+      co_await target();
+    } catch (...) {
+      succeeded = false;
+    }
+    report.issued++;
+    if (!succeeded) {
+      report.failed++;
+      continue;
+    }
+    auto elapsed = nanoseconds_between(sent, Clock::now());
+    report.latency.record_corrected(elapsed, expected_interval.count());
+    report.service_time.record(elapsed);
+  }
+  report.elapsed = Clock::now() - start;
+}
+
+} // namespace
+
+Report run_open_loop(const Target &target, const Options &options) {
+  if (options.rate <= 0) {
+    throw std::invalid_argument("rate must be positive");
+  }
+  executor::LooperExecutor executor;
+  Recorder recorder;
+  parallel::TaskSet outstanding(executor);
+  generate(executor, target, options, recorder, outstanding).get_result();
+  executor.shutdown();
+  return std::move(recorder.report);
+}
+
+Report run_closed_loop(const Target &target, std::chrono::nanoseconds duration,
+                       std::chrono::nanoseconds expected_interval) {
+  executor::LooperExecutor executor;
+  Report report;
+  closed_loop(executor, target, duration, expected_interval, report).get_result();
+  executor.shutdown();
+  return report;
+}
+
+namespace {
+
+void spin_for(std::chrono::nanoseconds duration) {
+  auto until = Clock::now() + duration;
+  while (Clock::now() < until) {
+  }
+}
+
+/**
+ * 进程内的被测对象：单个事件循环线程依次处理请求，每个请求占用 service 的 CPU 时间，
+ * 每 stall_every 个请求停顿一次 stall（模拟 GC 或者磁盘抖动），停顿期间请求在队列中积压
+*/
+struct SimulatedService {
+  SimulatedService(std::chrono::nanoseconds service, uint64_t stall_every, std::chrono::nanoseconds stall)
+      : service(service), stall_every(stall_every), stall(stall) {}
+
+  ~SimulatedService() {
+    executor.shutdown();
+  }
+
+  task::Task<void> handle() {
+    co_await executor::switch_to(executor);
+    auto served = ++requests;
+    spin_for(stall_every && served % stall_every == 0 ? stall : service);
+  }
+
+  executor::LooperExecutor executor;
+  std::chrono::nanoseconds service;
+  uint64_t stall_every;
+  std::chrono::nanoseconds stall;
+  std::atomic<uint64_t> requests{ 0 };
+};
+
+constexpr uint32_t ECHO = 1;
+
+task::Task<rpc::Bytes> echo(rpc::Bytes request) {
+  co_return request;
+}
+
+// 通过回环连接访问的 RPC 服务，服务端和客户端在同一个进程里，各自一个事件循环线程
+struct RpcService {
+  explicit RpcService(bool unix_socket) : server(reactor, server_executor) {
+    server.handle(ECHO, echo);
+    if (unix_socket) {
+      path = "/tmp/co_load_" + std::to_string(::getpid()) + ".sock";
+      listen_fd = rpc::listen_unix(path);
+    } else {
+      listen_fd = rpc::listen_tcp();
+    }
+    serving.emplace(server.accept(listen_fd, 1));
+    client.emplace(reactor, client_executor,
+                   unix_socket ? rpc::connect_unix(path) : rpc::connect_tcp(rpc::local_port(listen_fd)));
+  }
+
+  ~RpcService() {
+    client->close().get_result();
+    serving->get_result();
+    client.reset();
+    server_executor.shutdown();
+    client_executor.shutdown();
+    ::close(listen_fd);
+    if (!path.empty()) {
+      ::unlink(path.c_str());
+    }
+  }
+
+  task::Task<void> call() {
+    auto response = co_await client->call(ECHO, payload);
+    if (response.size() != payload.size()) {
+      throw rpc::RpcError("echo mismatch");
+    }
+  }
+
+  reactor::Reactor reactor;
+  executor::LooperExecutor server_executor;
+  executor::LooperExecutor client_executor;
+  rpc::Server server;
+  std::string path;
+  int listen_fd = -1;
+  std::optional<task::Task<void>> serving;
+  std::optional<rpc::Client> client;
+  rpc::Bytes payload = rpc::Bytes(64, 'x');
+};
+
+struct CommandLine {
+  std::string target = "inproc";
+  Options options;
+  std::chrono::nanoseconds service = std::chrono::microseconds(20);
+  uint64_t stall_every = 0;
+  std::chrono::nanoseconds stall{ 0 };
+  bool compare_closed = false;
+};
+
+void print_usage() {
+  std::cerr << "usage: main load [--target=inproc|tcp|unix] [--rate=REQUESTS_PER_SECOND] [--duration=SECONDS]\n"
+               "                 [--arrival=constant|poisson] [--seed=N] [--service-us=N] [--stall-every=N]\n"
+               "                 [--stall-ms=N] [--compare-closed]\n"
+               "  --service-us, --stall-every and --stall-ms configure the inproc target;\n"
+               "  --compare-closed also runs a closed-loop measurement of the same target"
+            << std::endl;
+}
+
+std::chrono::nanoseconds seconds_to_nanoseconds(double seconds) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(seconds));
+}
+
+double parse_number(const std::string &arg, const std::string &value) {
+  std::size_t parsed = 0;
+  double number = 0;
+  try {
+    number = std::stod(value, &parsed);
+  } catch (std::exception &) {
+  }
+  if (parsed == 0 || parsed != value.size() || number < 0) {
+    throw std::invalid_argument("invalid value in " + arg);
+  }
+  return number;
+}
+
+// 参数错误时抛出 std::invalid_argument
+CommandLine parse(const std::vector<std::string> &args) {
+  CommandLine command;
+  for (auto &arg : args) {
+    if (arg == "--compare-closed") {
+      command.compare_closed = true;
+      continue;
+    }
+    auto equal = arg.find('=');
+    if (arg.rfind("--", 0) != 0 || equal == std::string::npos) {
+      throw std::invalid_argument("unknown argument " + arg);
+    }
+    auto name = arg.substr(2, equal - 2);
+    auto value = arg.substr(equal + 1);
+    if (name == "target") {
+      if (value != "inproc" && value != "tcp" && value != "unix") {
+        throw std::invalid_argument("unknown target " + value);
+      }
+      command.target = value;
+    } else if (name == "arrival") {
+      if (value != "constant" && value != "poisson") {
+        throw std::invalid_argument("unknown arrival " + value);
+      }
+      command.options.arrival = value == "constant" ? Arrival::CONSTANT : Arrival::POISSON;
+    } else if (name == "rate") {
+      command.options.rate = parse_number(arg, value);
+    } else if (name == "duration") {
+      command.options.duration = seconds_to_nanoseconds(parse_number(arg, value));
+    } else if (name == "seed") {
+      command.options.seed = static_cast<uint64_t>(parse_number(arg, value));
+    } else if (name == "service-us") {
+      command.service = seconds_to_nanoseconds(parse_number(arg, value) / 1e6);
+    } else if (name == "stall-every") {
+      command.stall_every = static_cast<uint64_t>(parse_number(arg, value));
+    } else if (name == "stall-ms") {
+      command.stall = seconds_to_nanoseconds(parse_number(arg, value) / 1e3);
+    } else {
+      throw std::invalid_argument("unknown argument " + arg);
+    }
+  }
+  if (command.options.rate <= 0 || command.options.duration.count() <= 0) {
+    throw std::invalid_argument("rate and duration must be positive");
+  }
+  return command;
+}
+
+void run_command(const CommandLine &command) {
+  auto interval = seconds_to_nanoseconds(1 / command.options.rate);
+  auto name = command.target + (command.options.arrival == Arrival::CONSTANT ? ", constant " : ", poisson ") +
+              std::to_string(static_cast<uint64_t>(command.options.rate)) + "/s";
+  auto measure = [&](const Target &target) {
+    run_open_loop(target, command.options).print(std::cout, name + ", open loop");
+    if (command.compare_closed) {
+      auto closed = run_closed_loop(target, command.options.duration);
+      closed.print(std::cout, command.target + ", closed loop");
+      closed = run_closed_loop(target, command.options.duration, interval);
+      closed.print(std::cout, command.target + ", closed loop corrected");
+    }
+  };
+  if (command.target == "inproc") {
+    SimulatedService service(command.service, command.stall_every, command.stall);
+    measure([&service]() { return service.handle(); });
+  } else {
+    RpcService service(command.target == "unix");
+    measure([&service]() { return service.call(); });
+  }
+}
+
+} // namespace
+
+int Main(const std::vector<std::string> &args) {
+  CommandLine command;
+  try {
+    command = parse(args);
+  } catch (std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    print_usage();
+    return 2;
+  }
+  run_command(command);
+  return 0;
+}
+
+void Run() {
+  std::cout << "start run load" << std::endl;
+  std::cout << "hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+  // 服务每 5000 个请求停顿 50ms：开环测量能看到停顿造成的积压，闭环测量只看到一个慢请求
+  run_command(parse({ "--target=inproc", "--arrival=constant", "--rate=10000", "--duration=2", "--service-us=20",
+                      "--stall-every=5000", "--stall-ms=50", "--compare-closed" }));
+  run_command(parse({ "--target=tcp", "--rate=20000", "--duration=2" }));
+  run_command(parse({ "--target=unix", "--rate=20000", "--duration=2" }));
+  std::cout << "end run load" << std::endl;
+}
+
+} // namespace load
+} // namespace co
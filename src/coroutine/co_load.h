@@ -0,0 +1,129 @@
+#pragma once
+
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <coroutine>
+#include <functional>
+#include "co_task.h"
+#include "co_executor.h"
+
+namespace co {
+namespace load {
+
+/**
+ * HDR 风格的直方图：值按最高位分组，每组再线性分成 1024 个桶，
+ * 任何值的相对误差都不超过 1/1024，内存大小固定，与记录的次数无关。
+ * 用于记录纳秒级的延迟，超过 HIGHEST_TRACKABLE 的值按 HIGHEST_TRACKABLE 记录
+*/
+struct Histogram {
+  static constexpr uint64_t HIGHEST_TRACKABLE = (uint64_t(1) << 40) - 1;
+
+  Histogram();
+
+  void record(uint64_t value, uint64_t count = 1);
+
+  /**
+   * 闭环测量时的协调遗漏修正：value 超过期望的发送间隔时，
+   * 补记那些本应在等待期间发出的请求会观察到的延迟（value - interval, value - 2 * interval, ...）
+  */
+  void record_corrected(uint64_t value, uint64_t expected_interval);
+
+  void merge(const Histogram &other);
+
+  void reset();
+
+  uint64_t count() const {
+    return total;
+  }
+
+  uint64_t min() const {
+    return total ? min_value : 0;
+  }
+
+  uint64_t max() const {
+    return max_value;
+  }
+
+  double mean() const {
+    return total ? static_cast<double>(sum) / total : 0;
+  }
+
+  // 不小于 percentile% 的记录值的最小值（取所在桶的上界），percentile 取值 [0, 100]
+  uint64_t value_at_percentile(double percentile) const;
+
+private:
+  static std::size_t index_of(uint64_t value);
+
+  // 与第 index 个桶中的值等价的最大值
+  static uint64_t highest_equivalent(std::size_t index);
+
+  std::vector<uint64_t> counts;
+  uint64_t total = 0;
+  uint64_t sum = 0;
+  uint64_t min_value = UINT64_MAX;
+  uint64_t max_value = 0;
+};
+
+enum class Arrival {
+  // 固定间隔
+  CONSTANT,
+  // 泊松过程，间隔服从指数分布
+  POISSON,
+};
+
+struct Options {
+  // 每秒请求数
+  double rate = 10'000;
+  std::chrono::nanoseconds duration = std::chrono::seconds(2);
+  Arrival arrival = Arrival::POISSON;
+  uint64_t seed = 1;
+};
+
+struct Report {
+  // 从计划发送时间到完成的延迟，包含请求因为发送方落后而推迟的时间；失败的请求只计数，不记录延迟
+  Histogram latency;
+  // 从实际发送到完成的时间，即忽略了协调遗漏的测量
+  Histogram service_time;
+  uint64_t issued = 0;
+  uint64_t failed = 0;
+  std::chrono::nanoseconds elapsed{ 0 };
+  // 实际发送时间最多比计划晚多少，过大说明压测端本身跟不上
+  std::chrono::nanoseconds max_lag{ 0 };
+
+  void print(std::ostream &output, const std::string &name) const;
+};
+
+// 发出一个请求，返回的 Task 完成即请求完成，抛出异常算作失败
+using Target = std::function<task::Task<void>()>;
+
+/**
+ * 开环压测：按 options 给出的时间表发送请求，不等待之前的请求完成，
+ * 延迟从计划发送时间开始计算，被测对象变慢时排队的时间也会计入，不会出现协调遗漏。
+ * 时间表在一个事件循环线程上执行，每次醒来补发所有已经到期的请求。
+ * 发送结束之后等所有请求完成再返回
+*/
+Report run_open_loop(const Target &target, const Options &options);
+
+/**
+ * 闭环压测（对照）：收到上一个响应之后才发下一个请求，持续 duration。
+ * 被测对象停顿期间不会发出请求，latency 直接记录每个请求的耗时，会低估尾延迟；
+ * expected_interval 大于 0 时用 record_corrected 修正
+*/
+Report run_closed_loop(const Target &target, std::chrono::nanoseconds duration,
+                       std::chrono::nanoseconds expected_interval = std::chrono::nanoseconds(0));
+
+/**
+ * 命令行入口，参数形如 --target=inproc --rate=20000 --duration=2 --arrival=poisson，
+ * 参数错误时打印用法并返回非 0
+*/
+int Main(const std::vector<std::string> &args);
+
+void Run();
+
+} // namespace load
+} // namespace co
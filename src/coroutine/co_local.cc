@@ -0,0 +1,149 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <stdexcept>
+#include "co_task.h"
+#include "co_executor.h"
+#include "co_local.h"
+
+namespace co {
+namespace local {
+
+std::size_t allocate_slot() {
+  static std::atomic<std::size_t> next_slot{ 0 };
+  auto index = next_slot.fetch_add(1, std::memory_order_relaxed);
+  if (index >= MAX_SLOTS) {
+    throw std::length_error("too many task local slots");
+  }
+  return index;
+}
+
+Values &writable_values() {
+  auto storage = Storage::current;
+  if (!storage) {
+    throw std::logic_error("task local value set outside a task");
+  }
+  if (!storage->values) {
+    storage->values = std::make_shared<Values>();
+  } else if (storage->values.use_count() != 1) {
+    // 子协程可能还在其他线程上读取，复制一份再修改
+    storage->values = std::make_shared<Values>(*storage->values);
+  } else {
+    // 引用计数在其他线程上减到 1，之前它们对 Values 的读取都要先于这里的修改
+    std::atomic_thread_fence(std::memory_order_acquire);
+  }
+  return *storage->values;
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int HOPS = 4;
+constexpr int REQUESTS = 8;
+constexpr int READS = 20'000'000;
+
+Slot<uint64_t> trace_id;
+Slot<int> tenant;
+
+thread_local uint64_t thread_trace_id = 0;
+
+/**
+ * 每一跳都切换到线程池上的某个线程，再检查读到的 trace_id 是否还是请求开始时设置的值
+*/
+task::Task<int> hop(executor::AbstractExecutor &executor, uint64_t expected, int depth) {
+  int mismatches = 0;
+  co_await executor::switch_to(executor);
+  if (trace_id.get_or(0) != expected) {
+    mismatches++;
+  }
+  if (depth > 0) {
+    mismatches += co_await hop(executor, expected, depth - 1);
+  }
+  if (trace_id.get_or(0) != expected) {
+    mismatches++;
+  }
+  co_return mismatches;
+}
+
+// 子协程覆盖的值只在子协程内部可见
+task::Task<int> override_tenant(executor::AbstractExecutor &executor) {
+  tenant.set(-1);
+  co_await executor::switch_to(executor);
+  co_return tenant.get_or(0);
+}
+
+task::Task<int> request(executor::AbstractExecutor &executor, uint64_t id) {
+  trace_id.set(id);
+  tenant.set(static_cast<int>(id % 3));
+  auto mismatches = co_await hop(executor, id, HOPS);
+  auto inner_tenant = co_await override_tenant(executor);
+  if (inner_tenant != -1 || tenant.get_or(0) != static_cast<int>(id % 3)) {
+    mismatches++;
+  }
+  co_return mismatches;
+}
+
+// 对照：直接读 thread_local 变量，noipa 保证每次都真正调用
+__attribute__((noipa)) uint64_t read_thread_local() {
+  return thread_trace_id;
+}
+
+__attribute__((noipa)) uint64_t read_task_local() {
+  return trace_id.get_or(0);
+}
+
+task::Task<uint64_t> read_slot_noinline(int reads) {
+  trace_id.set(1);
+  uint64_t sum = 0;
+  for (int i = 0; i < reads; i++) {
+    sum += read_task_local();
+  }
+  co_return sum;
+}
+
+uint64_t read_tls(int reads) {
+  thread_trace_id = 1;
+  uint64_t sum = 0;
+  for (int i = 0; i < reads; i++) {
+    sum += read_thread_local();
+  }
+  return sum;
+}
+
+double ns_per_read(Clock::time_point start, uint64_t sum) {
+  auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+  return sum == READS ? elapsed / READS : -1;
+}
+
+} // namespace
+
+void Run() {
+  std::cout << "start run local" << std::endl;
+  {
+    executor::ThreadPoolExecutor executor(4);
+    std::vector<task::Task<int>> requests;
+    for (int i = 1; i <= REQUESTS; i++) {
+      requests.push_back(request(executor, 1000 + i));
+    }
+    int mismatches = 0;
+    for (auto &task : requests) {
+      mismatches += task.get_result();
+    }
+    std::cout << REQUESTS << " concurrent requests, " << HOPS + 1 << " hops each across 4 workers, mismatches: "
+              << mismatches << ", outside any task: " << (trace_id.get() ? "set" : "unset") << std::endl;
+  }
+
+  auto start = Clock::now();
+  auto tls = ns_per_read(start, read_tls(READS));
+  start = Clock::now();
+  auto slot = read_slot_noinline(READS);
+  auto task_local = ns_per_read(start, slot.get_result());
+  std::cout << "thread_local read: " << tls << " ns, task local read: " << task_local << " ns" << std::endl;
+  std::cout << "end run local" << std::endl;
+}
+
+} // namespace local
+} // namespace co
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <type_traits>
+
+namespace co {
+namespace local {
+
+// 槽位的最大数量，每个 Slot 对象占用一个
+constexpr std::size_t MAX_SLOTS = 16;
+
+// 一组槽位的值，present 的第 i 位表示第 i 个槽位是否有值
+struct Values {
+  uint64_t slots[MAX_SLOTS]{};
+  uint32_t present = 0;
+};
+
+/**
+ * 每个 TaskPromise 持有一个 Storage：创建时引用创建它的协程的 Values，
+ * 子协程因此看到父协程的值；修改时如果 Values 还被其他协程引用则先复制一份，
+ * 子协程的修改不会影响父协程和兄弟协程。
+ * 协程每次开始或恢复执行时把自己的 Storage 设为当前线程的 current，
+ * 挂起或结束时恢复为之前的值，协程在线程之间迁移也能读到自己的值
+*/
+struct Storage {
+  Storage() : values(current ? current->values : nullptr) {}
+
+  Storage(Storage &) = delete;
+  Storage &operator=(Storage &) = delete;
+
+  void enter() {
+    previous = current;
+    current = this;
+  }
+
+  void leave() {
+    current = previous;
+  }
+
+  // 当前线程上正在执行的协程的 Storage，不在协程中时为空
+  static inline thread_local Storage *current = nullptr;
+
+  std::shared_ptr<Values> values;
+
+private:
+  // 恢复这个协程之前的 current，挂起时还原
+  Storage *previous = nullptr;
+};
+
+// 分配一个槽位，超过 MAX_SLOTS 时抛出 std::length_error
+std::size_t allocate_slot();
+
+// 当前协程可以修改的 Values，必要时复制；不在协程中时抛出 std::logic_error
+Values &writable_values();
+
+/**
+ * 协程局部变量，通常定义为全局对象，例如 inline local::Slot<uint64_t> trace_id;
+ * 值直接存放在 64 位的槽位里，因此只支持不超过 8 字节的可平凡复制类型，
+ * 更大的对象存放指针。读取只需要一次 TLS 访问和两次指针访问
+*/
+template <typename T>
+struct Slot {
+  static_assert(std::is_trivially_copyable_v<T> && sizeof(T) <= sizeof(uint64_t),
+                "task local value must be a trivially copyable type of at most 8 bytes");
+
+  Slot() : index(allocate_slot()) {}
+
+  Slot(Slot &) = delete;
+  Slot &operator=(Slot &) = delete;
+
+  // 当前协程中的值，没有设置过或者不在协程中时为空
+  std::optional<T> get() const {
+    auto storage = Storage::current;
+    if (!storage || !storage->values || !(storage->values->present & (uint32_t(1) << index))) {
+      return std::nullopt;
+    }
+    std::array<std::byte, sizeof(T)> bytes;
+    std::memcpy(bytes.data(), &storage->values->slots[index], sizeof(T));
+    return std::bit_cast<T>(bytes);
+  }
+
+  T get_or(T fallback) const {
+    return get().value_or(fallback);
+  }
+
+  // 只影响当前协程和之后由它创建的协程
+  void set(T value) const {
+    auto &values = writable_values();
+    values.slots[index] = 0;
+    std::memcpy(&values.slots[index], &value, sizeof(T));
+    values.present |= uint32_t(1) << index;
+  }
+
+  void reset() const {
+    if (get()) {
+      writable_values().present &= ~(uint32_t(1) << index);
+    }
+  }
+
+  const std::size_t index;
+};
+
+void Run();
+
+} // namespace local
+} // namespace co
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <iostream>
+
+// 协程内部的执行轨迹日志，默认关闭，避免压测时输出大量日志；需要观察执行过程时打开 CO_ENABLE_LOG
+#ifdef CO_ENABLE_LOG
+#define CO_LOG(message) (std::cout << message << std::endl)
+#else
+#define CO_LOG(message) ((void) 0)
+#endif
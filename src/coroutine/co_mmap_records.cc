@@ -0,0 +1,174 @@
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <unistd.h>
+#include <iostream>
+#include <stdexcept>
+#include <filesystem>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string_view>
+#include <system_error>
+#include "co_mmap_records.h"
+
+namespace co {
+namespace records {
+
+MappedFile::MappedFile(const std::string &path) {
+  auto fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "open " + path);
+  }
+  struct stat stat;
+  if (::fstat(fd, &stat) != 0) {
+    auto error = errno;
+    ::close(fd);
+    throw std::system_error(error, std::generic_category(), "fstat " + path);
+  }
+  size = stat.st_size;
+  // 空文件不能映射
+  if (size > 0) {
+    address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  auto error = errno;
+  // 映射建立之后就不再需要文件描述符了
+  ::close(fd);
+  if (address == MAP_FAILED) {
+    address = nullptr;
+    throw std::system_error(error, std::generic_category(), "mmap " + path);
+  }
+  if (address) {
+    ::madvise(address, size, MADV_SEQUENTIAL);
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (address) {
+    ::munmap(address, size);
+  }
+}
+
+void MappedFile::will_need(std::size_t offset, std::size_t length) const {
+  if (address && length > 0) {
+    ::madvise(static_cast<char *>(address) + offset, length, MADV_WILLNEED);
+  }
+}
+
+generator::Generator<std::span<const std::byte>> mmap_length_prefixed_records(std::string path, std::size_t read_ahead) {
+  MappedFile file(path);
+  ReadAhead window(file, read_ahead);
+  auto bytes = file.bytes();
+  std::size_t offset = 0;
+  while (offset < bytes.size()) {
+    window.advance(offset);
+    uint32_t length;
+    if (bytes.size() - offset < sizeof(length)) {
+      throw std::runtime_error("truncated record header at offset " + std::to_string(offset));
+    }
+    std::memcpy(&length, bytes.data() + offset, sizeof(length));
+    offset += sizeof(length);
+    if (bytes.size() - offset < length) {
+      throw std::runtime_error("truncated record at offset " + std::to_string(offset));
+    }
+    co_yield bytes.subspan(offset, length);
+    offset += length;
+  }
+}
+
+struct Record {
+  uint64_t id;
+  uint64_t timestamp;
+  double value;
+  uint32_t tag;
+  uint32_t flags;
+};
+
+template <typename Func>
+void benchmark(const char *name, std::size_t file_size, Func &&func) {
+  auto start = std::chrono::steady_clock::now();
+  auto checksum = func();
+  auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << name << ": " << file_size / seconds / (1 << 30) << " GB/s, checksum " << checksum << std::endl;
+}
+
+void Run() {
+  std::cout << "start run mmap records" << std::endl;
+  constexpr std::size_t RECORD_COUNT = 8 << 20;
+  auto path = (std::filesystem::temp_directory_path() / "co_mmap_records.bin").string();
+  {
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+    for (uint64_t i = 0; i < RECORD_COUNT; i++) {
+      Record record{ i, i * 1000, i * 0.5, static_cast<uint32_t>(i % 7), 0 };
+      output.write(reinterpret_cast<const char *>(&record), sizeof(record));
+    }
+  }
+  auto file_size = RECORD_COUNT * sizeof(Record);
+
+  // 文件刚写完，已经在 page cache 中，这里比较的是拷贝和遍历的开销
+  benchmark("ifstream per record", file_size, [&]() {
+    std::ifstream input(path, std::ios::binary);
+    Record record;
+    double sum = 0;
+    while (input.read(reinterpret_cast<char *>(&record), sizeof(record))) {
+      sum += record.value;
+    }
+    return sum;
+  });
+
+  benchmark("ifstream 1MB buffer", file_size, [&]() {
+    std::ifstream input(path, std::ios::binary);
+    std::vector<Record> buffer((1 << 20) / sizeof(Record));
+    double sum = 0;
+    while (input.read(reinterpret_cast<char *>(buffer.data()), buffer.size() * sizeof(Record)) || input.gcount() > 0) {
+      auto count = input.gcount() / sizeof(Record);
+      for (std::size_t i = 0; i < count; i++) {
+        sum += buffer[i].value;
+      }
+    }
+    return sum;
+  });
+
+  benchmark("mmap_records", file_size, [&]() {
+    double sum = 0;
+    for (const Record &record : mmap_records<Record>(path)) {
+      sum += record.value;
+    }
+    return sum;
+  });
+
+  benchmark("mmap_record_batches", file_size, [&]() {
+    double sum = 0;
+    for (auto batch : mmap_record_batches<Record>(path)) {
+      for (const auto &record : batch) {
+        sum += record.value;
+      }
+    }
+    return sum;
+  });
+
+  std::filesystem::remove(path);
+
+  // 变长记录
+  {
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+    for (uint32_t i = 0; i < 5; i++) {
+      std::string record = "record " + std::to_string(i);
+      uint32_t length = record.size();
+      output.write(reinterpret_cast<const char *>(&length), sizeof(length));
+      output.write(record.data(), record.size());
+    }
+  }
+  for (auto record : mmap_length_prefixed_records(path)) {
+    std::cout << std::string_view(reinterpret_cast<const char *>(record.data()), record.size()) << std::endl;
+  }
+  std::filesystem::remove(path);
+  std::cout << "end run mmap records" << std::endl;
+}
+
+} // namespace records
+} // namespace co
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <cstddef>
+#include <algorithm>
+#include <type_traits>
+#include "co_generator.h"
+
+namespace co {
+namespace records {
+
+// 默认的预读窗口，需要是页大小的整数倍
+constexpr std::size_t DEFAULT_READ_AHEAD = 8 << 20;
+
+/**
+ * 只读映射整个文件，映射后即调用 madvise(MADV_SEQUENTIAL)，打开或映射失败时抛出 std::system_error
+*/
+struct MappedFile {
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+
+  MappedFile(MappedFile &) = delete;
+  MappedFile &operator=(MappedFile &) = delete;
+
+  std::span<const std::byte> bytes() const {
+    return { static_cast<const std::byte *>(address), size };
+  }
+
+  // 通知内核异步预读 [offset, offset + length)
+  void will_need(std::size_t offset, std::size_t length) const;
+
+private:
+  void *address = nullptr;
+  std::size_t size = 0;
+};
+
+/**
+ * 随着遍历推进预读窗口：读取位置进入已预读区域的最后一个窗口时，对下一个窗口发起 MADV_WILLNEED，
+ * 保证内核总是领先读取位置一到两个窗口
+*/
+struct ReadAhead {
+  ReadAhead(const MappedFile &file, std::size_t window)
+    : file(file), window(std::max<std::size_t>(window, 4096) & ~std::size_t(4095)) {
+    advance(0);
+  }
+
+  void advance(std::size_t position) {
+    if (position + window < next_offset) {
+      return;
+    }
+    auto size = file.bytes().size();
+    while (next_offset < size && next_offset <= position + window) {
+      file.will_need(next_offset, std::min(window, size - next_offset));
+      next_offset += window;
+    }
+  }
+
+private:
+  const MappedFile &file;
+  std::size_t window;
+  std::size_t next_offset = 0;
+};
+
+/**
+ * 遍历定长记录文件，逐条产出映射内存中的 const T &，不做任何拷贝；
+ * 文件末尾不足一条的部分会被忽略
+*/
+template <typename T>
+generator::Generator<const T &> mmap_records(std::string path, std::size_t read_ahead = DEFAULT_READ_AHEAD) {
+  static_assert(std::is_trivially_copyable_v<T>, "records must be trivially copyable");
+  MappedFile file(path);
+  ReadAhead window(file, read_ahead);
+  auto bytes = file.bytes();
+  auto records = reinterpret_cast<const T *>(bytes.data());
+  auto count = bytes.size() / sizeof(T);
+  for (std::size_t i = 0; i < count; i++) {
+    window.advance(i * sizeof(T));
+    co_yield records[i];
+  }
+}
+
+/**
+ * 与 mmap_records 相同，但一次产出最多 batch_size 条连续记录
+*/
+template <typename T>
+generator::BatchGenerator<T> mmap_record_batches(std::string path, std::size_t batch_size = 1024,
+                                                 std::size_t read_ahead = DEFAULT_READ_AHEAD) {
+  static_assert(std::is_trivially_copyable_v<T>, "records must be trivially copyable");
+  MappedFile file(path);
+  ReadAhead window(file, read_ahead);
+  auto bytes = file.bytes();
+  auto records = reinterpret_cast<const T *>(bytes.data());
+  auto count = bytes.size() / sizeof(T);
+  for (std::size_t i = 0; i < count; i += batch_size) {
+    window.advance(i * sizeof(T));
+    co_yield std::span<const T>(records + i, std::min(batch_size, count - i));
+  }
+}
+
+/**
+ * 遍历以 4 字节长度前缀分隔的变长记录（与 group_commit::AppendLog 写出的格式相同），
+ * 产出指向映射内存的记录内容，记录被截断时抛出 std::runtime_error
+*/
+generator::Generator<std::span<const std::byte>> mmap_length_prefixed_records(
+    std::string path, std::size_t read_ahead = DEFAULT_READ_AHEAD);
+
+void Run();
+
+} // namespace records
+} // namespace co
@@ -0,0 +1,88 @@
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include "co_query.h"
+#include "co_morsel.h"
+
+namespace co {
+namespace morsel {
+
+using query::Batch;
+using query::Table;
+using query::Compare;
+using query::Operation;
+using query::Aggregation;
+
+/**
+ * 数据倾斜的表：前 1/4 的行全部满足过滤条件，之后的行全部被过滤掉，
+ * 按行号均分给各个 worker 时，第一个 worker 的工作量远大于其他 worker
+*/
+Table make_skewed_table(std::size_t row_count) {
+  Table table;
+  table.columns.assign(3, std::vector<int64_t>(row_count));
+  uint64_t state = 88172645463325252ULL;
+  for (std::size_t i = 0; i < row_count; i++) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    table.columns[0][i] = state % 1000;
+    table.columns[1][i] = state % 10000 + 1;
+    table.columns[2][i] = i < row_count / 4 ? 1 : 50;
+  }
+  return table;
+}
+
+// 每个 worker 的局部状态：部分聚合结果以及处理过的行数
+struct PartialAggregate {
+  Aggregation aggregation;
+  std::size_t rows = 0;
+  std::size_t morsels = 0;
+};
+
+void Run() {
+  std::cout << "start run morsel" << std::endl;
+  constexpr std::size_t ROW_COUNT = 100'000'000;
+  auto table = make_skewed_table(ROW_COUNT);
+
+  // SELECT key, COUNT(*), SUM(price * quantity) FROM table WHERE quantity < 25 GROUP BY key
+  auto pipeline = [&table](Morsel morsel, PartialAggregate &local) {
+    auto stream = query::project(
+      query::filter(query::scan(table, { 0, 1, 2 }, morsel.begin, morsel.end), { 2, Compare::Less, 25 }),
+      { { Operation::Column, 0 }, { Operation::Multiply, 1, 2 } });
+    for (const Batch &batch : stream) {
+      local.aggregation.consume(batch, 0, 1);
+    }
+    local.rows += morsel.end - morsel.begin;
+    local.morsels++;
+  };
+
+  std::cout << "hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+  for (std::size_t worker_count : { 1, 2, 4, 8 }) {
+    executor::ThreadPoolExecutor executor(worker_count);
+    MorselQueue morsels(ROW_COUNT);
+    std::vector<std::size_t> worker_rows;
+    auto start = std::chrono::steady_clock::now();
+    auto result = run_pipeline<PartialAggregate>(executor, worker_count, morsels, pipeline,
+                                                 [&worker_rows](PartialAggregate &result, PartialAggregate &&local) {
+                                                   result.aggregation.merge(local.aggregation);
+                                                   worker_rows.push_back(local.rows);
+                                                 }).get_result();
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int64_t checksum = 0;
+    for (const Batch &batch : result.aggregation.results()) {
+      batch.for_each_selected([&](std::size_t i) { checksum += batch.columns[1][i] + batch.columns[2][i]; });
+    }
+    std::cout << worker_count << " workers: " << seconds * 1000 << " ms, " << ROW_COUNT / seconds / 1e6
+              << " M rows/s, groups " << result.aggregation.group_count() << ", checksum " << checksum
+              << ", rows per worker";
+    for (auto rows : worker_rows) {
+      std::cout << " " << rows;
+    }
+    std::cout << std::endl;
+  }
+  std::cout << "end run morsel" << std::endl;
+}
+
+} // namespace morsel
+} // namespace co
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <utility>
+#include <optional>
+#include <algorithm>
+#include "co_task.h"
+#include "co_executor.h"
+
+namespace co {
+namespace morsel {
+
+// 每个 morsel 的默认行数
+constexpr std::size_t MORSEL_SIZE = 100'000;
+
+// 输入中 [begin, end) 范围内的行
+struct Morsel {
+  std::size_t begin;
+  std::size_t end;
+};
+
+/**
+ * 把 row_count 行切分成 morsel，多个 worker 共享同一个游标，谁空闲谁领取下一个，
+ * 处理得慢的 worker 自然领得少，不需要事先按数据分布划分
+*/
+struct MorselQueue {
+  explicit MorselQueue(std::size_t row_count, std::size_t morsel_size = MORSEL_SIZE)
+      : row_count(row_count), morsel_size(std::max<std::size_t>(morsel_size, 1)) {}
+
+  MorselQueue(MorselQueue &) = delete;
+  MorselQueue &operator=(MorselQueue &) = delete;
+
+  // 领取下一个 morsel，全部领完之后返回空
+  std::optional<Morsel> next() {
+    auto begin = cursor.fetch_add(morsel_size, std::memory_order_relaxed);
+    if (begin >= row_count) {
+      return std::nullopt;
+    }
+    return Morsel{ begin, std::min(begin + morsel_size, row_count) };
+  }
+
+private:
+  std::size_t row_count;
+  std::size_t morsel_size;
+  std::atomic<std::size_t> cursor{ 0 };
+};
+
+/**
+ * 一个 worker：先切换到 executor 上，然后不断领取 morsel，
+ * 每个 morsel 都在本线程上把整条融合的流水线 pipeline(morsel, local) 跑完，
+ * 结果累积在 worker 自己的局部状态 local 中，不需要任何同步
+*/
+template <typename Local, typename Pipeline>
+task::Task<Local> morsel_worker(executor::AbstractExecutor &executor, MorselQueue &morsels, Pipeline &pipeline) {
+  co_await executor::switch_to(executor);
+  Local local{};
+  while (auto morsel = morsels.next()) {
+    pipeline(*morsel, local);
+  }
+  co_return local;
+}
+
+/**
+ * 在 executor 上启动 worker_count 个 worker 并行执行流水线，
+ * 流水线在 pipeline breaker 处结束：等待所有 worker 完成，再用 merge(result, local) 合并局部结果。
+ * 返回的 Task 完成之前 morsels 和 pipeline 必须保持有效
+*/
+template <typename Local, typename Pipeline, typename Merge>
+task::Task<Local> run_pipeline(executor::AbstractExecutor &executor, std::size_t worker_count, MorselQueue &morsels,
+                               Pipeline &pipeline, Merge merge) {
+  std::vector<task::Task<Local>> workers;
+  for (std::size_t i = 0; i < std::max<std::size_t>(worker_count, 1); i++) {
+    workers.push_back(morsel_worker<Local>(executor, morsels, pipeline));
+  }
+  Local result{};
+  for (auto &worker : workers) {
+    // 按启动顺序等待，先结束的 worker 的结果已经就绪，不会挂起
+    merge(result, co_await std::move(worker));
+  }
+  co_return result;
+}
+
+void Run();
+
+} // namespace morsel
+} // namespace co
@@ -0,0 +1,89 @@
+#include <cmath>
+#include <chrono>
+#include <numeric>
+#include <iostream>
+#include "co_parallel.h"
+
+namespace co {
+namespace parallel {
+
+template <typename Func>
+double measure(Func &&func) {
+  auto start = std::chrono::steady_clock::now();
+  func();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000;
+}
+
+std::vector<uint64_t> random_values(std::size_t count) {
+  std::vector<uint64_t> values(count);
+  uint64_t state = 88172645463325252ULL;
+  for (auto &value : values) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    value = state;
+  }
+  return values;
+}
+
+void Run() {
+  std::cout << "start run parallel" << std::endl;
+  constexpr std::size_t COUNT = 16 << 20;
+  auto input = random_values(COUNT);
+  std::cout << "hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+
+  // 串行版本作为基准和正确性的参照
+  std::vector<double> expected_roots(COUNT);
+  auto serial_for = measure([&]() {
+    for (std::size_t i = 0; i < COUNT; i++) {
+      expected_roots[i] = std::sqrt(static_cast<double>(input[i]));
+    }
+  });
+  uint64_t expected_sum = 0;
+  auto serial_reduce = measure([&]() {
+    expected_sum = std::accumulate(input.begin(), input.end(), uint64_t(0), [](uint64_t sum, uint64_t value) {
+      return sum + value % 1000;
+    });
+  });
+  std::vector<uint64_t> expected_scan(COUNT);
+  auto serial_scan = measure([&]() { std::inclusive_scan(input.begin(), input.end(), expected_scan.begin()); });
+  auto expected_sorted = input;
+  auto serial_sort = measure([&]() { std::sort(expected_sorted.begin(), expected_sorted.end()); });
+  std::cout << "serial: for " << serial_for << " ms, reduce " << serial_reduce << " ms, scan " << serial_scan
+            << " ms, sort " << serial_sort << " ms" << std::endl;
+
+  for (std::size_t threads : { 1, 2, 4 }) {
+    executor::WorkStealingExecutor executor(threads);
+
+    std::vector<double> roots(COUNT);
+    auto for_time = measure([&]() {
+      parallel_for(executor, std::size_t(0), COUNT,
+                   [&](std::size_t i) { roots[i] = std::sqrt(static_cast<double>(input[i])); })
+        .get_result();
+    });
+
+    uint64_t sum = 0;
+    auto reduce_time = measure([&]() {
+      sum = parallel_reduce(
+              executor, std::size_t(0), COUNT, uint64_t(0), [&](std::size_t i) { return input[i] % 1000; },
+              std::plus<>())
+              .get_result();
+    });
+
+    auto scanned = input;
+    auto scan_time = measure([&]() { parallel_scan(executor, std::span<uint64_t>(scanned), std::plus<>()).get_result(); });
+
+    auto sorted = input;
+    auto sort_time = measure([&]() { parallel_merge_sort(executor, std::span<uint64_t>(sorted)).get_result(); });
+
+    auto correct = roots == expected_roots && sum == expected_sum && scanned == expected_scan &&
+                   sorted == expected_sorted;
+    std::cout << threads << " threads: for " << for_time << " ms, reduce " << reduce_time << " ms, scan "
+              << scan_time << " ms, merge sort " << sort_time << " ms, " << (correct ? "correct" : "WRONG")
+              << std::endl;
+  }
+  std::cout << "end run parallel" << std::endl;
+}
+
+} // namespace parallel
+} // namespace co
@@ -0,0 +1,368 @@
+#pragma once
+
+#include <list>
+#include <span>
+#include <mutex>
+#include <vector>
+#include <cstddef>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <type_traits>
+#include "co_task.h"
+#include "co_executor.h"
+
+namespace co {
+namespace parallel {
+
+// 没有指定粒度时，每个线程大约分到这么多块，既能通过窃取平衡负载，又不会拆得过碎
+constexpr std::size_t CHUNKS_PER_THREAD = 8;
+
+// grain 为 0 时按数据量和线程数计算粒度
+inline std::size_t adaptive_grain(const executor::WorkStealingExecutor &executor, std::size_t size,
+                                  std::size_t grain) {
+  if (grain > 0) {
+    return grain;
+  }
+  return std::max<std::size_t>(size / (executor.thread_count() * CHUNKS_PER_THREAD), 1);
+}
+
+template <typename T>
+struct TaskValue;
+
+template <typename R>
+struct TaskValue<task::Task<R>> {
+  using type = R;
+};
+
+/**
+ * 在 executor 上调用 func() 并等待它返回的 Task，spawn 本身立即返回，
+ * co_await 返回的 Task 即可等待子任务完成。func 会被拷贝，在子任务完成之前一直有效
+*/
+template <typename Func>
+auto spawn(executor::AbstractExecutor &executor, Func func)
+    -> task::Task<typename TaskValue<std::invoke_result_t<Func &>>::type> {
+  co_await executor::switch_to(executor);
+  co_return co_await func();
+}
+
+/**
+ * 等待所有 Task 完成，返回按顺序排列的结果；
+ * 有 Task 抛出异常时，仍然等待其余的 Task 全部完成，再抛出第一个异常
+*/
+template <typename R>
+auto when_all(std::vector<task::Task<R>> tasks)
+    -> task::Task<std::conditional_t<std::is_void_v<R>, void, std::vector<R>>> {
+  std::exception_ptr error;
+  if constexpr (std::is_void_v<R>) {
+    for (auto &task : tasks) {
+      try {
+        co_await std::move(task);
+      } catch (...) {
+        error = error ? error : std::current_exception();
+      }
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  } else {
+    std::vector<R> results;
+    results.reserve(tasks.size());
+    for (auto &task : tasks) {
+      try {
+        results.push_back(co_await std::move(task));
+      } catch (...) {
+        error = error ? error : std::current_exception();
+      }
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+    co_return results;
+  }
+}
+
+/**
+ * 一组在后台运行、不逐个等待的 Task：add 接管 Task，Task 完成时从集合中删除并销毁，
+ * co_await drain() 在集合为空时恢复。销毁之前需要等 drain 返回
+*/
+struct TaskSet {
+  explicit TaskSet(executor::AbstractExecutor &executor) : executor(executor) {}
+
+  TaskSet(TaskSet &) = delete;
+  TaskSet &operator=(TaskSet &) = delete;
+
+  // 所有 Task 完成时在 executor 上恢复，集合已经为空时不挂起
+  struct DrainAwaiter {
+    bool await_ready() {
+      std::lock_guard lock(set->running_lock);
+      return set->running.empty();
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+      std::lock_guard lock(set->running_lock);
+      if (set->running.empty()) {
+        return false;
+      }
+      set->drain_waiting = handle;
+      return true;
+    }
+
+    void await_resume() const noexcept {}
+
+    TaskSet *set;
+  };
+
+  /**
+   * on_completed(result) 在 Task 完成之后、从集合中删除之前调用；
+   * Task 已经完成时在 add 中立即调用
+  */
+  template <typename Callback>
+  void add(task::Task<void> &&task, Callback &&on_completed) {
+    std::list<task::Task<void>>::iterator position;
+    {
+      std::lock_guard lock(running_lock);
+      running.push_back(std::move(task));
+      position = std::prev(running.end());
+    }
+    // 回调在 final_suspend 中执行，此时可以销毁 Task
+    position->handle.promise().on_completed(
+      [this, position, on_completed = std::forward<Callback>(on_completed)](auto result) mutable {
+        on_completed(std::move(result));
+        std::coroutine_handle<> waiting;
+        {
+          std::lock_guard lock(running_lock);
+          running.erase(position);
+          if (running.empty()) {
+            waiting = std::exchange(drain_waiting, {});
+          }
+        }
+        if (waiting) {
+          executor.execute([waiting]() { waiting.resume(); });
+        }
+      });
+  }
+
+  void add(task::Task<void> &&task) {
+    add(std::move(task), [](auto) {});
+  }
+
+  DrainAwaiter drain() {
+    return DrainAwaiter{ this };
+  }
+
+private:
+  executor::AbstractExecutor &executor;
+  std::mutex running_lock;
+  std::list<task::Task<void>> running;
+  std::coroutine_handle<> drain_waiting;
+};
+
+/**
+ * 把 left() 交给 executor 上的其他线程，当前线程执行 right()，两者都完成后返回；
+ * 即使其中一个抛出异常，也要等另一个结束，避免它还在运行时引用的数据已经被销毁
+*/
+template <typename Left, typename Right>
+task::Task<void> fork_join(executor::AbstractExecutor &executor, Left left, Right right) {
+  auto forked = spawn(executor, std::move(left));
+  std::exception_ptr error;
+  try {
+    co_await right();
+  } catch (...) {
+    error = std::current_exception();
+  }
+  try {
+    co_await std::move(forked);
+  } catch (...) {
+    error = error ? error : std::current_exception();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+// 递归二分 [begin, end)，不超过 grain 时串行执行
+template <typename Index, typename Body>
+task::Task<void> for_range(executor::AbstractExecutor &executor, Index begin, Index end, Body &body,
+                           std::size_t grain) {
+  if (static_cast<std::size_t>(end - begin) <= grain) {
+    for (auto i = begin; i < end; i++) {
+      body(i);
+    }
+    co_return;
+  }
+  auto middle = begin + (end - begin) / 2;
+  co_await fork_join(
+    executor, [&]() { return for_range(executor, begin, middle, body, grain); },
+    [&]() { return for_range(executor, middle, end, body, grain); });
+}
+
+/**
+ * 对 [begin, end) 中的每个 i 并行调用 body(i)。
+ * 先切换到 executor 上再开始拆分，调用方的线程不参与计算
+*/
+template <typename Index, typename Body>
+task::Task<void> parallel_for(executor::WorkStealingExecutor &executor, Index begin, Index end, Body body,
+                              std::size_t grain = 0) {
+  if (begin >= end) {
+    co_return;
+  }
+  co_await executor::switch_to(executor);
+  co_await for_range(executor, begin, end, body, adaptive_grain(executor, end - begin, grain));
+}
+
+template <typename Index, typename T, typename Map, typename Reduce>
+task::Task<T> reduce_range(executor::AbstractExecutor &executor, Index begin, Index end, const T &identity, Map &map,
+                           Reduce &reduce, std::size_t grain) {
+  if (static_cast<std::size_t>(end - begin) <= grain) {
+    T result = identity;
+    for (auto i = begin; i < end; i++) {
+      result = reduce(std::move(result), map(i));
+    }
+    co_return result;
+  }
+  auto middle = begin + (end - begin) / 2;
+  T left = identity;
+  T right = identity;
+  co_await fork_join(
+    executor,
+    [&]() -> task::Task<void> { left = co_await reduce_range(executor, begin, middle, identity, map, reduce, grain); },
+    [&]() -> task::Task<void> { right = co_await reduce_range(executor, middle, end, identity, map, reduce, grain); });
+  co_return reduce(std::move(left), std::move(right));
+}
+
+/**
+ * 并行归约：对 [begin, end) 中的每个 i 计算 map(i)，再用 reduce 合并，identity 为单位元。
+ * reduce 需要满足结合律，合并的顺序与下标顺序一致，因此不要求交换律
+*/
+template <typename Index, typename T, typename Map, typename Reduce>
+task::Task<T> parallel_reduce(executor::WorkStealingExecutor &executor, Index begin, Index end, T identity, Map map,
+                              Reduce reduce, std::size_t grain = 0) {
+  if (begin >= end) {
+    co_return identity;
+  }
+  co_await executor::switch_to(executor);
+  co_return co_await reduce_range(executor, begin, end, identity, map, reduce,
+                                  adaptive_grain(executor, end - begin, grain));
+}
+
+/**
+ * 就地并行求前缀（inclusive scan），op 需要满足结合律。分三步：
+ * 各块并行求和；串行计算块之间的前缀（块数很少）；各块并行加上前面所有块的和并做块内前缀
+*/
+template <typename T, typename Op>
+task::Task<void> parallel_scan(executor::WorkStealingExecutor &executor, std::span<T> data, Op op,
+                               std::size_t grain = 0) {
+  if (data.empty()) {
+    co_return;
+  }
+  co_await executor::switch_to(executor);
+  grain = adaptive_grain(executor, data.size(), grain);
+  auto chunks = (data.size() + grain - 1) / grain;
+  std::vector<T> sums(chunks);
+  auto chunk = [&](std::size_t index) {
+    return data.subspan(index * grain, std::min(grain, data.size() - index * grain));
+  };
+
+  auto sum_chunk = [&](std::size_t index) {
+    auto values = chunk(index);
+    T sum = values[0];
+    for (std::size_t i = 1; i < values.size(); i++) {
+      sum = op(sum, values[i]);
+    }
+    sums[index] = sum;
+  };
+  co_await for_range(executor, std::size_t(0), chunks, sum_chunk, 1);
+
+  for (std::size_t i = 1; i < chunks; i++) {
+    sums[i] = op(sums[i - 1], sums[i]);
+  }
+
+  auto scan_chunk = [&](std::size_t index) {
+    auto values = chunk(index);
+    if (index > 0) {
+      values[0] = op(sums[index - 1], values[0]);
+    }
+    for (std::size_t i = 1; i < values.size(); i++) {
+      values[i] = op(values[i - 1], values[i]);
+    }
+  };
+  co_await for_range(executor, std::size_t(0), chunks, scan_chunk, 1);
+}
+
+/**
+ * 把有序的 a 和 b 并行合并到 output：在较长的一边取中点，到另一边二分查找对应位置，
+ * 两部分分别合并。a 中相等的元素排在 b 之前，合并是稳定的
+*/
+template <typename T, typename Compare>
+task::Task<void> merge_range(executor::AbstractExecutor &executor, std::span<T> a, std::span<T> b, T *output,
+                             Compare &comp, std::size_t grain) {
+  if (a.size() + b.size() <= grain) {
+    std::merge(std::make_move_iterator(a.begin()), std::make_move_iterator(a.end()),
+               std::make_move_iterator(b.begin()), std::make_move_iterator(b.end()), output, comp);
+    co_return;
+  }
+  std::size_t a_middle;
+  std::size_t b_middle;
+  if (a.size() >= b.size()) {
+    a_middle = a.size() / 2;
+    b_middle = std::lower_bound(b.begin(), b.end(), a[a_middle], comp) - b.begin();
+  } else {
+    b_middle = b.size() / 2;
+    a_middle = std::upper_bound(a.begin(), a.end(), b[b_middle], comp) - a.begin();
+  }
+  co_await fork_join(
+    executor, [&]() { return merge_range(executor, a.first(a_middle), b.first(b_middle), output, comp, grain); },
+    [&]() {
+      return merge_range(executor, a.subspan(a_middle), b.subspan(b_middle), output + a_middle + b_middle, comp,
+                         grain);
+    });
+}
+
+/**
+ * 排序 data，结果放在 data 或者 buffer 中：两半以相反的位置为目标递归排序，
+ * 再把两半合并到目标位置，这样每一层只需要一次合并，不需要把结果拷贝回来
+*/
+template <typename T, typename Compare>
+task::Task<void> sort_range(executor::AbstractExecutor &executor, std::span<T> data, std::span<T> buffer,
+                            bool into_buffer, Compare &comp, std::size_t grain) {
+  if (data.size() <= grain) {
+    std::sort(data.begin(), data.end(), comp);
+    if (into_buffer) {
+      std::move(data.begin(), data.end(), buffer.begin());
+    }
+    co_return;
+  }
+  auto half = data.size() / 2;
+  co_await fork_join(
+    executor,
+    [&]() { return sort_range(executor, data.first(half), buffer.first(half), !into_buffer, comp, grain); },
+    [&]() { return sort_range(executor, data.subspan(half), buffer.subspan(half), !into_buffer, comp, grain); });
+  // 两半的结果在与目标相反的位置
+  auto source = into_buffer ? data : buffer;
+  auto target = into_buffer ? buffer : data;
+  co_await merge_range(executor, source.first(half), source.subspan(half), target.data(), comp, grain);
+}
+
+/**
+ * 并行归并排序，需要与 data 同样大小的额外内存；叶子上使用 std::sort，整体不保证稳定
+*/
+template <typename T, typename Compare = std::less<T>>
+task::Task<void> parallel_merge_sort(executor::WorkStealingExecutor &executor, std::span<T> data, Compare comp = {},
+                                     std::size_t grain = 0) {
+  if (data.size() <= 1) {
+    co_return;
+  }
+  co_await executor::switch_to(executor);
+  std::vector<T> buffer(data.size());
+  co_await sort_range(executor, data, std::span<T>(buffer), false, comp,
+                      std::max<std::size_t>(adaptive_grain(executor, data.size(), grain), 2));
+}
+
+void Run();
+
+} // namespace parallel
+} // namespace co
@@ -0,0 +1,495 @@
+#include <array>
+#include <chrono>
+#include <utility>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+#include "co_query.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace co {
+namespace query {
+
+BatchStream scan(const Table &table, std::vector<std::size_t> column_ids, std::size_t batch_size) {
+  return scan(table, std::move(column_ids), 0, table.row_count(), batch_size);
+}
+
+BatchStream scan(const Table &table, std::vector<std::size_t> column_ids, std::size_t first_row, std::size_t last_row,
+                 std::size_t batch_size) {
+  Batch batch;
+  batch.columns.resize(column_ids.size());
+  for (std::size_t begin = first_row; begin < last_row; begin += batch_size) {
+    batch.size = std::min(batch_size, last_row - begin);
+    batch.selected = batch.size;
+    for (std::size_t i = 0; i < column_ids.size(); i++) {
+      batch.columns[i] = table.columns[column_ids[i]].data() + begin;
+    }
+    co_yield batch;
+  }
+}
+
+template <Compare op>
+inline bool compare(int64_t value, int64_t constant) {
+  if constexpr (op == Compare::Less) {
+    return value < constant;
+  } else if constexpr (op == Compare::LessEqual) {
+    return value <= constant;
+  } else if constexpr (op == Compare::Greater) {
+    return value > constant;
+  } else if constexpr (op == Compare::GreaterEqual) {
+    return value >= constant;
+  } else if constexpr (op == Compare::Equal) {
+    return value == constant;
+  } else {
+    return value != constant;
+  }
+}
+
+// 无分支地生成 selection：总是写入下标，只有满足条件时才前进
+template <Compare op, typename Rows>
+std::size_t select_rows(const int64_t *values, int64_t constant, Rows &&rows, std::size_t count, uint32_t *output) {
+  std::size_t selected = 0;
+  for (std::size_t i = 0; i < count; i++) {
+    auto row = rows(i);
+    output[selected] = row;
+    selected += compare<op>(values[row], constant);
+  }
+  return selected;
+}
+
+template <typename Rows>
+std::size_t select_rows(const int64_t *values, const Predicate &predicate, Rows &&rows, std::size_t count, uint32_t *output) {
+  switch (predicate.op) {
+    case Compare::Less: return select_rows<Compare::Less>(values, predicate.constant, rows, count, output);
+    case Compare::LessEqual: return select_rows<Compare::LessEqual>(values, predicate.constant, rows, count, output);
+    case Compare::Greater: return select_rows<Compare::Greater>(values, predicate.constant, rows, count, output);
+    case Compare::GreaterEqual: return select_rows<Compare::GreaterEqual>(values, predicate.constant, rows, count, output);
+    case Compare::Equal: return select_rows<Compare::Equal>(values, predicate.constant, rows, count, output);
+    case Compare::NotEqual: return select_rows<Compare::NotEqual>(values, predicate.constant, rows, count, output);
+  }
+  return 0;
+}
+
+std::size_t filter_dense_scalar(const int64_t *values, std::size_t size, const Predicate &predicate, uint32_t *output) {
+  return select_rows(values, predicate, [](std::size_t i) { return static_cast<uint32_t>(i); }, size, output);
+}
+
+// AVX2 的过滤只在 x86 上编译，其他平台使用上面的标量版本
+#if defined(__x86_64__) || defined(__i386__)
+
+// 4 个比较结果组成的掩码 -> 满足条件的下标依次排在前面
+constexpr std::array<std::array<uint32_t, 4>, 16> make_compress_table() {
+  std::array<std::array<uint32_t, 4>, 16> table{};
+  for (uint32_t mask = 0; mask < 16; mask++) {
+    uint32_t count = 0;
+    for (uint32_t bit = 0; bit < 4; bit++) {
+      if (mask & (1 << bit)) {
+        table[mask][count++] = bit;
+      }
+    }
+  }
+  return table;
+}
+
+alignas(16) constexpr auto COMPRESS_TABLE = make_compress_table();
+
+/**
+ * 一次比较 4 个值，得到 4 位掩码，再查表把满足条件的下标压缩写入 selection，
+ * 每次固定写 4 个下标，output 需要多留 4 个位置
+*/
+__attribute__((target("avx2")))
+std::size_t filter_dense_avx2(const int64_t *values, std::size_t size, const Predicate &predicate, uint32_t *output) {
+  auto constant = _mm256_set1_epi64x(predicate.constant);
+  // AVX2 只有 int64 的大于和等于，其余比较通过交换操作数或者取反得到
+  auto invert = predicate.op == Compare::LessEqual || predicate.op == Compare::GreaterEqual ||
+                predicate.op == Compare::NotEqual ? 0xF : 0;
+  std::size_t selected = 0;
+  std::size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    auto value = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+    __m256i result;
+    if (predicate.op == Compare::Less || predicate.op == Compare::GreaterEqual) {
+      result = _mm256_cmpgt_epi64(constant, value);
+    } else if (predicate.op == Compare::Greater || predicate.op == Compare::LessEqual) {
+      result = _mm256_cmpgt_epi64(value, constant);
+    } else {
+      result = _mm256_cmpeq_epi64(value, constant);
+    }
+    auto mask = _mm256_movemask_pd(_mm256_castsi256_pd(result)) ^ invert;
+    auto indexes = _mm_load_si128(reinterpret_cast<const __m128i *>(COMPRESS_TABLE[mask].data()));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(output + selected), _mm_add_epi32(indexes, _mm_set1_epi32(i)));
+    selected += __builtin_popcount(mask);
+  }
+  // 尾部不足 4 个的值，下标需要加上偏移
+  auto tail = filter_dense_scalar(values + i, size - i, predicate, output + selected);
+  for (std::size_t j = 0; j < tail; j++) {
+    output[selected + j] += i;
+  }
+  return selected + tail;
+}
+
+#endif
+
+using FilterFunction = std::size_t (*)(const int64_t *, std::size_t, const Predicate &, uint32_t *);
+
+FilterFunction dense_filter_function() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") ? filter_dense_avx2 : filter_dense_scalar;
+#else
+  return filter_dense_scalar;
+#endif
+}
+
+BatchStream filter(BatchStream input, Predicate predicate) {
+  auto filter_dense = dense_filter_function();
+  std::vector<uint32_t> selection;
+  Batch output;
+  for (const Batch &batch : input) {
+    // SIMD 版本每次固定写入 4 个下标
+    if (selection.size() < batch.size + 4) {
+      selection.resize(batch.size + 4);
+    }
+    auto values = batch.columns[predicate.column];
+    std::size_t selected;
+    if (batch.selection) {
+      // 已经过滤过的批次只检查有效的行
+      auto rows = [&batch](std::size_t i) { return batch.selection[i]; };
+      selected = select_rows(values, predicate, rows, batch.selected, selection.data());
+    } else {
+      selected = filter_dense(values, batch.size, predicate, selection.data());
+    }
+    if (selected == 0) {
+      continue;
+    }
+    output.size = batch.size;
+    output.columns = batch.columns;
+    output.selection = selection.data();
+    output.selected = selected;
+    co_yield output;
+  }
+}
+
+BatchStream project(BatchStream input, std::vector<Expression> expressions) {
+  std::vector<std::vector<int64_t>> buffers(expressions.size());
+  Batch output;
+  output.columns.resize(expressions.size());
+  for (const Batch &batch : input) {
+    // 选中的行很少时只计算选中的行，否则整列计算，便于编译器向量化
+    auto sparse = batch.selection && batch.selected * 4 < batch.size;
+    for (std::size_t j = 0; j < expressions.size(); j++) {
+      auto &expression = expressions[j];
+      auto left = batch.columns[expression.left];
+      if (expression.op == Operation::Column) {
+        output.columns[j] = left;
+        continue;
+      }
+      auto right = batch.columns[expression.right];
+      auto &buffer = buffers[j];
+      buffer.resize(batch.size);
+      auto result = buffer.data();
+      auto evaluate = [&](auto &&op) {
+        if (sparse) {
+          batch.for_each_selected([&](std::size_t i) { result[i] = op(left[i], right[i]); });
+        } else {
+          for (std::size_t i = 0; i < batch.size; i++) {
+            result[i] = op(left[i], right[i]);
+          }
+        }
+      };
+      switch (expression.op) {
+        case Operation::Add: evaluate([](int64_t l, int64_t r) { return l + r; }); break;
+        case Operation::Subtract: evaluate([](int64_t l, int64_t r) { return l - r; }); break;
+        case Operation::Multiply: evaluate([](int64_t l, int64_t r) { return l * r; }); break;
+        case Operation::Column: break;
+      }
+      output.columns[j] = result;
+    }
+    output.size = batch.size;
+    output.selection = batch.selection;
+    output.selected = batch.selected;
+    co_yield output;
+  }
+}
+
+Aggregation::Aggregation() {
+  resize(1024);
+}
+
+uint64_t Aggregation::hash(int64_t key) {
+  return static_cast<uint64_t>(key) * 0x9e3779b97f4a7c15ULL;
+}
+
+void Aggregation::consume(const Batch &batch, std::size_t key_column, std::size_t value_column) {
+  reserve(batch.selected);
+  auto keys = batch.columns[key_column];
+  auto values = batch.columns[value_column];
+  batch.for_each_selected([&](std::size_t i) { add(keys[i], 1, values[i]); });
+}
+
+void Aggregation::merge(const Aggregation &other) {
+  reserve(other.groups);
+  for (std::size_t i = 0; i < other.keys.size(); i++) {
+    if (other.used[i]) {
+      add(other.keys[i], other.counts[i], other.sums[i]);
+    }
+  }
+}
+
+BatchStream Aggregation::results() const {
+  // 把分散在哈希表中的分组整理成连续的列再按批次产出
+  std::vector<int64_t> result_keys;
+  std::vector<int64_t> result_counts;
+  std::vector<int64_t> result_sums;
+  for (std::size_t i = 0; i < keys.size(); i++) {
+    if (used[i]) {
+      result_keys.push_back(keys[i]);
+      result_counts.push_back(counts[i]);
+      result_sums.push_back(sums[i]);
+    }
+  }
+  Batch output;
+  for (std::size_t begin = 0; begin < result_keys.size(); begin += BATCH_SIZE) {
+    output.size = std::min(BATCH_SIZE, result_keys.size() - begin);
+    output.selected = output.size;
+    output.columns = { result_keys.data() + begin, result_counts.data() + begin, result_sums.data() + begin };
+    co_yield output;
+  }
+}
+
+// 插入 incoming 个新 key 之后负载因子仍不超过 0.5
+void Aggregation::reserve(std::size_t incoming) {
+  if ((groups + incoming) * 2 > keys.size()) {
+    auto capacity = keys.size();
+    while ((groups + incoming) * 2 > capacity) {
+      capacity *= 2;
+    }
+    resize(capacity);
+  }
+}
+
+void Aggregation::add(int64_t key, int64_t count, int64_t sum) {
+  auto mask = keys.size() - 1;
+  auto slot = (hash(key) >> 20) & mask;
+  while (used[slot] && keys[slot] != key) {
+    slot = (slot + 1) & mask;
+  }
+  if (!used[slot]) {
+    used[slot] = 1;
+    keys[slot] = key;
+    groups++;
+  }
+  counts[slot] += count;
+  sums[slot] += sum;
+}
+
+void Aggregation::resize(std::size_t capacity) {
+  auto old_keys = std::exchange(keys, std::vector<int64_t>(capacity));
+  auto old_counts = std::exchange(counts, std::vector<int64_t>(capacity));
+  auto old_sums = std::exchange(sums, std::vector<int64_t>(capacity));
+  auto old_used = std::exchange(used, std::vector<uint8_t>(capacity));
+  auto mask = capacity - 1;
+  for (std::size_t i = 0; i < old_keys.size(); i++) {
+    if (!old_used[i]) {
+      continue;
+    }
+    auto slot = (hash(old_keys[i]) >> 20) & mask;
+    while (used[slot]) {
+      slot = (slot + 1) & mask;
+    }
+    used[slot] = 1;
+    keys[slot] = old_keys[i];
+    counts[slot] = old_counts[i];
+    sums[slot] = old_sums[i];
+  }
+}
+
+BatchStream hash_aggregate(BatchStream input, std::size_t key_column, std::size_t value_column) {
+  Aggregation aggregation;
+  for (const Batch &batch : input) {
+    aggregation.consume(batch, key_column, value_column);
+  }
+  for (const Batch &batch : aggregation.results()) {
+    co_yield batch;
+  }
+}
+
+BatchStream top_k(BatchStream input, std::size_t order_column, std::size_t k) {
+  if (k == 0) {
+    co_return;
+  }
+  // 小顶堆保存当前的前 k 行：(排序值, 行在 rows 中的位置)，堆顶是门槛值
+  std::vector<std::pair<int64_t, std::size_t>> heap;
+  std::vector<int64_t> rows;
+  std::size_t column_count = 0;
+  auto greater = [](const auto &l, const auto &r) { return l.first > r.first; };
+
+  for (const Batch &batch : input) {
+    column_count = batch.columns.size();
+    rows.resize(k * column_count);
+    auto order = batch.columns[order_column];
+    batch.for_each_selected([&](std::size_t i) {
+      std::size_t slot;
+      if (heap.size() < k) {
+        slot = heap.size();
+      } else if (order[i] > heap.front().first) {
+        std::pop_heap(heap.begin(), heap.end(), greater);
+        slot = heap.back().second;
+        heap.pop_back();
+      } else {
+        return;
+      }
+      for (std::size_t c = 0; c < column_count; c++) {
+        rows[slot * column_count + c] = batch.columns[c][i];
+      }
+      heap.emplace_back(order[i], slot);
+      std::push_heap(heap.begin(), heap.end(), greater);
+    });
+  }
+
+  std::sort(heap.begin(), heap.end(), greater);
+  std::vector<std::vector<int64_t>> columns(column_count);
+  for (auto &[_, slot] : heap) {
+    for (std::size_t c = 0; c < column_count; c++) {
+      columns[c].push_back(rows[slot * column_count + c]);
+    }
+  }
+  Batch output;
+  output.size = heap.size();
+  output.selected = output.size;
+  for (auto &column : columns) {
+    output.columns.push_back(column.data());
+  }
+  co_yield output;
+}
+
+// 对照：逐行传递的生成器流水线
+struct Row {
+  int64_t key;
+  int64_t price;
+  int64_t quantity;
+};
+
+struct RevenueRow {
+  int64_t key;
+  int64_t revenue;
+};
+
+generator::Generator<Row> scan_rows(const Table &table) {
+  auto &key = table.columns[0];
+  auto &price = table.columns[1];
+  auto &quantity = table.columns[2];
+  for (std::size_t i = 0; i < table.row_count(); i++) {
+    co_yield Row{ key[i], price[i], quantity[i] };
+  }
+}
+
+generator::Generator<Row> filter_rows(generator::Generator<Row> input, int64_t max_quantity) {
+  for (auto row : input) {
+    if (row.quantity < max_quantity) {
+      co_yield row;
+    }
+  }
+}
+
+generator::Generator<RevenueRow> project_rows(generator::Generator<Row> input) {
+  for (auto row : input) {
+    co_yield RevenueRow{ row.key, row.price * row.quantity };
+  }
+}
+
+Table make_table(std::size_t row_count) {
+  Table table;
+  table.columns.assign(3, std::vector<int64_t>(row_count));
+  uint64_t state = 88172645463325252ULL;
+  auto next = [&state]() {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+  };
+  for (std::size_t i = 0; i < row_count; i++) {
+    table.columns[0][i] = next() % 1000;
+    table.columns[1][i] = next() % 10000 + 1;
+    table.columns[2][i] = next() % 50 + 1;
+  }
+  return table;
+}
+
+template <typename Func>
+void measure(const char *name, std::size_t row_count, Func &&func) {
+  auto start = std::chrono::steady_clock::now();
+  auto checksum = func();
+  auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << name << ": " << seconds * 1000 << " ms, " << row_count / seconds / 1e6 << " M rows/s, checksum "
+            << checksum << std::endl;
+}
+
+void Run() {
+  std::cout << "start run query" << std::endl;
+  // 三列 int64，1 亿行约 2.4 GB
+  constexpr std::size_t ROW_COUNT = 100'000'000;
+  auto table = make_table(ROW_COUNT);
+
+  // SELECT key, COUNT(*), SUM(price * quantity) FROM table WHERE quantity < 25 GROUP BY key
+  measure("vectorized aggregate", ROW_COUNT, [&]() {
+    auto plan = hash_aggregate(
+      project(filter(scan(table, { 0, 1, 2 }), { 2, Compare::Less, 25 }),
+              { { Operation::Column, 0 }, { Operation::Multiply, 1, 2 } }),
+      0, 1);
+    int64_t checksum = 0;
+    for (const Batch &batch : plan) {
+      batch.for_each_selected([&](std::size_t i) { checksum += batch.columns[1][i] + batch.columns[2][i]; });
+    }
+    return checksum;
+  });
+
+  measure("tuple-at-a-time aggregate", ROW_COUNT, [&]() {
+    std::unordered_map<int64_t, std::pair<int64_t, int64_t>> groups;
+    for (auto row : project_rows(filter_rows(scan_rows(table), 25))) {
+      auto &group = groups[row.key];
+      group.first++;
+      group.second += row.revenue;
+    }
+    int64_t checksum = 0;
+    for (auto &[_, group] : groups) {
+      checksum += group.first + group.second;
+    }
+    return checksum;
+  });
+
+  // SELECT * FROM table ORDER BY price DESC LIMIT 10
+  measure("vectorized top-k", ROW_COUNT, [&]() {
+    int64_t checksum = 0;
+    for (const Batch &batch : top_k(scan(table, { 0, 1, 2 }), 1, 10)) {
+      batch.for_each_selected([&](std::size_t i) { checksum += batch.columns[1][i]; });
+    }
+    return checksum;
+  });
+
+  measure("tuple-at-a-time top-k", ROW_COUNT, [&]() {
+    std::vector<int64_t> prices;
+    for (auto row : scan_rows(table)) {
+      if (prices.size() < 10 || row.price > prices.front()) {
+        prices.push_back(row.price);
+        std::push_heap(prices.begin(), prices.end(), std::greater<>());
+        if (prices.size() > 10) {
+          std::pop_heap(prices.begin(), prices.end(), std::greater<>());
+          prices.pop_back();
+        }
+      }
+    }
+    int64_t checksum = 0;
+    for (auto price : prices) {
+      checksum += price;
+    }
+    return checksum;
+  });
+  std::cout << "end run query" << std::endl;
+}
+
+} // namespace query
+} // namespace co
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "co_generator.h"
+
+namespace co {
+namespace query {
+
+// 算子之间每次传递的行数
+constexpr std::size_t BATCH_SIZE = 1024;
+
+/**
+ * 列式存储的表，所有列都是 int64_t
+*/
+struct Table {
+  std::vector<std::vector<int64_t>> columns;
+
+  std::size_t row_count() const {
+    return columns.empty() ? 0 : columns.front().size();
+  }
+};
+
+/**
+ * 算子之间传递的列批次，每列 size 个值；selection 不为空时只有其中列出的行是有效的，
+ * 过滤只生成新的 selection，不移动列数据。
+ * 批次及其引用的数据只在生成器下一次恢复之前有效
+*/
+struct Batch {
+  std::size_t size = 0;
+  std::vector<const int64_t *> columns;
+  const uint32_t *selection = nullptr;
+  std::size_t selected = 0;
+
+  // 对每个有效行调用 func(row)
+  template <typename Func>
+  void for_each_selected(Func &&func) const {
+    if (selection) {
+      for (std::size_t i = 0; i < selected; i++) {
+        func(selection[i]);
+      }
+    } else {
+      for (std::size_t i = 0; i < size; i++) {
+        func(i);
+      }
+    }
+  }
+};
+
+using BatchStream = generator::Generator<const Batch &>;
+
+enum class Compare {
+  Less,
+  LessEqual,
+  Greater,
+  GreaterEqual,
+  Equal,
+  NotEqual,
+};
+
+// column <op> constant
+struct Predicate {
+  std::size_t column;
+  Compare op;
+  int64_t constant;
+};
+
+enum class Operation {
+  // 直接输出 left 列
+  Column,
+  Add,
+  Subtract,
+  Multiply,
+};
+
+// left <op> right，结果作为新的一列
+struct Expression {
+  Operation op;
+  std::size_t left;
+  std::size_t right = 0;
+};
+
+// 按批次扫描表中的 column_ids 列，批次直接引用表中的数据
+BatchStream scan(const Table &table, std::vector<std::size_t> column_ids, std::size_t batch_size = BATCH_SIZE);
+
+// 只扫描 [first_row, last_row) 范围内的行
+BatchStream scan(const Table &table, std::vector<std::size_t> column_ids, std::size_t first_row, std::size_t last_row,
+                 std::size_t batch_size = BATCH_SIZE);
+
+// 按谓词过滤，只生成 selection，x86 上支持 AVX2 时用 SIMD 比较并压缩下标
+BatchStream filter(BatchStream input, Predicate predicate);
+
+// 每个表达式计算出一列，selection 原样传递
+BatchStream project(BatchStream input, std::vector<Expression> expressions);
+
+/**
+ * 分组聚合的状态，开放寻址哈希表，key 和聚合值按列存放。
+ * 并行执行时每个 worker 各自聚合一部分输入，最后再用 merge 合并
+*/
+struct Aggregation {
+  Aggregation();
+
+  // 按 key_column 分组，累加行数和 value_column 之和
+  void consume(const Batch &batch, std::size_t key_column, std::size_t value_column);
+
+  // 合并另一个局部聚合的结果
+  void merge(const Aggregation &other);
+
+  std::size_t group_count() const {
+    return groups;
+  }
+
+  // 输出列为 [key, count, sum]，产出过程中 Aggregation 不能被修改或销毁
+  BatchStream results() const;
+
+private:
+  static uint64_t hash(int64_t key);
+  void reserve(std::size_t incoming);
+  void add(int64_t key, int64_t count, int64_t sum);
+  void resize(std::size_t capacity);
+
+  std::vector<int64_t> keys;
+  std::vector<int64_t> counts;
+  std::vector<int64_t> sums;
+  std::vector<uint8_t> used;
+  std::size_t groups = 0;
+};
+
+/**
+ * 按 key_column 分组，统计每组的行数和 value_column 之和，
+ * 输入全部消费完之后才开始产出，输出列为 [key, count, sum]
+*/
+BatchStream hash_aggregate(BatchStream input, std::size_t key_column, std::size_t value_column);
+
+// 按 order_column 从大到小取前 k 行，输出所有列
+BatchStream top_k(BatchStream input, std::size_t order_column, std::size_t k);
+
+void Run();
+
+} // namespace query
+} // namespace co
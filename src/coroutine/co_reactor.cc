@@ -0,0 +1,255 @@
+#include <cerrno>
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <utility>
+#include <stdexcept>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <system_error>
+#include "co_reactor.h"
+
+namespace co {
+namespace reactor {
+
+Reactor::Reactor() {
+  epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "epoll_create1");
+  }
+  wakeup_fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (wakeup_fd < 0) {
+    auto error = errno;
+    ::close(epoll_fd);
+    throw std::system_error(error, std::generic_category(), "eventfd");
+  }
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.fd = wakeup_fd;
+  ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wakeup_fd, &event);
+  loop_thread = std::thread(&Reactor::run_loop, this);
+}
+
+Reactor::~Reactor() {
+  shutdown();
+  ::close(wakeup_fd);
+  ::close(epoll_fd);
+}
+
+void Reactor::shutdown() {
+  if (loop_thread.get_id() == std::this_thread::get_id()) {
+    throw std::logic_error("reactor shut down from its own thread");
+  }
+  {
+    std::lock_guard lock(registrations_lock);
+    if (!is_active) {
+      return;
+    }
+    is_active = false;
+  }
+  uint64_t value = 1;
+  [[maybe_unused]] auto written = ::write(wakeup_fd, &value, sizeof(value));
+  if (loop_thread.joinable()) {
+    loop_thread.join();
+  }
+}
+
+bool Reactor::arm(IoAwaiter *awaiter) {
+  auto has_deadline = awaiter->deadline != deadline::NONE;
+  if (has_deadline && deadline::Clock::now() >= awaiter->deadline) {
+    awaiter->expired = true;
+    return false;
+  }
+  auto earliest = false;
+  {
+    std::lock_guard lock(registrations_lock);
+    auto &registration = registrations[awaiter->fd];
+    if (!registration) {
+      registration = std::make_unique<Registration>();
+      registration->fd = awaiter->fd;
+    }
+    auto &slot = awaiter->write ? registration->writer : registration->reader;
+    slot = awaiter;
+    try {
+      update(*registration);
+    } catch (...) {
+      slot = nullptr;
+      throw;
+    }
+    if (has_deadline) {
+      awaiter->timer = timers.emplace(awaiter->deadline, awaiter);
+      earliest = awaiter->timer == timers.begin();
+    }
+  }
+  // 解锁之后协程可能已经在反应器线程上恢复，不能再访问 awaiter
+  if (earliest) {
+    // 比之前最早的截止时间还要早，唤醒反应器线程重新计算等待时间
+    uint64_t value = 1;
+    [[maybe_unused]] auto written = ::write(wakeup_fd, &value, sizeof(value));
+  }
+  return true;
+}
+
+Reactor::TimerId Reactor::schedule(deadline::Clock::time_point when, std::function<void()> &&callback) {
+  TimerId timer;
+  bool earliest;
+  {
+    std::lock_guard lock(registrations_lock);
+    timer = TimerId(when, next_callback++);
+    auto position = callbacks.emplace(timer, std::move(callback)).first;
+    earliest = position == callbacks.begin();
+  }
+  if (earliest) {
+    uint64_t value = 1;
+    [[maybe_unused]] auto written = ::write(wakeup_fd, &value, sizeof(value));
+  }
+  return timer;
+}
+
+void Reactor::cancel(const TimerId &timer) {
+  std::lock_guard lock(registrations_lock);
+  callbacks.erase(timer);
+}
+
+void Reactor::cancel_timer(IoAwaiter *awaiter) {
+  if (awaiter->deadline != deadline::NONE) {
+    timers.erase(awaiter->timer);
+  }
+}
+
+int Reactor::expire_timers(std::vector<IoAwaiter *> &ready) {
+  auto now = deadline::Clock::now();
+  while (!timers.empty() && timers.begin()->first <= now) {
+    auto awaiter = timers.begin()->second;
+    timers.erase(timers.begin());
+    awaiter->expired = true;
+    ready.push_back(awaiter);
+    auto &registration = *registrations.at(awaiter->fd);
+    (awaiter->write ? registration.writer : registration.reader) = nullptr;
+    // 没有剩余的等待者时之后的事件会被忽略；剩余的等待者缩小监听范围失败时，多出来的事件同样被忽略
+    if (registration.reader || registration.writer) {
+      try {
+        update(registration);
+      } catch (...) {
+      }
+    }
+  }
+  while (!callbacks.empty() && callbacks.begin()->first.first <= now) {
+    auto callback = std::move(callbacks.begin()->second);
+    callbacks.erase(callbacks.begin());
+    callback();
+  }
+  auto next = deadline::NONE;
+  if (!timers.empty()) {
+    next = timers.begin()->first;
+  }
+  if (!callbacks.empty()) {
+    next = std::min(next, callbacks.begin()->first.first);
+  }
+  if (next == deadline::NONE) {
+    return -1;
+  }
+  return static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(next - now).count());
+}
+
+void Reactor::update(Registration &registration) {
+  epoll_event event{};
+  event.events = EPOLLONESHOT | (registration.reader ? static_cast<uint32_t>(EPOLLIN | EPOLLRDHUP) : 0u) |
+                 (registration.writer ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+  // 按 fd 查找登记信息，forget 之后才取出的事件找不到登记信息，直接忽略
+  event.data.fd = registration.fd;
+  auto operation = registration.added ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+  if (::epoll_ctl(epoll_fd, operation, registration.fd, &event) < 0) {
+    throw std::system_error(errno, std::generic_category(), "epoll_ctl");
+  }
+  registration.added = true;
+}
+
+void Reactor::forget(int fd) {
+  std::lock_guard lock(registrations_lock);
+  auto it = registrations.find(fd);
+  if (it == registrations.end()) {
+    return;
+  }
+  if (it->second->added) {
+    ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+  }
+  registrations.erase(it);
+}
+
+void Reactor::run_loop() {
+  constexpr int MAX_EVENTS = 64;
+  epoll_event events[MAX_EVENTS];
+  std::vector<IoAwaiter *> ready;
+  // 下一个截止时间的毫秒数，没有时一直等待
+  int timeout = -1;
+  // 就绪的等待者不再需要计时
+  auto take = [this, &ready](IoAwaiter *&slot) {
+    auto awaiter = std::exchange(slot, nullptr);
+    cancel_timer(awaiter);
+    ready.push_back(awaiter);
+  };
+  while (true) {
+    auto count = ::epoll_wait(epoll_fd, events, MAX_EVENTS, timeout);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    {
+      std::lock_guard lock(registrations_lock);
+      if (!is_active) {
+        return;
+      }
+      for (int i = 0; i < count; i++) {
+        if (events[i].data.fd == wakeup_fd) {
+          uint64_t value;
+          [[maybe_unused]] auto drained = ::read(wakeup_fd, &value, sizeof(value));
+          continue;
+        }
+        auto it = registrations.find(events[i].data.fd);
+        if (it == registrations.end()) {
+          continue;
+        }
+        auto registration = it->second.get();
+        // 出错和挂断时读写双方都恢复，由它们的系统调用返回具体的错误
+        auto flags = events[i].events;
+        auto failed = flags & (EPOLLERR | EPOLLHUP);
+        if (registration->reader && (failed || (flags & (EPOLLIN | EPOLLRDHUP)))) {
+          take(registration->reader);
+        }
+        if (registration->writer && (failed || (flags & EPOLLOUT))) {
+          take(registration->writer);
+        }
+        if (registration->reader || registration->writer) {
+          try {
+            update(*registration);
+          } catch (...) {
+            // 无法继续监听时恢复剩余的等待者，由它们的系统调用返回错误
+            if (registration->reader) {
+              take(registration->reader);
+            }
+            if (registration->writer) {
+              take(registration->writer);
+            }
+          }
+        }
+      }
+      timeout = expire_timers(ready);
+    }
+    for (auto awaiter : ready) {
+      if (awaiter->resume_on) {
+        awaiter->resume_on->execute([handle = awaiter->handle]() { handle.resume(); });
+      } else {
+        awaiter->handle.resume();
+      }
+    }
+    ready.clear();
+  }
+}
+
+} // namespace reactor
+} // namespace co
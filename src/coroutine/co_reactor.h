@@ -0,0 +1,137 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <coroutine>
+#include <functional>
+#include <unordered_map>
+#include "co_executor.h"
+#include "co_deadline.h"
+
+namespace co {
+namespace reactor {
+
+/**
+ * 基于 epoll 的反应器，在单独的线程上等待文件描述符就绪：
+ * co_await reactor.readable(fd) / writable(fd) 在 fd 可读 / 可写（或者出错、挂断）时恢复，
+ * 恢复之后由调用方自己进行非阻塞的读写，遇到 EAGAIN 再次等待。
+ * 同一个 fd 同一时间最多有一个读等待者和一个写等待者，关闭 fd 之前需要调用 forget。
+ * 等待遵守当前协程的截止时间（见 co_deadline.h），截止时间先到时恢复并抛出 deadline::DeadlineExceeded
+*/
+struct Reactor {
+  struct IoAwaiter;
+
+  // 带截止时间的等待者按截止时间排序
+  using Timers = std::multimap<deadline::Clock::time_point, IoAwaiter *>;
+
+  // 定时回调按触发时间和登记顺序排序，键同时用作取消时的句柄
+  using Callbacks = std::map<std::pair<deadline::Clock::time_point, uint64_t>, std::function<void()>>;
+  using TimerId = Callbacks::key_type;
+
+  Reactor();
+  ~Reactor();
+
+  Reactor(Reactor &) = delete;
+  Reactor &operator=(Reactor &) = delete;
+
+  // resume_on 为空时在反应器线程上恢复
+  IoAwaiter readable(int fd, executor::AbstractExecutor *resume_on = nullptr) {
+    return IoAwaiter{ this, fd, false, resume_on, deadline::current() };
+  }
+
+  IoAwaiter writable(int fd, executor::AbstractExecutor *resume_on = nullptr) {
+    return IoAwaiter{ this, fd, true, resume_on, deadline::current() };
+  }
+
+  /**
+   * 在 when 之后于反应器线程上调用 callback。回调执行时持有反应器内部的锁，
+   * 只能做简短的工作（例如把协程交给某个 executor 恢复），不能阻塞，也不能调用反应器的方法
+  */
+  TimerId schedule(deadline::Clock::time_point when, std::function<void()> &&callback);
+
+  // 取消尚未执行的回调；返回之后回调不会再执行，也不会正在执行
+  void cancel(const TimerId &timer);
+
+  // 不再监听 fd，fd 上不能有等待者
+  void forget(int fd);
+
+  /**
+   * 停止反应器线程，等待中的协程不会再被恢复。
+   * 不能在反应器线程上（例如在反应器线程上恢复的协程中）关闭或者销毁反应器，这样调用时抛出 std::logic_error
+  */
+  void shutdown();
+
+  struct IoAwaiter {
+    constexpr bool await_ready() const noexcept {
+      return false;
+    }
+
+    // 注册失败时抛出 std::system_error，截止时间已过时不挂起
+    bool await_suspend(std::coroutine_handle<> handle) {
+      this->handle = handle;
+      return reactor->arm(this);
+    }
+
+    void await_resume() const {
+      if (expired) {
+        throw deadline::DeadlineExceeded(write ? "wait writable" : "wait readable");
+      }
+    }
+
+    Reactor *reactor;
+    int fd;
+    bool write;
+    executor::AbstractExecutor *resume_on;
+    deadline::Clock::time_point deadline;
+    std::coroutine_handle<> handle{};
+    bool expired = false;
+    // deadline 不为 NONE 时在 timers 中的位置
+    Timers::iterator timer{};
+  };
+
+private:
+  // 一个 fd 的等待者，注册使用 EPOLLONESHOT，每次触发之后按剩余的等待者重新注册
+  struct Registration {
+    int fd;
+    IoAwaiter *reader = nullptr;
+    IoAwaiter *writer = nullptr;
+    bool added = false;
+  };
+
+  // 截止时间已过时不注册，返回 false
+  bool arm(IoAwaiter *awaiter);
+
+  // 需要持有 registrations_lock，从 timers 中删除就绪的等待者
+  void cancel_timer(IoAwaiter *awaiter);
+
+  /**
+   * 需要持有 registrations_lock，取出截止时间已过的等待者并执行到期的回调，
+   * 返回距离下一个截止时间的毫秒数，没有时为 -1
+  */
+  int expire_timers(std::vector<IoAwaiter *> &ready);
+
+  // 需要持有 registrations_lock
+  void update(Registration &registration);
+
+  void run_loop();
+
+  int epoll_fd = -1;
+  // 写入之后唤醒 epoll_wait，用于停止反应器线程和重新计算等待时间
+  int wakeup_fd = -1;
+  bool is_active = true;
+
+  std::mutex registrations_lock;
+  std::unordered_map<int, std::unique_ptr<Registration>> registrations;
+  Timers timers;
+  Callbacks callbacks;
+  uint64_t next_callback = 0;
+  std::thread loop_thread;
+};
+
+} // namespace reactor
+} // namespace co
@@ -0,0 +1,686 @@
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <system_error>
+#include "co_rpc.h"
+#include "co_deadline.h"
+
+namespace co {
+namespace rpc {
+
+namespace {
+
+// 每次 read 至少留出的空间
+constexpr std::size_t READ_CHUNK = 64 * 1024;
+
+void put_u32(char *output, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    output[i] = static_cast<char>(value >> (8 * i));
+  }
+}
+
+void put_u64(char *output, uint64_t value) {
+  for (int i = 0; i < 8; i++) {
+    output[i] = static_cast<char>(value >> (8 * i));
+  }
+}
+
+uint32_t get_u32(const char *input) {
+  uint32_t value = 0;
+  for (int i = 0; i < 4; i++) {
+    value |= static_cast<uint32_t>(static_cast<unsigned char>(input[i])) << (8 * i);
+  }
+  return value;
+}
+
+uint64_t get_u64(const char *input) {
+  uint64_t value = 0;
+  for (int i = 0; i < 8; i++) {
+    value |= static_cast<uint64_t>(static_cast<unsigned char>(input[i])) << (8 * i);
+  }
+  return value;
+}
+
+FrameHeader decode_header(const char *input) {
+  return FrameHeader{ get_u32(input), get_u32(input + 4), get_u64(input + 8) };
+}
+
+bool would_block(int error) {
+  return error == EAGAIN || error == EWOULDBLOCK;
+}
+
+} // namespace
+
+Connection::Connection(reactor::Reactor &reactor, executor::AbstractExecutor &executor, int fd)
+    : reactor(reactor), executor(executor), fd(fd) {
+  auto flags = ::fcntl(fd, F_GETFL);
+  if (flags < 0 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+    auto error = errno;
+    ::close(fd);
+    throw std::system_error(error, std::generic_category(), "fcntl");
+  }
+  // 批量由 writev 负责，不需要 Nagle 算法再等待；Unix 域套接字上会失败，忽略即可
+  int enabled = 1;
+  ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enabled, sizeof(enabled));
+  writer.emplace(write_loop());
+}
+
+Connection::~Connection() {
+  reactor.forget(fd);
+  ::close(fd);
+}
+
+void Connection::send(uint32_t code, uint64_t id, std::string_view payload) {
+  Bytes frame(FrameHeader::SIZE + payload.size(), '\0');
+  put_u32(frame.data(), static_cast<uint32_t>(payload.size()));
+  put_u32(frame.data() + 4, code);
+  put_u64(frame.data() + 8, id);
+  std::memcpy(frame.data() + FrameHeader::SIZE, payload.data(), payload.size());
+  std::unique_lock lock(pending_lock);
+  if (closing) {
+    return;
+  }
+  pending.push_back(std::move(frame));
+  auto waiting = std::exchange(writer_waiting, {});
+  lock.unlock();
+  // 写协程放到 executor 上恢复，在它运行之前发送的帧都会进入同一批
+  if (waiting) {
+    executor.execute([waiting]() { waiting.resume(); });
+  }
+}
+
+bool Connection::WriteSignal::await_ready() {
+  std::lock_guard lock(connection->pending_lock);
+  return !connection->pending.empty() || connection->closing;
+}
+
+bool Connection::WriteSignal::await_suspend(std::coroutine_handle<> handle) {
+  std::lock_guard lock(connection->pending_lock);
+  if (!connection->pending.empty() || connection->closing) {
+    return false;
+  }
+  connection->writer_waiting = handle;
+  return true;
+}
+
+task::Task<void> Connection::write_loop() {
+  deadline::clear();
+  std::vector<Bytes> batch;
+  std::vector<iovec> buffers;
+  while (true) {
+    co_await WriteSignal{ this };
+    {
+      std::lock_guard lock(pending_lock);
+      batch.swap(pending);
+      if (batch.empty() && closing) {
+        break;
+      }
+    }
+    // first 是第一个没有写完的帧，offset 是它已经写出的字节数
+    std::size_t first = 0;
+    std::size_t offset = 0;
+    while (first < batch.size()) {
+      buffers.clear();
+      for (auto i = first; i < batch.size() && buffers.size() < WRITE_BATCH; i++) {
+        auto skip = i == first ? offset : 0;
+        buffers.push_back(iovec{ batch[i].data() + skip, batch[i].size() - skip });
+      }
+      auto written = ::writev(fd, buffers.data(), static_cast<int>(buffers.size()));
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        if (would_block(errno)) {
+          co_await reactor.writable(fd, &executor);
+          continue;
+        }
+        throw std::system_error(errno, std::generic_category(), "writev");
+      }
+      writes.fetch_add(1, std::memory_order_relaxed);
+      auto remaining = static_cast<std::size_t>(written);
+      while (remaining > 0) {
+        auto left = batch[first].size() - offset;
+        if (remaining < left) {
+          offset += remaining;
+          break;
+        }
+        remaining -= left;
+        first++;
+        offset = 0;
+        frames.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    batch.clear();
+  }
+  ::shutdown(fd, SHUT_WR);
+}
+
+task::Task<void> Connection::close() {
+  if (!writer) {
+    co_return;
+  }
+  std::coroutine_handle<> waiting;
+  {
+    std::lock_guard lock(pending_lock);
+    closing = true;
+    waiting = std::exchange(writer_waiting, {});
+  }
+  if (waiting) {
+    executor.execute([waiting]() { waiting.resume(); });
+  }
+  auto task = std::move(*writer);
+  writer.reset();
+  co_await std::move(task);
+}
+
+task::Task<void> Connection::receive(FrameHandler on_frame) {
+  // 读循环与连接的生命周期相同，不受建立连接的请求的截止时间限制
+  deadline::clear();
+  co_await executor::switch_to(executor);
+  // [start, end) 是已经读入还没有解析的字节
+  std::vector<char> buffer(READ_CHUNK);
+  std::size_t start = 0;
+  std::size_t end = 0;
+  while (true) {
+    auto count = ::read(fd, buffer.data() + end, buffer.size() - end);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (would_block(errno)) {
+        co_await reactor.readable(fd, &executor);
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(), "read");
+    }
+    if (count == 0) {
+      if (start != end) {
+        throw RpcError("connection closed in the middle of a frame");
+      }
+      co_return;
+    }
+    end += count;
+    while (end - start >= FrameHeader::SIZE) {
+      auto header = decode_header(buffer.data() + start);
+      if (header.length > MAX_PAYLOAD_SIZE) {
+        throw RpcError("frame too large");
+      }
+      if (end - start < FrameHeader::SIZE + header.length) {
+        break;
+      }
+      auto payload = buffer.data() + start + FrameHeader::SIZE;
+      on_frame(header, Bytes(payload, header.length));
+      start += FrameHeader::SIZE + header.length;
+    }
+    // 剩下的不完整的帧移到开头，帧比缓冲区大时扩大缓冲区
+    if (start > 0) {
+      std::memmove(buffer.data(), buffer.data() + start, end - start);
+      end -= start;
+      start = 0;
+    }
+    if (end >= FrameHeader::SIZE) {
+      auto needed = FrameHeader::SIZE + decode_header(buffer.data()).length;
+      if (needed > buffer.size()) {
+        buffer.resize(needed);
+      }
+    }
+    if (buffer.size() - end < READ_CHUNK / 4) {
+      buffer.resize(end + READ_CHUNK);
+    }
+  }
+}
+
+Client::Client(reactor::Reactor &reactor, executor::AbstractExecutor &executor, int fd)
+    : reactor(reactor), executor(executor), conn(reactor, executor, fd) {
+  reader.emplace(read_responses());
+}
+
+Client::~Client() = default;
+
+bool Client::CallAwaiter::await_suspend(std::coroutine_handle<> handle) {
+  this->handle = handle;
+  if (deadline != deadline::NONE && deadline::Clock::now() >= deadline) {
+    error = std::make_exception_ptr(deadline::DeadlineExceeded("rpc call"));
+    return false;
+  }
+  auto client = this->client;
+  uint64_t id;
+  {
+    std::lock_guard lock(client->calls_lock);
+    if (client->closed_error) {
+      error = client->closed_error;
+      return false;
+    }
+    id = client->next_id++;
+    client->calls[id] = PendingCall{ this, std::nullopt };
+  }
+  // 定时回调要取 calls_lock，不能在持有 calls_lock 时登记
+  std::optional<reactor::Reactor::TimerId> timer;
+  if (deadline != deadline::NONE) {
+    timer = client->reactor.schedule(deadline, [client, id]() { client->expire(id); });
+  }
+  std::lock_guard lock(client->calls_lock);
+  auto it = client->calls.find(id);
+  if (it == client->calls.end()) {
+    // 登记之后截止时间已经到达或者连接已经断开，调用方已经交给别处恢复，不再发送
+    return true;
+  }
+  it->second.timer = timer;
+  // 持有 calls_lock 时调用方不会被恢复；解锁之后响应随时可能到达并恢复调用方，不能再访问 this
+  client->conn.send(method, id, request);
+  return true;
+}
+
+Bytes Client::CallAwaiter::await_resume() {
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  return std::move(*response);
+}
+
+task::Task<void> Client::read_responses() {
+  std::exception_ptr error;
+  try {
+    co_await conn.receive([this](const FrameHeader &header, Bytes &&payload) { on_response(header, std::move(payload)); });
+  } catch (...) {
+    error = std::current_exception();
+  }
+  if (!error) {
+    error = std::make_exception_ptr(RpcError("connection closed"));
+  }
+  fail_all(error);
+}
+
+void Client::on_response(const FrameHeader &header, Bytes &&payload) {
+  PendingCall pending{};
+  {
+    std::lock_guard lock(calls_lock);
+    auto it = calls.find(header.id);
+    if (it == calls.end()) {
+      // 调用已经因为截止时间结束
+      return;
+    }
+    pending = it->second;
+    calls.erase(it);
+  }
+  // 取消之后定时回调不会再执行，正在执行的回调已经找不到这个调用
+  if (pending.timer) {
+    reactor.cancel(*pending.timer);
+  }
+  auto call = pending.call;
+  if (header.code == OK) {
+    call->response = std::move(payload);
+  } else if (header.code == NO_SUCH_METHOD) {
+    call->error = std::make_exception_ptr(RpcError("no such method"));
+  } else {
+    call->error = std::make_exception_ptr(RpcError(payload));
+  }
+  // 已经在连接的 executor 上，直接恢复调用方
+  call->handle.resume();
+}
+
+void Client::expire(uint64_t id) {
+  CallAwaiter *call;
+  {
+    std::lock_guard lock(calls_lock);
+    auto it = calls.find(id);
+    if (it == calls.end()) {
+      return;
+    }
+    call = it->second.call;
+    calls.erase(it);
+  }
+  call->error = std::make_exception_ptr(deadline::DeadlineExceeded("rpc call"));
+  // 在反应器线程上，交给连接的 executor 恢复
+  executor.execute([handle = call->handle]() { handle.resume(); });
+}
+
+void Client::fail_all(std::exception_ptr error) {
+  std::unordered_map<uint64_t, PendingCall> failed;
+  {
+    std::lock_guard lock(calls_lock);
+    closed_error = error;
+    failed.swap(calls);
+  }
+  for (auto &[id, pending] : failed) {
+    if (pending.timer) {
+      reactor.cancel(*pending.timer);
+    }
+    pending.call->error = error;
+    pending.call->handle.resume();
+  }
+}
+
+task::Task<void> Client::close() {
+  co_await conn.close();
+  if (reader) {
+    auto task = std::move(*reader);
+    reader.reset();
+    co_await std::move(task);
+  }
+}
+
+task::Task<void> Server::run_handler(Connection &connection, Handler &handler, uint64_t id, Bytes request) {
+  try {
+    auto response = co_await handler(std::move(request));
+    connection.send(OK, id, response);
+  } catch (std::exception &e) {
+    connection.send(FAILED, id, e.what());
+  } catch (...) {
+    connection.send(FAILED, id, "unknown error");
+  }
+}
+
+void Server::dispatch(Connection &connection, parallel::TaskSet &requests, const FrameHeader &header,
+                      Bytes &&payload) {
+  auto it = handlers.find(header.code);
+  if (it == handlers.end()) {
+    connection.send(NO_SUCH_METHOD, header.id, {});
+    return;
+  }
+  auto task = run_handler(connection, it->second, header.id, std::move(payload));
+  // 同步完成的请求不需要登记，Task 在这里销毁
+  if (task.handle.promise().is_completed()) {
+    return;
+  }
+  requests.add(std::move(task));
+}
+
+task::Task<void> Server::serve(int fd) {
+  Connection connection(reactor, executor, fd);
+  parallel::TaskSet requests(executor);
+  std::exception_ptr error;
+  try {
+    co_await connection.receive([&](const FrameHeader &header, Bytes &&payload) {
+      dispatch(connection, requests, header, std::move(payload));
+    });
+  } catch (...) {
+    error = std::current_exception();
+  }
+  // 对方不再发送请求之后，等已经开始的请求都回复完再关闭
+  co_await requests.drain();
+  try {
+    co_await connection.close();
+  } catch (...) {
+    if (!error) {
+      error = std::current_exception();
+    }
+  }
+  frames.fetch_add(connection.frames_written(), std::memory_order_relaxed);
+  writes.fetch_add(connection.write_calls(), std::memory_order_relaxed);
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+task::Task<void> Server::accept(int listen_fd, std::size_t connections) {
+  co_await executor::switch_to(executor);
+  std::vector<task::Task<void>> serving;
+  while (serving.size() < connections) {
+    auto fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (would_block(errno)) {
+        co_await reactor.readable(listen_fd, &executor);
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(), "accept4");
+    }
+    serving.push_back(serve(fd));
+  }
+  reactor.forget(listen_fd);
+  // 等所有连接都结束，之后抛出第一个异常
+  std::exception_ptr error;
+  for (auto &task : serving) {
+    try {
+      co_await std::move(task);
+    } catch (...) {
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+int listen_tcp(uint16_t port) {
+  auto fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "socket");
+  }
+  int enabled = 1;
+  ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enabled, sizeof(enabled));
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || ::listen(fd, SOMAXCONN) < 0) {
+    auto error = errno;
+    ::close(fd);
+    throw std::system_error(error, std::generic_category(), "listen");
+  }
+  return fd;
+}
+
+uint16_t local_port(int fd) {
+  sockaddr_in address{};
+  socklen_t length = sizeof(address);
+  if (::getsockname(fd, reinterpret_cast<sockaddr *>(&address), &length) < 0) {
+    throw std::system_error(errno, std::generic_category(), "getsockname");
+  }
+  return ntohs(address.sin_port);
+}
+
+int connect_tcp(uint16_t port) {
+  auto fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "socket");
+  }
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+    auto error = errno;
+    ::close(fd);
+    throw std::system_error(error, std::generic_category(), "connect");
+  }
+  return fd;
+}
+
+namespace {
+
+sockaddr_un unix_address(const std::string &path) {
+  sockaddr_un address{};
+  if (path.size() >= sizeof(address.sun_path)) {
+    throw std::invalid_argument("unix socket path too long");
+  }
+  address.sun_family = AF_UNIX;
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  return address;
+}
+
+} // namespace
+
+int listen_unix(const std::string &path) {
+  auto address = unix_address(path);
+  ::unlink(path.c_str());
+  auto fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "socket");
+  }
+  if (::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || ::listen(fd, SOMAXCONN) < 0) {
+    auto error = errno;
+    ::close(fd);
+    throw std::system_error(error, std::generic_category(), "listen");
+  }
+  return fd;
+}
+
+int connect_unix(const std::string &path) {
+  auto address = unix_address(path);
+  auto fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "socket");
+  }
+  if (::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+    auto error = errno;
+    ::close(fd);
+    throw std::system_error(error, std::generic_category(), "connect");
+  }
+  return fd;
+}
+
+namespace {
+
+constexpr uint32_t ECHO = 1;
+constexpr uint32_t FAIL = 2;
+constexpr uint32_t SLOW = 3;
+constexpr int TOTAL_CALLS = 200'000;
+constexpr std::size_t PAYLOAD_SIZE = 64;
+
+task::Task<Bytes> echo(Bytes request) {
+  co_return request;
+}
+
+task::Task<Bytes> fail(Bytes) {
+  throw std::runtime_error("handler failed");
+  co_return Bytes();
+}
+
+// 一个调用方，依次发出 calls 个请求，每个请求收到响应之后再发下一个
+task::Task<void> call_repeatedly(Stub stub, int calls) {
+  Bytes request(PAYLOAD_SIZE, 'x');
+  for (int i = 0; i < calls; i++) {
+    auto response = co_await stub.call(request);
+    if (response != request) {
+      throw std::runtime_error("echo mismatch");
+    }
+  }
+}
+
+task::Task<bool> call_failing(Stub stub) {
+  try {
+    co_await stub.call("x");
+  } catch (RpcError &) {
+    co_return true;
+  }
+  co_return false;
+}
+
+// 截止时间为 timeout 之后，超时返回调用用了多久，截止时间之前收到响应时返回负数
+task::Task<std::chrono::steady_clock::duration> call_with_timeout(Stub stub, std::chrono::steady_clock::duration timeout) {
+  deadline::set_timeout(timeout);
+  auto start = std::chrono::steady_clock::now();
+  try {
+    co_await stub.call("x");
+  } catch (deadline::DeadlineExceeded &) {
+    co_return std::chrono::steady_clock::now() - start;
+  }
+  co_return std::chrono::steady_clock::duration(-1);
+}
+
+// 服务端处理得比调用方的截止时间慢：调用按时失败，之后的调用不受迟到的响应影响
+void deadline_test(int listen_fd, uint16_t port) {
+  using namespace std::chrono_literals;
+  reactor::Reactor reactor;
+  executor::LooperExecutor server_executor;
+  executor::LooperExecutor client_executor;
+  Server server(reactor, server_executor);
+  server.handle(ECHO, echo);
+  server.handle(SLOW, [&server_executor](Bytes request) -> task::Task<Bytes> {
+    co_await deadline::sleep_for(server_executor, 100ms);
+    co_return request;
+  });
+  auto serving = server.accept(listen_fd, 1);
+  Client client(reactor, client_executor, connect_tcp(port));
+
+  auto elapsed = call_with_timeout(Stub{ client, SLOW }, 20ms).get_result();
+  auto in_time = call_with_timeout(Stub{ client, SLOW }, 1s).get_result();
+  auto echoed = call_with_timeout(Stub{ client, ECHO }, 1s).get_result();
+  client.close().get_result();
+  serving.get_result();
+  auto timed_out = elapsed >= 20ms && elapsed < 100ms;
+  std::cout << "call to a 100 ms handler under a 20 ms deadline: DeadlineExceeded after "
+            << std::chrono::duration<double, std::milli>(elapsed).count() << " ms, "
+            << (timed_out && in_time < 0ms && echoed < 0ms ? "correct" : "WRONG") << std::endl;
+  server_executor.shutdown();
+  client_executor.shutdown();
+}
+
+/**
+ * 同一个连接上有 depth 个调用方同时调用，depth 就是连接上同时在途的请求数。
+ * 服务端和客户端各自在一个事件循环线程上，共用一个反应器
+*/
+template <typename Connect>
+void load_test(const char *transport, int listen_fd, Connect &&connect, int depth) {
+  reactor::Reactor reactor;
+  executor::LooperExecutor server_executor;
+  executor::LooperExecutor client_executor;
+  Server server(reactor, server_executor);
+  server.handle(ECHO, echo);
+  server.handle(FAIL, fail);
+  auto serving = server.accept(listen_fd, 1);
+  Client client(reactor, client_executor, connect());
+
+  auto error_reported = call_failing(Stub{ client, FAIL }).get_result();
+  auto start = std::chrono::steady_clock::now();
+  std::vector<task::Task<void>> callers;
+  for (int i = 0; i < depth; i++) {
+    callers.push_back(call_repeatedly(Stub{ client, ECHO }, TOTAL_CALLS / depth));
+  }
+  for (auto &caller : callers) {
+    caller.get_result();
+  }
+  auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  client.close().get_result();
+  serving.get_result();
+  auto &connection = client.connection();
+  std::cout << transport << ", " << depth << " in flight: " << TOTAL_CALLS / seconds / 1e3 << " K calls/s, "
+            << "requests per writev " << static_cast<double>(connection.frames_written()) / connection.write_calls()
+            << ", responses per writev " << static_cast<double>(server.frames_written()) / server.write_calls()
+            << (error_reported ? "" : ", ERROR NOT REPORTED") << std::endl;
+  server_executor.shutdown();
+  client_executor.shutdown();
+}
+
+} // namespace
+
+void Run() {
+  std::cout << "start run rpc" << std::endl;
+  std::cout << "hardware threads: " << std::thread::hardware_concurrency() << ", " << TOTAL_CALLS << " echo calls of "
+            << PAYLOAD_SIZE << " bytes" << std::endl;
+  for (int depth : { 1, 16, 256 }) {
+    auto listen_fd = listen_tcp();
+    auto port = local_port(listen_fd);
+    load_test("tcp 127.0.0.1", listen_fd, [port]() { return connect_tcp(port); }, depth);
+    ::close(listen_fd);
+  }
+  auto path = "/tmp/co_rpc_" + std::to_string(::getpid()) + ".sock";
+  for (int depth : { 1, 16, 256 }) {
+    auto listen_fd = listen_unix(path);
+    load_test("unix socket", listen_fd, [&path]() { return connect_unix(path); }, depth);
+    ::close(listen_fd);
+    ::unlink(path.c_str());
+  }
+  auto listen_fd = listen_tcp();
+  deadline_test(listen_fd, local_port(listen_fd));
+  ::close(listen_fd);
+  std::cout << "end run rpc" << std::endl;
+}
+
+} // namespace rpc
+} // namespace co
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <coroutine>
+#include <exception>
+#include <stdexcept>
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+#include "co_task.h"
+#include "co_reactor.h"
+#include "co_deadline.h"
+#include "co_parallel.h"
+#include "co_executor.h"
+
+namespace co {
+namespace rpc {
+
+// 请求和响应都是不透明的字节串，由调用双方自行编解码
+using Bytes = std::string;
+
+// 一帧的负载上限，超过时认为对方出错，断开连接
+constexpr uint32_t MAX_PAYLOAD_SIZE = 16 << 20;
+
+// 一次 writev 最多提交的帧数
+constexpr std::size_t WRITE_BATCH = 256;
+
+/**
+ * 帧格式（小端）：4 字节负载长度、4 字节 code、8 字节请求 id，之后是负载。
+ * 请求的 code 是方法号，响应的 code 是 Status，响应通过 id 找到对应的请求，
+ * 因此同一个连接上可以同时有任意多个请求，响应的顺序也不必与请求相同
+*/
+struct FrameHeader {
+  static constexpr std::size_t SIZE = 16;
+
+  uint32_t length;
+  uint32_t code;
+  uint64_t id;
+};
+
+enum Status : uint32_t {
+  OK = 0,
+  // 处理函数抛出异常，负载是异常信息
+  FAILED = 1,
+  NO_SUCH_METHOD = 2,
+};
+
+// 服务端返回错误或者连接断开时，call 抛出 RpcError
+struct RpcError : std::runtime_error {
+  using std::runtime_error::runtime_error;
+};
+
+/**
+ * 一个非阻塞的流式连接（TCP 或 Unix 域套接字），读写都在 executor 上通过 reactor 等待。
+ * send 线程安全，只把帧放入队列；写协程在 executor 上被唤醒之后，把这段时间内积累的所有帧
+ * 用一次 writev 发出，所以同一轮事件中产生的多个请求或响应只需要一次系统调用。
+ * 销毁之前需要等待 close 完成，并且 receive 已经返回
+*/
+struct Connection {
+  using FrameHandler = std::function<void(const FrameHeader &, Bytes &&)>;
+
+  // 接管 fd，设置为非阻塞
+  Connection(reactor::Reactor &reactor, executor::AbstractExecutor &executor, int fd);
+  ~Connection();
+
+  Connection(Connection &) = delete;
+  Connection &operator=(Connection &) = delete;
+
+  // 发送一帧，close 之后发送的帧被丢弃
+  void send(uint32_t code, uint64_t id, std::string_view payload);
+
+  /**
+   * 不断读取并解析帧，对每一帧调用 on_frame（在 executor 上），对方关闭连接时返回，
+   * 读取失败或者帧不合法时抛出异常。同一时间只能有一个 receive
+  */
+  task::Task<void> receive(FrameHandler on_frame);
+
+  // 发出队列中剩余的帧之后关闭写方向，写入失败时抛出异常
+  task::Task<void> close();
+
+  // 实际写出的帧数和 writev 调用次数，二者之比就是平均每次批量写出的帧数
+  uint64_t frames_written() const {
+    return frames.load(std::memory_order_relaxed);
+  }
+
+  uint64_t write_calls() const {
+    return writes.load(std::memory_order_relaxed);
+  }
+
+private:
+  // 队列中有帧或者正在关闭时恢复写协程
+  struct WriteSignal {
+    bool await_ready();
+
+    bool await_suspend(std::coroutine_handle<> handle);
+
+    void await_resume() const noexcept {}
+
+    Connection *connection;
+  };
+
+  task::Task<void> write_loop();
+
+  reactor::Reactor &reactor;
+  executor::AbstractExecutor &executor;
+  int fd;
+
+  std::mutex pending_lock;
+  // 已经编码好的帧（帧头和负载连在一起），等待写协程取走
+  std::vector<Bytes> pending;
+  std::coroutine_handle<> writer_waiting;
+  bool closing = false;
+
+  std::optional<task::Task<void>> writer;
+  std::atomic<uint64_t> frames{ 0 };
+  std::atomic<uint64_t> writes{ 0 };
+};
+
+/**
+ * 客户端，一个连接上可以同时有多个调用：co_await client.call(method, request) 返回响应，
+ * 调用在响应到达之后在连接的 executor 上恢复。
+ * 调用遵守创建时协程的截止时间，截止时间先到时在 executor 上恢复并抛出 deadline::DeadlineExceeded，
+ * 之后到达的响应被丢弃
+*/
+struct Client {
+  Client(reactor::Reactor &reactor, executor::AbstractExecutor &executor, int fd);
+  ~Client();
+
+  Client(Client &) = delete;
+  Client &operator=(Client &) = delete;
+
+  struct CallAwaiter {
+    constexpr bool await_ready() const noexcept {
+      return false;
+    }
+
+    // 先登记再发送，响应不会早于登记到达；连接已经断开或者截止时间已过时不挂起，直接抛出异常
+    bool await_suspend(std::coroutine_handle<> handle);
+
+    Bytes await_resume();
+
+    Client *client;
+    uint32_t method;
+    Bytes request;
+    deadline::Clock::time_point deadline;
+    std::coroutine_handle<> handle{};
+    std::optional<Bytes> response{};
+    std::exception_ptr error{};
+  };
+
+  CallAwaiter call(uint32_t method, Bytes request) {
+    return CallAwaiter{ this, method, std::move(request), deadline::current() };
+  }
+
+  /**
+   * 关闭写方向，等服务端回复完已经发出的请求并关闭连接之后返回。
+   * 尚未收到响应的调用抛出 RpcError
+  */
+  task::Task<void> close();
+
+  const Connection &connection() const {
+    return conn;
+  }
+
+private:
+  task::Task<void> read_responses();
+
+  void on_response(const FrameHeader &header, Bytes &&payload);
+
+  // 截止时间已过，调用还没有完成时以 DeadlineExceeded 结束；在反应器线程上执行
+  void expire(uint64_t id);
+
+  // 连接断开，所有尚未完成的调用都以 error 结束
+  void fail_all(std::exception_ptr error);
+
+  // 等待响应的调用，有截止时间时 timer 是反应器上的定时回调
+  struct PendingCall {
+    CallAwaiter *call;
+    std::optional<reactor::Reactor::TimerId> timer;
+  };
+
+  reactor::Reactor &reactor;
+  executor::AbstractExecutor &executor;
+  Connection conn;
+  std::mutex calls_lock;
+  uint64_t next_id = 0;
+  std::unordered_map<uint64_t, PendingCall> calls;
+  std::exception_ptr closed_error;
+  std::optional<task::Task<void>> reader;
+};
+
+// 绑定了方法号的客户端，co_await stub.call(request)
+struct Stub {
+  Client::CallAwaiter call(Bytes request) {
+    return client.call(method, std::move(request));
+  }
+
+  Client &client;
+  uint32_t method;
+};
+
+/**
+ * 服务端：按方法号注册返回 Task<Bytes> 的处理函数，每个请求启动一个 Task，
+ * 完成之后把响应放入连接的发送队列。处理函数同步完成时，同一次读取解析出的所有请求的响应
+ * 会在一次 writev 中发出
+*/
+struct Server {
+  using Handler = std::function<task::Task<Bytes>(Bytes)>;
+
+  Server(reactor::Reactor &reactor, executor::AbstractExecutor &executor) : reactor(reactor), executor(executor) {}
+
+  Server(Server &) = delete;
+  Server &operator=(Server &) = delete;
+
+  // 需要在开始服务之前注册
+  void handle(uint32_t method, Handler &&handler) {
+    handlers[method] = std::move(handler);
+  }
+
+  // 服务一个已经建立的连接，对方关闭并且所有请求都已回复之后返回
+  task::Task<void> serve(int fd);
+
+  // 在非阻塞的监听 fd 上接受 connections 个连接并分别服务，所有连接结束之后返回
+  task::Task<void> accept(int listen_fd, std::size_t connections);
+
+  // 已经结束的连接上写出的帧数和 writev 调用次数
+  uint64_t frames_written() const {
+    return frames.load(std::memory_order_relaxed);
+  }
+
+  uint64_t write_calls() const {
+    return writes.load(std::memory_order_relaxed);
+  }
+
+private:
+  // requests 是这个连接上正在执行的请求
+  void dispatch(Connection &connection, parallel::TaskSet &requests, const FrameHeader &header, Bytes &&payload);
+
+  task::Task<void> run_handler(Connection &connection, Handler &handler, uint64_t id, Bytes request);
+
+  reactor::Reactor &reactor;
+  executor::AbstractExecutor &executor;
+  std::unordered_map<uint32_t, Handler> handlers;
+  std::atomic<uint64_t> frames{ 0 };
+  std::atomic<uint64_t> writes{ 0 };
+};
+
+// 以下函数失败时抛出 std::system_error
+
+// 监听 127.0.0.1:port（0 表示由系统分配），返回非阻塞的监听 fd
+int listen_tcp(uint16_t port = 0);
+
+uint16_t local_port(int fd);
+
+int connect_tcp(uint16_t port);
+
+// 监听 Unix 域套接字，path 已存在时先删除
+int listen_unix(const std::string &path);
+
+int connect_unix(const std::string &path);
+
+void Run();
+
+} // namespace rpc
+} // namespace co
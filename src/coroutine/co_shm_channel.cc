@@ -0,0 +1,300 @@
+#include <cerrno>
+#include <chrono>
+#include <vector>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <system_error>
+#include "co_shm_channel.h"
+
+namespace co {
+namespace shm {
+
+int create_shared_memory(std::size_t size) {
+  auto fd = ::memfd_create("co_shm_channel", MFD_CLOEXEC);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "memfd_create");
+  }
+  if (::ftruncate(fd, static_cast<off_t>(size)) < 0) {
+    auto error = errno;
+    ::close(fd);
+    throw std::system_error(error, std::generic_category(), "ftruncate");
+  }
+  return fd;
+}
+
+void *map_shared(int fd, std::size_t size) {
+  auto address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (address == MAP_FAILED) {
+    throw std::system_error(errno, std::generic_category(), "mmap");
+  }
+  return address;
+}
+
+void unmap_shared(void *address, std::size_t size) {
+  ::munmap(address, size);
+}
+
+int create_event() {
+  auto fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "eventfd");
+  }
+  return fd;
+}
+
+void notify_event(int fd) {
+  uint64_t value = 1;
+  // 计数溢出之前对方一定已经可读，EAGAIN 可以忽略
+  [[maybe_unused]] auto written = ::write(fd, &value, sizeof(value));
+}
+
+void drain_event(int fd) {
+  uint64_t value;
+  [[maybe_unused]] auto count = ::read(fd, &value, sizeof(value));
+}
+
+void close_fd(int fd) {
+  if (fd >= 0) {
+    ::close(fd);
+  }
+}
+
+namespace {
+
+constexpr int ROUND_TRIPS = 100'000;
+constexpr uint64_t MESSAGE_COUNT = 1'000'000;
+constexpr std::size_t CHANNEL_CAPACITY = 1024;
+
+// 一个缓存行大小的消息
+struct Message {
+  uint64_t sequence;
+  int64_t sent_at;
+  char payload[48];
+};
+
+using MessageChannel = ShmChannel<Message>;
+
+int64_t now_nanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+// 在子进程中运行 func，正常返回时退出码为 0
+template <typename Func>
+pid_t spawn(Func &&func) {
+  auto pid = ::fork();
+  if (pid < 0) {
+    throw std::system_error(errno, std::generic_category(), "fork");
+  }
+  if (pid == 0) {
+    try {
+      func();
+      ::_exit(0);
+    } catch (const std::exception &e) {
+      std::cerr << "child failed: " << e.what() << std::endl;
+      ::_exit(1);
+    }
+  }
+  return pid;
+}
+
+bool join(pid_t pid) {
+  int status = 0;
+  ::waitpid(pid, &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+void report_latencies(const char *name, std::vector<int64_t> &latencies) {
+  std::sort(latencies.begin(), latencies.end());
+  int64_t total = 0;
+  for (auto latency : latencies) {
+    total += latency;
+  }
+  std::cout << name << " round trip: avg " << total / static_cast<int64_t>(latencies.size()) / 1000.0 << " us, p50 "
+            << latencies[latencies.size() / 2] / 1000.0 << " us, p99 " << latencies[latencies.size() * 99 / 100] / 1000.0
+            << " us" << std::endl;
+}
+
+void report_throughput(const char *name, double seconds, bool correct) {
+  std::cout << name << " stream: " << MESSAGE_COUNT / seconds / 1e6 << " M messages/s, "
+            << MESSAGE_COUNT * sizeof(Message) / seconds / 1e6 << " MB/s, " << (correct ? "correct" : "WRONG")
+            << std::endl;
+}
+
+uint64_t expected_sum() {
+  return MESSAGE_COUNT * (MESSAGE_COUNT - 1) / 2;
+}
+
+// 子进程：先原样回显 ROUND_TRIPS 条消息，再累加流式消息的序号，发送方关闭之后回复累加结果
+task::Task<void> shm_echo(reactor::Reactor &reactor, MessageChannel &requests, MessageChannel &replies) {
+  for (int i = 0; i < ROUND_TRIPS; i++) {
+    auto request = co_await requests.recv(reactor);
+    auto slot = co_await replies.reserve(reactor);
+    std::memcpy(slot, request, sizeof(Message));
+    requests.consume();
+    replies.publish();
+  }
+  uint64_t sum = 0;
+  while (auto message = co_await requests.recv(reactor)) {
+    sum += message->sequence;
+    requests.consume();
+  }
+  co_await replies.send(reactor, Message{ sum, 0, {} });
+}
+
+task::Task<std::vector<int64_t>> shm_ping(reactor::Reactor &reactor, MessageChannel &requests,
+                                          MessageChannel &replies) {
+  std::vector<int64_t> latencies;
+  latencies.reserve(ROUND_TRIPS);
+  for (int i = 0; i < ROUND_TRIPS; i++) {
+    auto start = now_nanoseconds();
+    co_await requests.send(reactor, Message{ static_cast<uint64_t>(i), start, {} });
+    auto reply = co_await replies.recv(reactor);
+    // 回显的消息必须按顺序原样返回
+    if (!reply || reply->sequence != static_cast<uint64_t>(i)) {
+      throw std::runtime_error("shm round trip got a wrong reply");
+    }
+    replies.consume();
+    latencies.push_back(now_nanoseconds() - start);
+  }
+  co_return latencies;
+}
+
+// 直接在环上构造消息，不经过中间拷贝
+task::Task<uint64_t> shm_stream(reactor::Reactor &reactor, MessageChannel &requests, MessageChannel &replies) {
+  for (uint64_t i = 0; i < MESSAGE_COUNT; i++) {
+    auto slot = co_await requests.reserve(reactor);
+    slot->sequence = i;
+    slot->sent_at = 0;
+    requests.publish();
+  }
+  requests.close();
+  auto result = co_await replies.recv(reactor);
+  auto sum = result->sequence;
+  replies.consume();
+  co_return sum;
+}
+
+void run_shm() {
+  MessageChannel requests(CHANNEL_CAPACITY);
+  MessageChannel replies(CHANNEL_CAPACITY);
+  // 反应器线程不会被 fork 复制，父子进程在 fork 之后各自创建
+  auto child = spawn([&]() {
+    reactor::Reactor reactor;
+    shm_echo(reactor, requests, replies).get_result();
+  });
+  reactor::Reactor reactor;
+  auto latencies = shm_ping(reactor, requests, replies).get_result();
+  report_latencies("shm channel", latencies);
+  auto start = std::chrono::steady_clock::now();
+  auto sum = shm_stream(reactor, requests, replies).get_result();
+  auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  report_throughput("shm channel", seconds, sum == expected_sum());
+  if (!join(child)) {
+    std::cout << "shm channel child failed" << std::endl;
+  }
+}
+
+void write_full(int fd, const void *data, std::size_t size) {
+  auto bytes = static_cast<const char *>(data);
+  while (size > 0) {
+    auto written = ::write(fd, bytes, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(), "write");
+    }
+    bytes += written;
+    size -= written;
+  }
+}
+
+// 对方关闭时返回 false
+bool read_full(int fd, void *data, std::size_t size) {
+  auto bytes = static_cast<char *>(data);
+  while (size > 0) {
+    auto count = ::read(fd, bytes, size);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(), "read");
+    }
+    if (count == 0) {
+      return false;
+    }
+    bytes += count;
+    size -= count;
+  }
+  return true;
+}
+
+// 对照组：同样的两个测试，通过 Unix 域套接字收发，每条消息一次阻塞的系统调用
+void run_socket() {
+  int fds[2];
+  if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+    throw std::system_error(errno, std::generic_category(), "socketpair");
+  }
+  auto child = spawn([&]() {
+    ::close(fds[0]);
+    Message message;
+    for (int i = 0; i < ROUND_TRIPS; i++) {
+      read_full(fds[1], &message, sizeof(message));
+      write_full(fds[1], &message, sizeof(message));
+    }
+    uint64_t sum = 0;
+    while (read_full(fds[1], &message, sizeof(message))) {
+      sum += message.sequence;
+    }
+    message = Message{ sum, 0, {} };
+    write_full(fds[1], &message, sizeof(message));
+  });
+  ::close(fds[1]);
+  std::vector<int64_t> latencies;
+  latencies.reserve(ROUND_TRIPS);
+  Message message{};
+  for (int i = 0; i < ROUND_TRIPS; i++) {
+    auto start = now_nanoseconds();
+    message.sequence = i;
+    message.sent_at = start;
+    write_full(fds[0], &message, sizeof(message));
+    read_full(fds[0], &message, sizeof(message));
+    latencies.push_back(now_nanoseconds() - start);
+  }
+  report_latencies("unix socket", latencies);
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < MESSAGE_COUNT; i++) {
+    message.sequence = i;
+    write_full(fds[0], &message, sizeof(message));
+  }
+  ::shutdown(fds[0], SHUT_WR);
+  auto received = read_full(fds[0], &message, sizeof(message));
+  auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  report_throughput("unix socket", seconds, received && message.sequence == expected_sum());
+  ::close(fds[0]);
+  if (!join(child)) {
+    std::cout << "unix socket child failed" << std::endl;
+  }
+}
+
+} // namespace
+
+void Run() {
+  std::cout << "start run shm channel" << std::endl;
+  std::cout << "hardware threads: " << std::thread::hardware_concurrency() << ", " << sizeof(Message)
+            << " byte messages, " << ROUND_TRIPS << " round trips, " << MESSAGE_COUNT << " streamed" << std::endl;
+  run_shm();
+  run_socket();
+  std::cout << "end run shm channel" << std::endl;
+}
+
+} // namespace shm
+} // namespace co
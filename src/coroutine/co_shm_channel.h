@@ -0,0 +1,299 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <optional>
+#include <stdexcept>
+#include <coroutine>
+#include <type_traits>
+#include "co_task.h"
+#include "co_reactor.h"
+
+namespace co {
+namespace shm {
+
+// 创建匿名共享内存（memfd），大小为 size，失败时抛出 std::system_error
+int create_shared_memory(std::size_t size);
+
+// 以读写、共享的方式映射 fd 的前 size 字节
+void *map_shared(int fd, std::size_t size);
+
+void unmap_shared(void *address, std::size_t size);
+
+// 非阻塞的 eventfd，用于跨进程唤醒
+int create_event();
+
+// 计数加一，使 eventfd 可读
+void notify_event(int fd);
+
+// 读出计数，使 eventfd 不再可读
+void drain_event(int fd);
+
+void close_fd(int fd);
+
+/**
+ * 共享内存开头的控制信息，head 和 tail 分别只由发送方和接收方写入，各占一个缓存行。
+ * 两个等待标记与 head、tail 一起构成先写后读的同步：
+ * 等待方先置位标记、经过 seq_cst 屏障再检查队列，对方先以 seq_cst 更新 head 或 tail 再检查标记，
+ * 所以至少有一方能看到对方的修改
+*/
+struct RingHeader {
+  alignas(64) std::atomic<uint64_t> head{ 0 };
+  alignas(64) std::atomic<uint64_t> tail{ 0 };
+  alignas(64) std::atomic<uint32_t> receiver_waiting{ 0 };
+  std::atomic<uint32_t> sender_waiting{ 0 };
+  std::atomic<uint32_t> closed{ 0 };
+  uint64_t capacity = 0;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory atomics must be lock free");
+
+/**
+ * 跨进程的单生产者单消费者通道，环形队列放在 memfd 共享内存中，通过 eventfd 唤醒对方。
+ * 创建之后 fork，父子进程直接使用同一个对象（fd 和映射都被继承）；
+ * 无关的进程可以通过 Unix socket 传递三个 fd，再用它们构造 ShmChannel。
+ * 接收方拿到的是环上元素的指针，不做拷贝，consume 之后才能被发送方覆盖。
+ * 等待时先检查一次队列，不满足再通过 reactor 挂起，不会阻塞线程
+*/
+template <typename T>
+struct ShmChannel {
+  static_assert(std::is_trivially_copyable_v<T>, "ShmChannel only carries trivially copyable values");
+
+  // capacity 需要是 2 的幂
+  explicit ShmChannel(std::size_t capacity)
+      : memory_fd(create_shared_memory(region_size(checked_capacity(capacity)))), data_fd(create_event()),
+        space_fd(create_event()) {
+    map(region_size(capacity));
+    new (header) RingHeader();
+    header->capacity = capacity;
+    mask = capacity - 1;
+  }
+
+  // 使用其他进程创建的共享内存和 eventfd，接管这些 fd
+  ShmChannel(int memory_fd, int data_fd, int space_fd)
+      : memory_fd(memory_fd), data_fd(data_fd), space_fd(space_fd) {
+    map(sizeof(RingHeader));
+    auto capacity = header->capacity;
+    unmap_shared(header, sizeof(RingHeader));
+    map(region_size(capacity));
+    mask = capacity - 1;
+  }
+
+  ~ShmChannel() {
+    if (header) {
+      unmap_shared(header, mapped_size);
+    }
+    close_fd(memory_fd);
+    close_fd(data_fd);
+    close_fd(space_fd);
+  }
+
+  ShmChannel(ShmChannel &) = delete;
+  ShmChannel &operator=(ShmChannel &) = delete;
+
+  int shared_memory_fd() const {
+    return memory_fd;
+  }
+
+  int data_event_fd() const {
+    return data_fd;
+  }
+
+  int space_event_fd() const {
+    return space_fd;
+  }
+
+  // 发送方：取得下一个可写的位置，队列满时返回空
+  T *try_reserve() {
+    auto head = header->head.load(std::memory_order_relaxed);
+    if (head - cached_tail > mask) {
+      cached_tail = header->tail.load(std::memory_order_acquire);
+      if (head - cached_tail > mask) {
+        return nullptr;
+      }
+    }
+    return &slots[head & mask];
+  }
+
+  // 发送方：发布 reserve 得到的位置
+  void publish() {
+    header->head.store(header->head.load(std::memory_order_relaxed) + 1, std::memory_order_seq_cst);
+    if (header->receiver_waiting.load(std::memory_order_seq_cst)) {
+      notify_event(data_fd);
+    }
+  }
+
+  // 发送方：co_await reserve(reactor) 返回可写的位置，写入之后调用 publish
+  auto reserve(reactor::Reactor &reactor) {
+    return SpaceAwaiter{ this, &reactor };
+  }
+
+  // 发送方：复制 value 并发布
+  task::Task<void> send(reactor::Reactor &reactor, const T &value) {
+    *co_await reserve(reactor) = value;
+    publish();
+  }
+
+  // 发送方：不再发送，接收方取完队列中剩余的元素之后 recv 返回空
+  void close() {
+    header->closed.store(1, std::memory_order_seq_cst);
+    notify_event(data_fd);
+  }
+
+  // 接收方：取得队首元素，队列为空时返回空
+  const T *try_recv() {
+    auto tail = header->tail.load(std::memory_order_relaxed);
+    if (tail == cached_head) {
+      cached_head = header->head.load(std::memory_order_acquire);
+      if (tail == cached_head) {
+        return nullptr;
+      }
+    }
+    return &slots[tail & mask];
+  }
+
+  // 接收方：释放 recv 得到的元素
+  void consume() {
+    header->tail.store(header->tail.load(std::memory_order_relaxed) + 1, std::memory_order_seq_cst);
+    if (header->sender_waiting.load(std::memory_order_seq_cst)) {
+      notify_event(space_fd);
+    }
+  }
+
+  /**
+   * 接收方：co_await recv(reactor) 返回队首元素的指针，用完之后调用 consume；
+   * 发送方已经关闭并且队列为空时返回空
+  */
+  auto recv(reactor::Reactor &reactor) {
+    return DataAwaiter{ this, &reactor };
+  }
+
+private:
+  /**
+   * 队列为空（或满）时，由一个 Task 在 reactor 上等待对方的 eventfd，
+   * 它完成之后恢复等待者，与 TaskAwaiter 的做法相同
+  */
+  struct DataAwaiter {
+    bool await_ready() {
+      item = channel->try_recv();
+      return item || channel->header->closed.load(std::memory_order_acquire);
+    }
+
+    // 等待的 Task 同步完成时不挂起，否则在 finally 中恢复会销毁仍在栈上的等待体
+    bool await_suspend(std::coroutine_handle<> handle) {
+      waiting.emplace(channel->wait_for_data(*reactor));
+      if (waiting->handle.promise().is_completed()) {
+        return false;
+      }
+      waiting->finally([handle]() { handle.resume(); });
+      return true;
+    }
+
+    const T *await_resume() {
+      return item ? item : channel->try_recv();
+    }
+
+    ShmChannel *channel;
+    reactor::Reactor *reactor;
+    const T *item = nullptr;
+    std::optional<task::Task<void>> waiting{};
+  };
+
+  struct SpaceAwaiter {
+    bool await_ready() {
+      slot = channel->try_reserve();
+      return slot != nullptr;
+    }
+
+    // 等待的 Task 同步完成时不挂起，否则在 finally 中恢复会销毁仍在栈上的等待体
+    bool await_suspend(std::coroutine_handle<> handle) {
+      waiting.emplace(channel->wait_for_space(*reactor));
+      if (waiting->handle.promise().is_completed()) {
+        return false;
+      }
+      waiting->finally([handle]() { handle.resume(); });
+      return true;
+    }
+
+    T *await_resume() {
+      return slot ? slot : channel->try_reserve();
+    }
+
+    ShmChannel *channel;
+    reactor::Reactor *reactor;
+    T *slot = nullptr;
+    std::optional<task::Task<void>> waiting{};
+  };
+
+  // 被唤醒时队列不一定有数据（eventfd 可能是之前的通知），重新检查，必要时再次等待
+  task::Task<void> wait_for_data(reactor::Reactor &reactor) {
+    while (true) {
+      header->receiver_waiting.store(1, std::memory_order_seq_cst);
+      // 下面用 acquire 读取 head / tail，屏障保证读取不会早于上面的写入，否则双方可能都看到旧值而不再唤醒
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (try_recv() || header->closed.load(std::memory_order_seq_cst)) {
+        break;
+      }
+      co_await reactor.readable(data_fd);
+      drain_event(data_fd);
+    }
+    header->receiver_waiting.store(0, std::memory_order_relaxed);
+  }
+
+  task::Task<void> wait_for_space(reactor::Reactor &reactor) {
+    while (true) {
+      header->sender_waiting.store(1, std::memory_order_seq_cst);
+      // 下面用 acquire 读取 head / tail，屏障保证读取不会早于上面的写入，否则双方可能都看到旧值而不再唤醒
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (try_reserve()) {
+        break;
+      }
+      co_await reactor.readable(space_fd);
+      drain_event(space_fd);
+    }
+    header->sender_waiting.store(0, std::memory_order_relaxed);
+  }
+
+  // 在创建任何 fd 之前检查，构造函数抛出异常时不会执行析构函数
+  static std::size_t checked_capacity(std::size_t capacity) {
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+      throw std::invalid_argument("shm channel capacity must be a power of 2");
+    }
+    return capacity;
+  }
+
+  static std::size_t slots_offset() {
+    return (sizeof(RingHeader) + alignof(T) - 1) / alignof(T) * alignof(T);
+  }
+
+  static std::size_t region_size(std::size_t capacity) {
+    return slots_offset() + capacity * sizeof(T);
+  }
+
+  void map(std::size_t size) {
+    auto address = static_cast<char *>(map_shared(memory_fd, size));
+    header = reinterpret_cast<RingHeader *>(address);
+    slots = reinterpret_cast<T *>(address + slots_offset());
+    mapped_size = size;
+  }
+
+  int memory_fd;
+  int data_fd;
+  int space_fd;
+  RingHeader *header = nullptr;
+  T *slots = nullptr;
+  std::size_t mapped_size = 0;
+  uint64_t mask = 0;
+
+  // 发送方缓存的 tail 和接收方缓存的 head，减少对另一方缓存行的读取
+  uint64_t cached_tail = 0;
+  uint64_t cached_head = 0;
+};
+
+void Run();
+
+} // namespace shm
+} // namespace co
@@ -1,7 +1,469 @@
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <utility>
+#include <optional>
+#include <coroutine>
+#include <iostream>
+#include <type_traits>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+#include "co_log.h"
+#include "co_local.h"
+#include "co_budget.h"
+#include "co_continuation.h"
+
 namespace co {
 namespace task {
 
-  void Run();
+template <typename R>
+struct TaskPromise;
+
+/**
+ * 协程任务结果，描述 Task 正常返回的结果和抛出的异常，需定义一个持有二者的类型
+*/
+template <typename T>
+struct TaskResult {
+  // 初始化为默认值
+  explicit TaskResult() = default;
+
+  // 当 Task 正常返回时用结果初始化 Result
+  explicit TaskResult(T &&t) : _value(std::move(t)) {}
+
+  // 当 Task 抛异常时用异常初始化 Result
+  explicit TaskResult(std::exception_ptr &&ptr) : _exception_ptr(ptr) {}
+
+  // 读取结果，有异常则抛出异常
+  T get_or_throw() {
+    if (_exception_ptr) {
+      std::rethrow_exception(_exception_ptr);
+    }
+    return _value;
+  }
+
+private:
+  T _value{};
+  std::exception_ptr _exception_ptr;
+};
+
+// 没有返回值的 Task 只需要记录异常
+template <>
+struct TaskResult<void> {
+  explicit TaskResult() = default;
+
+  explicit TaskResult(std::exception_ptr &&ptr) : _exception_ptr(ptr) {}
+
+  void get_or_throw() {
+    if (_exception_ptr) {
+      std::rethrow_exception(_exception_ptr);
+    }
+  }
+
+private:
+  std::exception_ptr _exception_ptr;
+};
+
+// then 的函数参数为 Task 的结果，没有返回值的 Task 对应的函数没有参数
+template <typename F, typename R>
+struct ThenResult {
+  using type = std::invoke_result_t<F &, R>;
+};
+
+template <typename F>
+struct ThenResult<F, void> {
+  using type = std::invoke_result_t<F &>;
+};
+
+template <typename R, typename F>
+struct Then;
+
+/**
+ * 协程任务，定义比较简单，能力多都是通过 promise_type 来实现的
+*/
+template <typename R>
+struct Task {
+  // 声明 promise_type 为 TaskPromise 类型
+  using promise_type = TaskPromise<R>;
+
+  R get_result() {
+    CO_LOG("[" << &(handle.promise()) << "]" << "task get result");
+    return handle.promise().get_result();
+  }
+
+  /**
+   * std::move(task).then(f) 返回 Then，可以继续 then，co_await 它或者转换为 Task<f 的返回值类型>，
+   * 见 Then 的说明
+  */
+  template <typename F>
+  [[nodiscard]] Then<R, std::decay_t<F>> then(F &&func) && {
+    CO_LOG("[" << &(handle.promise()) << "]" << "task then");
+    return Then<R, std::decay_t<F>>(std::move(*this), std::forward<F>(func));
+  }
+
+  Task &catching(std::function<void(std::exception &)> && func) {
+    CO_LOG("[" << &(handle.promise()) << "]" << "task catching");
+    handle.promise().on_completed([func, promise = &handle.promise()](auto result) {
+      CO_LOG("[" << promise << "]" << "task catching on completed");
+      try {
+        result.get_or_throw();
+      } catch(std::exception& e) {
+        func(e);
+      }
+    });
+    return *this;
+  }
+
+  Task &finally(std::function<void()> &&func) {
+    CO_LOG("[" << &(handle.promise()) << "]" << "task finally");
+    handle.promise().on_completed([func, promise = &handle.promise()](auto) {
+      CO_LOG("[" << promise << "]" << "task finally on completed");
+      func();
+    });
+    return *this;
+  }
+
+  explicit Task(std::coroutine_handle<promise_type> handle) noexcept: handle(handle) {}
+  Task(Task &&task) noexcept: handle(std::exchange(task.handle, {})) {}
+  Task(Task &) = delete;
+  Task &operator=(Task &) = delete;
+  ~Task() {
+    if (handle) {
+      handle.destroy();
+    }
+  }
+
+public:
+  std::coroutine_handle<promise_type> handle;
+};
+
+/**
+ * 协程任务等待体，通过 await_transform 将 task 转化为 awaiter
+*/
+template <typename R>
+struct TaskAwaiter {
+  // 被等待的 Task 已经执行完时不需要挂起，但要消耗一次预算，预算用完时仍然挂起
+  bool await_ready() noexcept {
+    CO_LOG("[" << &(task.handle.promise()) << "]" << "task await ready");
+    completed = task.handle.promise().is_completed();
+    return completed && budget::consume();
+  }
+
+  /**
+   * 当 task 执行完之后恢复等待方，等待方的返回值类型不必与 task 相同；因为预算挂起时重新排队。
+   * 按 continuation::resume 的策略恢复：等待方有自己的执行器时在它上面恢复，
+   * 完成 task 的线程已经在这个执行器上时直接恢复，连锁恢复过深时改为排队
+  */
+  template <typename Promise>
+  void await_suspend(std::coroutine_handle<Promise> handle) {
+    CO_LOG("[" << handle.address() << "]" << "task await suspend");
+    if (completed) {
+      budget::reschedule(handle);
+      return;
+    }
+    task.finally([handle, executor = handle.promise().get_executor()]() {
+      CO_LOG("[" << handle.address() << "]" << "task await suspend finally");
+      continuation::resume(handle, executor);
+    });
+  }
+
+  // 协程恢复执行时，被等待的 Task 已经执行完，调用 get_result 来获取结果
+  R await_resume() {
+    CO_LOG("[" << &(task.handle.promise()) << "]" << "task await resume");
+    return task.get_result();
+  }
+
+  explicit TaskAwaiter(Task<R> &&task) noexcept : task(std::move(task)) {}
+  TaskAwaiter(TaskAwaiter &) = delete;
+  TaskAwaiter &operator=(TaskAwaiter &) = delete;
+
+private:
+  Task<R> task;
+  bool completed = false;
+};
+
+/**
+ * Task 的后续计算：保存被等待的 Task 和要对结果调用的函数，不分配 std::function，也不创建协程。
+ * 再次 then 时把两个函数组合成一个，因此不论连续 then 多少次，
+ * co_await 它只等待一次 Task，恢复之后直接依次调用各个函数，开销与手写的 co_await 加函数调用相同；
+ * 转换为 Task 时只创建一个协程。Task 或者任何一个函数抛出的异常都交给等待方
+*/
+template <typename R, typename F>
+struct Then {
+  using Result = typename ThenResult<F, R>::type;
+
+  Then(Task<R> &&task, F &&func) : task(std::move(task)), func(std::move(func)) {}
+  Then(Task<R> &&task, const F &func) : task(std::move(task)), func(func) {}
+  // 还没有被等待时可以移动
+  Then(Then &&other) : task(std::move(other.task)), func(std::move(other.func)) {}
+  Then(Then &) = delete;
+  Then &operator=(Then &) = delete;
+
+  template <typename G>
+  [[nodiscard]] auto then(G &&next) && {
+    auto composed = [func = std::move(func), next = std::forward<G>(next)](auto &&...value) mutable {
+      if constexpr (std::is_void_v<std::invoke_result_t<F &, decltype(value)...>>) {
+        std::invoke(func, std::forward<decltype(value)>(value)...);
+        return std::invoke(next);
+      } else {
+        return std::invoke(next, std::invoke(func, std::forward<decltype(value)>(value)...));
+      }
+    };
+    return Then<R, decltype(composed)>(std::move(task), std::move(composed));
+  }
+
+  // 只创建一个协程，依次执行所有的函数
+  operator Task<Result>() && {
+    return run(std::move(*this));
+  }
+
+  // 直接 co_await 时借用 TaskAwaiter 等待被等待的 Task
+  bool await_ready() {
+    awaiter.emplace(std::move(task));
+    return awaiter->await_ready();
+  }
+
+  template <typename Promise>
+  void await_suspend(std::coroutine_handle<Promise> handle) {
+    awaiter->await_suspend(handle);
+  }
+
+  Result await_resume() {
+    if constexpr (std::is_void_v<R>) {
+      awaiter->await_resume();
+      return std::invoke(func);
+    } else {
+      return std::invoke(func, awaiter->await_resume());
+    }
+  }
+
+private:
+  static Task<Result> run(Then pending) {
+    co_return co_await std::move(pending);
+  }
+
+  Task<R> task;
+  F func;
+  std::optional<TaskAwaiter<R>> awaiter;
+};
+
+/**
+ * Task 中所有的 co_await 都经过这一层：挂起之前把当前线程的局部存储还原为恢复这个协程之前的值，
+ * 恢复时再换成这个协程的，协程无论在哪个线程上恢复都能读到自己的 local::Slot。
+ * 没有挂起时不切换
+*/
+template <typename Awaiter>
+struct LocalAwaiter {
+  bool await_ready() {
+    return awaiter.await_ready();
+  }
+
+  /**
+   * 先还原再交给被包装的等待体，它可能立即在其他线程上恢复这个协程。
+   * 被包装的 await_suspend 返回 false 时协程不挂起，接着调用 await_resume，由它重新换回这个协程的存储；
+   * 抛出异常时 await_resume 不会被调用，协程直接在当前线程上继续，需要在这里换回
+  */
+  template <typename Promise>
+  decltype(auto) await_suspend(std::coroutine_handle<Promise> handle) {
+    suspended = true;
+    storage.leave();
+    try {
+      return awaiter.await_suspend(handle);
+    } catch (...) {
+      suspended = false;
+      storage.enter();
+      throw;
+    }
+  }
+
+  decltype(auto) await_resume() {
+    if (suspended) {
+      storage.enter();
+    }
+    return awaiter.await_resume();
+  }
+
+  Awaiter awaiter;
+  local::Storage &storage;
+  bool suspended = false;
+};
+
+/**
+ * co_return value 和 co_return 分别需要 return_value 和 return_void，不能同时定义，
+ * 因此按返回值类型放在基类里，结果最终都交给 TaskPromise::set_result
+*/
+template <typename Promise, typename R>
+struct TaskReturn {
+  // 将返回值存入 result，对应于协程内部的 'co_return value'
+  void return_value(R value) {
+    CO_LOG("[" << this << "]" << "task return value");
+    static_cast<Promise *>(this)->set_result(TaskResult<R>(std::move(value)));
+  }
+};
+
+template <typename Promise>
+struct TaskReturn<Promise, void> {
+  // 对应于协程内部的 'co_return' 或者执行到函数末尾
+  void return_void() {
+    CO_LOG("[" << this << "]" << "task return void");
+    static_cast<Promise *>(this)->set_result(TaskResult<void>());
+  }
+};
+
+/**
+ * promise_type 是连接协程内外的桥梁，想要拿到什么，找 promise_type 要
+ * promise_type 可通过 std::coroutine_handle 的 promise 获取
+ * promise_type 可通过 std::coroutine_handle 的 from_promise 转化为 std::coroutine_handle
+*/
+template <typename R>
+struct TaskPromise : TaskReturn<TaskPromise<R>, R> {
+  /**
+   * 协程执行到 final_suspend 时才通知完成：此时协程已经挂起，回调里销毁 Task 是安全的；
+   * 回调在锁外执行，回调中再访问同一个 Task 也不会死锁
+  */
+  struct FinalAwaiter {
+    constexpr bool await_ready() const noexcept {
+      return false;
+    }
+
+    // 回调会恢复等待方，先还原局部存储
+    void await_suspend(std::coroutine_handle<TaskPromise> handle) noexcept {
+      handle.promise().storage.leave();
+      handle.promise().notify_callbacks();
+    }
+
+    constexpr void await_resume() const noexcept {}
+  };
+
+  // 协程立即执行，不进行挂起，开始执行时切换到自己的局部存储
+  struct InitialAwaiter {
+    constexpr bool await_ready() const noexcept {
+      return true;
+    }
+
+    constexpr void await_suspend(std::coroutine_handle<>) const noexcept {}
+
+    void await_resume() noexcept {
+      storage.enter();
+    }
+
+    local::Storage &storage;
+  };
+
+  InitialAwaiter initial_suspend() {
+    CO_LOG("[" << this << "]" << "task initial suspend");
+    return { storage };
+  }
+
+  // 执行结束后挂起，等待外部（task.handle.destroy()）销毁
+  FinalAwaiter final_suspend() noexcept {
+    CO_LOG("[" << this << "]" << "task final suspend");
+    return {};
+  }
+
+  // 构造协程的返回值对象 Task
+  Task<R> get_return_object() {
+    CO_LOG("[" << this << "]" << "task get return object");
+    return Task{ std::coroutine_handle<TaskPromise>::from_promise(*this) };
+  }
+
+  // 将异常存入 result，等到 final_suspend 再通知
+  void unhandled_exception() {
+    CO_LOG("[" << this << "]" << "task unhandled exception");
+    std::lock_guard lock(completion_lock);
+    result = TaskResult<R>(std::current_exception());
+  }
+
+  // 由 TaskReturn 调用，保存结果，等到 final_suspend 再通知
+  void set_result(TaskResult<R> &&value) {
+    std::lock_guard lock(completion_lock);
+    result = std::move(value);
+  }
+
+  // co_await Task 时转化为 TaskAwaiter
+  template <typename _R>
+  LocalAwaiter<TaskAwaiter<_R>> await_transform(Task<_R> &&task) {
+    return { TaskAwaiter<_R>(std::move(task)), storage };
+  }
+
+  // 其他等待体只包装一层，等待体本身在 co_await 表达式结束之前一直有效，保存引用即可
+  template <typename Awaiter>
+  LocalAwaiter<Awaiter &> await_transform(Awaiter &&awaiter) {
+    return { awaiter, storage };
+  }
+
+  R get_result() {
+    CO_LOG("[" << this << "]" << "task get result");
+    std::unique_lock lock(completion_lock);
+    // 如果协程还没有运行完，等待 final_suspend 中调用 notify_all
+    completion.wait(lock, [this]() { return completed; });
+    // 如果有值，则直接返回（或者抛出异常）
+    return result->get_or_throw();
+  }
+
+  void on_completed(std::function<void(TaskResult<R>)> &&func) {
+    CO_LOG("[" << this << "]" << "task on completed");
+    std::unique_lock lock(completion_lock);
+    if (completed) { // 协程已经执行完
+      auto value = result.value();
+      lock.unlock(); // 解锁之后再调用 func
+      func(value);
+    } else { // 否则添加回调函数，等待调用
+      completion_callbacks.push_back(std::move(func));
+    }
+  }
+
+  bool is_completed() {
+    std::lock_guard lock(completion_lock);
+    return completed;
+  }
+
+  // 协程所属的执行器，为空时在完成被等待 Task 的线程上直接恢复
+  executor::AbstractExecutor *get_executor() const {
+    return home_executor;
+  }
+
+  // 只在协程自己执行时调用，例如 resume_on
+  void set_executor(executor::AbstractExecutor *executor) {
+    home_executor = executor;
+  }
+
+private:
+  void notify_callbacks() {
+    std::unique_lock lock(completion_lock);
+    completed = true;
+    auto value = result.value();
+    auto callbacks = std::move(completion_callbacks);
+    // 通知 get_result 当中的 wait
+    completion.notify_all();
+    lock.unlock();
+    // 回调中可能销毁 Task，从这里开始不能再访问 promise 的成员
+    for (auto &callback : callbacks) {
+      callback(value);
+    }
+  }
+
+private:
+  // 使用 std::optional 可以区分协程是否返回了结果
+  std::optional<TaskResult<R>> result;
+  // 协程已经执行到 final_suspend，回调都已取出
+  bool completed = false;
+
+  std::mutex completion_lock;
+  std::condition_variable completion;
+
+  // 回调列表，我们允许对同一个 Task 添加多个回调
+  std::list<std::function<void(TaskResult<R>)>> completion_callbacks;
+
+  // 协程局部存储，创建时继承创建它的协程的值
+  local::Storage storage;
+
+  // 创建时为当前线程正在执行的执行器
+  executor::AbstractExecutor *home_executor = budget::current_executor();
+};
+
+void Run();
 
 } // namespace task
 } // naemspace co
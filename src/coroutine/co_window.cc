@@ -0,0 +1,384 @@
+#include <cmath>
+#include <deque>
+#include <chrono>
+#include <numeric>
+#include <vector>
+#include <utility>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include "co_window.h"
+
+namespace co {
+namespace window {
+
+namespace {
+
+const double GAMMA = (1 + QuantileSketch::RELATIVE_ACCURACY) / (1 - QuantileSketch::RELATIVE_ACCURACY);
+const double LOG_GAMMA = std::log(GAMMA);
+
+// 向负无穷取整的除法，负的时间戳也能落到正确的 pane
+int64_t floor_div(int64_t value, int64_t divisor) {
+  auto quotient = value / divisor;
+  return quotient - (value % divisor < 0);
+}
+
+} // namespace
+
+void QuantileSketch::add(double value) {
+  if (buckets.empty()) {
+    buckets.assign(BUCKET_COUNT, 0);
+  }
+  int index = 0;
+  if (value > 0) {
+    index = std::clamp(static_cast<int>(std::ceil(std::log(value) / LOG_GAMMA)) + OFFSET, 0, BUCKET_COUNT - 1);
+  }
+  buckets[index]++;
+  count++;
+}
+
+void QuantileSketch::merge(const QuantileSketch &other) {
+  if (other.count == 0) {
+    return;
+  }
+  if (buckets.empty()) {
+    buckets = other.buckets;
+  } else {
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+      buckets[i] += other.buckets[i];
+    }
+  }
+  count += other.count;
+}
+
+double QuantileSketch::quantile(double q) const {
+  if (count == 0) {
+    return 0;
+  }
+  auto rank = static_cast<uint64_t>(std::clamp(q, 0.0, 1.0) * (count - 1));
+  uint64_t seen = 0;
+  for (int i = 0; i < BUCKET_COUNT; i++) {
+    seen += buckets[i];
+    if (seen > rank) {
+      // 桶 (gamma^(i-1), gamma^i] 中相对误差最小的代表值
+      return 2 * std::pow(GAMMA, i - OFFSET) / (GAMMA + 1);
+    }
+  }
+  return 0;
+}
+
+void QuantileSketch::clear() {
+  std::fill(buckets.begin(), buckets.end(), 0);
+  count = 0;
+}
+
+void Aggregate::add(double value) {
+  count++;
+  sum += value;
+  min = std::min(min, value);
+  max = std::max(max, value);
+  sketch.add(value);
+}
+
+void Aggregate::merge(const Aggregate &other) {
+  count += other.count;
+  sum += other.sum;
+  min = std::min(min, other.min);
+  max = std::max(max, other.max);
+  sketch.merge(other.sketch);
+}
+
+void Aggregate::clear() {
+  count = 0;
+  sum = 0;
+  min = std::numeric_limits<double>::infinity();
+  max = -std::numeric_limits<double>::infinity();
+  sketch.clear();
+}
+
+/**
+ * 双栈实现的聚合队列，最早进入的元素在队首：
+ * 新元素压入 back 栈，同时维护 back 栈所有元素的聚合；
+ * front 栈的每一项保存自己和它下面（更晚进入）所有元素的聚合，栈顶就是整个 front 栈的聚合。
+ * 出队时 front 栈为空则把 back 栈整体倒过来，每个元素最多被倒一次，因此均摊 O(1)
+*/
+struct TwoStackQueue {
+  void push(Aggregate &&aggregate) {
+    back_aggregate.merge(aggregate);
+    back.push_back(std::move(aggregate));
+  }
+
+  void pop() {
+    if (front.empty()) {
+      // 从最新的元素开始，依次累积到更早的元素上
+      while (!back.empty()) {
+        auto aggregate = std::move(back.back());
+        back.pop_back();
+        if (!front.empty()) {
+          aggregate.merge(front.back());
+        }
+        front.push_back(std::move(aggregate));
+      }
+      back_aggregate.clear();
+    }
+    front.pop_back();
+  }
+
+  void clear() {
+    front.clear();
+    back.clear();
+    back_aggregate.clear();
+  }
+
+  // 整个队列的聚合
+  void query(Aggregate &output) const {
+    output.clear();
+    if (!front.empty()) {
+      output.merge(front.back());
+    }
+    output.merge(back_aggregate);
+  }
+
+private:
+  std::vector<Aggregate> front;
+  std::vector<Aggregate> back;
+  Aggregate back_aggregate;
+};
+
+generator::Generator<const Window &> tumbling_window(generator::Generator<Event> events, int64_t size) {
+  return sliding_window(std::move(events), size, size);
+}
+
+generator::Generator<const Window &> sliding_window(generator::Generator<Event> events, int64_t size, int64_t slide) {
+  if (size <= 0 || slide <= 0) {
+    throw std::invalid_argument("window size and slide must be positive");
+  }
+  auto pane_size = std::gcd(size, slide);
+  auto panes_per_window = size / pane_size;
+  auto panes_per_slide = slide / pane_size;
+
+  TwoStackQueue panes;
+  // 队列中最早的 pane 和正在接收事件的 pane 的编号
+  int64_t first_pane = 0;
+  int64_t current_pane = 0;
+  Aggregate current;
+  Window output;
+  bool started = false;
+
+  // 关闭当前的 pane，如果它是某个窗口的最后一个 pane，返回 true
+  auto close_pane = [&]() {
+    panes.push(std::move(current));
+    current = Aggregate{};
+    current_pane++;
+    if (current_pane % panes_per_slide != 0) {
+      return false;
+    }
+    // 窗口由 [current_pane - panes_per_window, current_pane) 组成，更早的 pane 出队
+    while (first_pane < current_pane - panes_per_window) {
+      panes.pop();
+      first_pane++;
+    }
+    output.start = (current_pane - panes_per_window) * pane_size;
+    output.end = current_pane * pane_size;
+    panes.query(output.aggregate);
+    return output.aggregate.count > 0;
+  };
+
+  for (auto event : events) {
+    auto pane = floor_div(event.timestamp, pane_size);
+    if (!started) {
+      started = true;
+      first_pane = current_pane = pane;
+    }
+    if (pane < current_pane) {
+      continue;
+    }
+    // 中间隔了超过一个窗口的空白：先产出包含当前 pane 的窗口，之后的空 pane 都不会出现在有事件的窗口里，
+    // 直接跳到包含新事件的最早窗口的起点（按 slide 对齐），跳过的 pane 不逐个关闭
+    if (pane - current_pane > panes_per_window) {
+      auto last_pane = current_pane;
+      while (current_pane < last_pane + panes_per_window) {
+        if (close_pane()) {
+          co_yield output;
+        }
+      }
+      auto target = floor_div(pane - panes_per_window, panes_per_slide) * panes_per_slide;
+      if (target > current_pane) {
+        panes.clear();
+        first_pane = current_pane = target;
+      }
+    }
+    while (current_pane < pane) {
+      if (close_pane()) {
+        co_yield output;
+      }
+    }
+    current.add(event.value);
+  }
+
+  // 输入结束，继续关闭 pane，直到包含最后一个 pane 的窗口都已产出
+  if (started) {
+    auto last_pane = current_pane;
+    while (current_pane < last_pane + panes_per_window) {
+      if (close_pane()) {
+        co_yield output;
+      }
+    }
+  }
+}
+
+generator::Generator<const Window &> recompute_window(generator::Generator<Event> events, int64_t size,
+                                                      int64_t slide) {
+  std::deque<Event> buffer;
+  Window output;
+  bool started = false;
+  int64_t end = 0;
+
+  // 产出以 end 结尾的窗口，窗口开始之前的事件不会再用到
+  auto compute = [&]() {
+    output.start = end - size;
+    output.end = end;
+    output.aggregate.clear();
+    while (!buffer.empty() && buffer.front().timestamp < output.start + slide) {
+      if (buffer.front().timestamp >= output.start) {
+        output.aggregate.add(buffer.front().value);
+      }
+      buffer.pop_front();
+    }
+    for (auto &event : buffer) {
+      if (event.timestamp >= end) {
+        break;
+      }
+      output.aggregate.add(event.value);
+    }
+    end += slide;
+    return output.aggregate.count > 0;
+  };
+
+  for (auto event : events) {
+    if (!started) {
+      started = true;
+      end = (floor_div(event.timestamp, slide) + 1) * slide;
+    }
+    while (event.timestamp >= end) {
+      if (compute()) {
+        co_yield output;
+      }
+    }
+    buffer.push_back(event);
+  }
+  while (!buffer.empty()) {
+    if (compute()) {
+      co_yield output;
+    }
+  }
+}
+
+// 每秒 100k 个事件，值在 [1, 1000] 之间
+generator::Generator<Event> events(uint64_t count) {
+  uint64_t state = 88172645463325252ULL;
+  for (uint64_t i = 0; i < count; i++) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    co_yield Event{ static_cast<int64_t>(i / 100), 1 + (state % 9990) / 10.0 };
+  }
+}
+
+// 几段事件之间隔着长短不一的空白，包括长于窗口、不是 slide 整数倍的空白
+generator::Generator<Event> gapped_events() {
+  int64_t timestamp = 0;
+  for (int64_t gap : { 0, 500, 2'999, 3'001, 7'250, 100'000, 1'000'000 }) {
+    timestamp += gap;
+    for (int i = 0; i < 1000; i++) {
+      co_yield Event{ timestamp + i * 3, static_cast<double>(1 + i % 97) };
+    }
+    timestamp += 3000;
+  }
+}
+
+generator::Generator<Event> huge_gap_events(int64_t gap) {
+  co_yield Event{ 0, 1 };
+  co_yield Event{ gap, 2 };
+}
+
+// 逐个比较两种实现产出的窗口，打印不一致的个数
+void verify(const char *name, generator::Generator<const Window &> actual,
+            generator::Generator<const Window &> expected) {
+  std::size_t windows = 0;
+  std::size_t mismatches = 0;
+  for (const Window &window : actual) {
+    windows++;
+    if (!expected.has_next()) {
+      mismatches++;
+      continue;
+    }
+    const Window &other = expected.next();
+    if (window.start != other.start || window.aggregate.count != other.aggregate.count ||
+        window.aggregate.min != other.aggregate.min || window.aggregate.max != other.aggregate.max ||
+        window.aggregate.quantile(0.5) != other.aggregate.quantile(0.5) ||
+        std::abs(window.aggregate.sum - other.aggregate.sum) > 1e-6 * other.aggregate.sum) {
+      mismatches++;
+    }
+  }
+  mismatches += expected.has_next();
+  std::cout << name << ": " << windows << " windows, " << mismatches << " mismatches" << std::endl;
+}
+
+template <typename Func>
+void benchmark(const char *name, uint64_t count, Func &&func) {
+  auto start = std::chrono::steady_clock::now();
+  std::size_t windows = 0;
+  Window last;
+  for (const Window &window : func()) {
+    windows++;
+    last = window;
+  }
+  auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << name << ": " << count / seconds / 1e6 << " M events/s, " << windows << " windows, last [" << last.start
+            << ", " << last.end << ") count " << last.aggregate.count << " mean "
+            << last.aggregate.sum / last.aggregate.count << " min " << last.aggregate.min << " max "
+            << last.aggregate.max << " p50 " << last.aggregate.quantile(0.5) << " p99 " << last.aggregate.quantile(0.99)
+            << std::endl;
+}
+
+void Run() {
+  std::cout << "start run window" << std::endl;
+  constexpr uint64_t EVENT_COUNT = 10'000'000;
+  constexpr int64_t SECOND = 1000;
+  constexpr int64_t MINUTE = 60 * SECOND;
+
+  // 先用较小的输入确认两种实现的结果一致，包括事件之间有长空白的情况
+  verify("verify sliding window", sliding_window(events(1'000'000), 3 * SECOND, SECOND),
+         recompute_window(events(1'000'000), 3 * SECOND, SECOND));
+  verify("verify sliding window with gaps", sliding_window(gapped_events(), 3 * SECOND, SECOND),
+         recompute_window(gapped_events(), 3 * SECOND, SECOND));
+  verify("verify sliding window with gaps, slide 2s", sliding_window(gapped_events(), 3 * SECOND, 2 * SECOND),
+         recompute_window(gapped_events(), 3 * SECOND, 2 * SECOND));
+
+  // 很长的空白不能逐个关闭空 pane，否则耗时与空白的长度成正比
+  {
+    constexpr int64_t HUGE_GAP = 10'000'000'000;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Window> windows;
+    for (const Window &window : tumbling_window(huge_gap_events(HUGE_GAP), 1)) {
+      windows.push_back(window);
+    }
+    auto milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    auto correct = windows.size() == 2 && windows[0].start == 0 && windows[0].aggregate.count == 1 &&
+                   windows[1].start == HUGE_GAP && windows[1].end == HUGE_GAP + 1 && windows[1].aggregate.count == 1;
+    std::cout << "tumbling 1 ms across a " << HUGE_GAP << " ms gap: " << windows.size() << " windows in "
+              << milliseconds << " ms" << (correct && milliseconds < 100 ? ", correct" : ", WRONG") << std::endl;
+  }
+
+  benchmark("tumbling 1s", EVENT_COUNT, [&]() { return tumbling_window(events(EVENT_COUNT), SECOND); });
+  benchmark("tumbling 1min", EVENT_COUNT, [&]() { return tumbling_window(events(EVENT_COUNT), MINUTE); });
+  benchmark("sliding 1min every 1s (two-stack)", EVENT_COUNT,
+            [&]() { return sliding_window(events(EVENT_COUNT), MINUTE, SECOND); });
+  benchmark("sliding 1min every 1s (recompute)", EVENT_COUNT,
+            [&]() { return recompute_window(events(EVENT_COUNT), MINUTE, SECOND); });
+  std::cout << "end run window" << std::endl;
+}
+
+} // namespace window
+} // namespace co
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <limits>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "co_generator.h"
+
+namespace co {
+namespace window {
+
+// 时间戳和窗口长度的单位都是毫秒
+struct Event {
+  int64_t timestamp;
+  double value;
+};
+
+/**
+ * 近似分位数：按对数划分的桶计数，返回值的相对误差不超过 RELATIVE_ACCURACY，
+ * 两个 sketch 合并只需要对应的桶相加。只支持正数，更小的值都计入最低的桶
+*/
+struct QuantileSketch {
+  static constexpr double RELATIVE_ACCURACY = 0.01;
+  static constexpr int BUCKET_COUNT = 2048;
+  // 下标为 0 的桶对应 gamma^-OFFSET，约 3.5e-5
+  static constexpr int OFFSET = 512;
+
+  void add(double value);
+  void merge(const QuantileSketch &other);
+
+  // q 在 [0, 1] 之间，没有值时返回 0
+  double quantile(double q) const;
+
+  void clear();
+
+private:
+  // 没有值的时候不分配桶
+  std::vector<uint32_t> buckets;
+  uint64_t count = 0;
+};
+
+/**
+ * 一组事件的聚合结果，满足结合律，可以按任意分组先聚合再合并
+*/
+struct Aggregate {
+  uint64_t count = 0;
+  double sum = 0;
+  double min = std::numeric_limits<double>::infinity();
+  double max = -std::numeric_limits<double>::infinity();
+  QuantileSketch sketch;
+
+  void add(double value);
+  void merge(const Aggregate &other);
+  void clear();
+
+  double quantile(double q) const {
+    return sketch.quantile(q);
+  }
+};
+
+// 一个窗口 [start, end) 的聚合结果
+struct Window {
+  int64_t start = 0;
+  int64_t end = 0;
+  Aggregate aggregate;
+};
+
+/**
+ * 滚动窗口：长度为 size 的窗口首尾相接，等价于 sliding_window(events, size, size)
+*/
+generator::Generator<const Window &> tumbling_window(generator::Generator<Event> events, int64_t size);
+
+/**
+ * 滑动窗口：长度为 size，每隔 slide 产出一个窗口，窗口的起点是 slide 的整数倍。
+ * 事件先聚合到长度为 gcd(size, slide) 的 pane 中，每个事件只需要 O(1) 的聚合；
+ * 窗口由连续的 pane 组成，pane 保存在双栈实现的队列里，产出每个窗口只需要均摊 O(1) 次合并。
+ * 事件的时间戳需要非递减，落在已经关闭的 pane 中的迟到事件会被丢弃；没有事件的窗口不产出
+*/
+generator::Generator<const Window &> sliding_window(generator::Generator<Event> events, int64_t size, int64_t slide);
+
+/**
+ * 对照实现：缓存窗口内所有事件，每个窗口都重新计算一遍
+*/
+generator::Generator<const Window &> recompute_window(generator::Generator<Event> events, int64_t size, int64_t slide);
+
+void Run();
+
+} // namespace window
+} // namespace co
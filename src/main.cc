@@ -1,7 +1,80 @@
+#include <map>
+#include <string>
+#include <vector>
+#include <iostream>
 #include "./coroutine/co_generator.h"
 #include "./coroutine/co_task.h"
+#include "./coroutine/co_interleave.h"
+#include "./coroutine/co_batcher.h"
+#include "./coroutine/co_group_commit.h"
+#include "./coroutine/co_mmap_records.h"
+#include "./coroutine/co_csv.h"
+#include "./coroutine/co_query.h"
+#include "./coroutine/co_morsel.h"
+#include "./coroutine/co_external_sort.h"
+#include "./coroutine/co_window.h"
+#include "./coroutine/co_codec.h"
+#include "./coroutine/co_parallel.h"
+#include "./coroutine/co_graph.h"
+#include "./coroutine/co_incremental.h"
+#include "./coroutine/co_actor.h"
+#include "./coroutine/co_disruptor.h"
+#include "./coroutine/co_shm_channel.h"
+#include "./coroutine/co_rpc.h"
+#include "./coroutine/co_load.h"
+#include "./coroutine/co_admission.h"
+#include "./coroutine/co_budget.h"
+#include "./coroutine/co_local.h"
+#include "./coroutine/co_deadline.h"
+#include "./coroutine/co_affinity.h"
+#include "./coroutine/co_continuation.h"
 
+/**
+ * 第一个参数选择要运行的示例，默认运行 task；
+ * main load --target=... 运行压测工具，其余参数见 co::load::Main
+*/
 int main(int argc, char *argv[]){
-  // co::generator::Run();
-  co::task::Run();
+  std::map<std::string, void (*)()> demos = {
+    { "generator", co::generator::Run },
+    { "task", co::task::Run },
+    { "prefetch", co::prefetch::Run },
+    { "batch", co::batch::Run },
+    { "group_commit", co::group_commit::Run },
+    { "records", co::records::Run },
+    { "csv", co::csv::Run },
+    { "query", co::query::Run },
+    { "morsel", co::morsel::Run },
+    { "sort", co::sort::Run },
+    { "window", co::window::Run },
+    { "codec", co::codec::Run },
+    { "parallel", co::parallel::Run },
+    { "graph", co::graph::Run },
+    { "incremental", co::incremental::Run },
+    { "actor", co::actor::Run },
+    { "disruptor", co::disruptor::Run },
+    { "shm", co::shm::Run },
+    { "rpc", co::rpc::Run },
+    { "load", co::load::Run },
+    { "admission", co::admission::Run },
+    { "budget", co::budget::Run },
+    { "local", co::local::Run },
+    { "deadline", co::deadline::Run },
+    { "affinity", co::affinity::Run },
+    { "continuation", co::continuation::Run },
+  };
+  std::string scenario = argc > 1 ? argv[1] : "task";
+  if (scenario == "load" && argc > 2) {
+    return co::load::Main(std::vector<std::string>(argv + 2, argv + argc));
+  }
+  auto demo = demos.find(scenario);
+  if (demo == demos.end()) {
+    std::cerr << "usage: main [scenario], scenarios:";
+    for (auto &[name, run] : demos) {
+      std::cerr << " " << name;
+    }
+    std::cerr << std::endl;
+    return 2;
+  }
+  demo->second();
+  return 0;
 }